@@ -114,6 +114,14 @@ IterationSnapshot BackendCommunicator::GetJobHistory(boost::uint32_t jobId,
     return snp;
 }
 
+MorphingStats BackendCommunicator::GetMorphingStats(boost::uint32_t jobId,
+    bool lastIteration, bool &found)
+{
+    MorphingStats stats;
+    found = mJobManager->GetMorphingStats(jobId, lastIteration, stats);
+    return stats;
+}
+
 bool BackendCommunicator::SetFingerprintSelector(
     boost::uint32_t jobId, boost::int32_t selector, std::string password)
 {
@@ -31,6 +31,7 @@
 #include "MolpherParam.h"
 #include "MolpherMolecule.h"
 #include "IterationSnapshot.h"
+#include "MorphingStats.h"
 #include "JobGroup.h"
 #include "NeighborhoodTask.h"
 #include "core/NeighborhoodTaskQueue.h"
@@ -75,6 +76,7 @@ public:
     void ChangeJobOrder(boost::uint32_t jobId, boost::int32_t queuePosDiff, std::string password);
     bool ValidateJobPassword(boost::uint32_t jobId, std::string password);
     IterationSnapshot GetJobHistory(boost::uint32_t jobId, boost::uint32_t iterIdx, bool &loaded);
+    MorphingStats GetMorphingStats(boost::uint32_t jobId, bool lastIteration, bool &found);
     bool SetFingerprintSelector(boost::uint32_t jobId, boost::int32_t selector, std::string password);
     bool SetSimCoeffSelector(boost::uint32_t jobId, boost::int32_t selector, std::string password);
     bool SetDimRedSelector(boost::uint32_t jobId, boost::int32_t selector, std::string password);
@@ -65,18 +65,28 @@ void GetAtomTypesFromMol(RDKit::ROMol &mol, std::vector<MolpherAtom> &atoms)
 MolpherAtomIdx GetRandomAtom(const std::vector<MolpherAtom> &atoms, RDKit::Atom &atom)
 {
     int idx = SynchRand::GetRandomNumber(atoms.size() - 1);
-
-    atom.setAtomicNum(atoms[idx].atomicNum);
-    atom.setFormalCharge(atoms[idx].formalCharge);
-    atom.setMass(atoms[idx].mass);
+    GetAtom(atoms[idx], atom);
 
     return idx;
 }
 
+void GetAtom(const MolpherAtom &molpherAtom, RDKit::Atom &atom)
+{
+    atom.setAtomicNum(molpherAtom.atomicNum);
+    atom.setFormalCharge(molpherAtom.formalCharge);
+    atom.setMass(molpherAtom.mass);
+}
+
 RDKit::Bond *GetRandomNonSingleBond(RDKit::Atom &atom)
 {
     std::vector<RDKit::Bond *> candidates;
+    GetNonSingleBonds(atom, candidates);
 
+    return candidates[SynchRand::GetRandomNumber(0, candidates.size() - 1)];
+}
+
+void GetNonSingleBonds(RDKit::Atom &atom, std::vector<RDKit::Bond *> &bonds)
+{
     RDKit::Bond *bond;
     RDKit::ROMol &mol = atom.getOwningMol();
     RDKit::ROMol::OEDGE_ITER beg, end;
@@ -85,11 +95,9 @@ RDKit::Bond *GetRandomNonSingleBond(RDKit::Atom &atom)
         bond = mol[*beg++].get();
         int bo = RDKit::queryBondOrder(bond);
         if (bo > 1 && bo <= 6) {
-            candidates.push_back(bond);
+            bonds.push_back(bond);
         }
     }
-
-    return candidates[SynchRand::GetRandomNumber(0, candidates.size() - 1)];
 }
 
 bool HasNonSingleBond(RDKit::Atom &atom)
@@ -116,7 +124,17 @@ void SetBondOrder(RDKit::Bond &bond, int bondOrder)
 
 void DecreaseBondOrder(RDKit::Bond &bond)
 {
-    int bo = RDKit::queryBondOrder(&bond);
+    bond.setBondType(DecreasedBondType(bond.getBondType()));
+}
+
+void IncreaseBondOrder(RDKit::Bond &bond)
+{
+    bond.setBondType(IncreasedBondType(bond.getBondType()));
+}
+
+RDKit::Bond::BondType DecreasedBondType(RDKit::Bond::BondType type)
+{
+    int bo = static_cast<int>(type);
     int newBo;
 
     if (bo >= 2 && bo <= 6) {
@@ -126,12 +144,12 @@ void DecreaseBondOrder(RDKit::Bond &bond)
     } else {
         newBo = 1;
     }
-    bond.setBondType(static_cast<RDKit::Bond::BondType>(newBo));
+    return static_cast<RDKit::Bond::BondType>(newBo);
 }
 
-void IncreaseBondOrder(RDKit::Bond &bond)
+RDKit::Bond::BondType IncreasedBondType(RDKit::Bond::BondType type)
 {
-    int bo = RDKit::queryBondOrder(&bond);
+    int bo = static_cast<int>(type);
     int newBo;
 
     if (bo >= 1 && bo <= 5) {
@@ -141,7 +159,7 @@ void IncreaseBondOrder(RDKit::Bond &bond)
     } else {
         newBo = 2;
     }
-    bond.setBondType(static_cast<RDKit::Bond::BondType>(newBo));
+    return static_cast<RDKit::Bond::BondType>(newBo);
 }
 
 unsigned int CntFreeOxygens(RDKit::Atom &atom)
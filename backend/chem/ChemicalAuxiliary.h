@@ -31,8 +31,12 @@ void GetAtomTypesFromMol(RDKit::ROMol &mol, std::vector<MolpherAtom> &atoms);
 
 MolpherAtomIdx GetRandomAtom(const std::vector<MolpherAtom> &atoms, RDKit::Atom &atom);
 
+void GetAtom(const MolpherAtom &molpherAtom, RDKit::Atom &atom);
+
 RDKit::Bond *GetRandomNonSingleBond(RDKit::Atom &atom);
 
+void GetNonSingleBonds(RDKit::Atom &atom, std::vector<RDKit::Bond *> &bonds);
+
 bool HasNonSingleBond(RDKit::Atom &atom);
 
 void SetBondOrder(RDKit::Bond &bond, int bondOrder);
@@ -41,6 +45,10 @@ void DecreaseBondOrder(RDKit::Bond &bond);
 
 void IncreaseBondOrder(RDKit::Bond &bond);
 
+RDKit::Bond::BondType DecreasedBondType(RDKit::Bond::BondType type);
+
+RDKit::Bond::BondType IncreasedBondType(RDKit::Bond::BondType type);
+
 unsigned int CntFreeOxygens(RDKit::Atom &atom);
 
 int GetMaxBondsMod(AtomicNum atomicNum);
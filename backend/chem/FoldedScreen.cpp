@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+
+#include "chem/fingerprintStrategy/MorganFngpr.hpp"
+#include "chem/FoldedScreen.hpp"
+
+FoldedScreen::FoldedScreen(FingerprintSelector fp, unsigned int nBits) :
+    mNBits(nBits)
+{
+    assert(fp == FP_MORGAN);
+    mFpStrategy = new MorganFngpr(2, mNBits);
+}
+
+FoldedScreen::~FoldedScreen()
+{
+    delete mFpStrategy;
+}
+
+bool FoldedScreen::IsApplicable(FingerprintSelector fp, SimCoeffSelector sc)
+{
+    // the bound is derived for Tanimoto only; atom pairs and torsions
+    // simulate counts by several bits per entry, so their short fingerprint
+    // is not a fold of the full one
+    return (fp == FP_MORGAN) && (sc == SC_TANIMOTO);
+}
+
+int FoldedScreen::AddReference(Fingerprint *fullFp)
+{
+    assert(fullFp->getNumBits() % mNBits == 0);
+
+    Reference reference;
+    reference.foldedCounts.resize(mNBits, 0);
+    reference.onBits = 0;
+    for (unsigned int i = 0; i < fullFp->getNumBits(); ++i) {
+        if ((*fullFp)[i]) {
+            ++reference.foldedCounts[i % mNBits];
+            ++reference.onBits;
+        }
+    }
+
+    mReferences.push_back(reference);
+    return mReferences.size() - 1;
+}
+
+Fingerprint *FoldedScreen::GetFingerprint(RDKit::ROMol *mol)
+{
+    return mFpStrategy->GetFingerprint(mol);
+}
+
+double FoldedScreen::GetDistanceLowerBound(
+    Fingerprint *screenFp, int reference) const
+{
+    const Reference &ref = mReferences[reference];
+
+    unsigned int maxCommon = 0;
+    unsigned int minUnmatched = 0;
+    for (unsigned int i = 0; i < mNBits; ++i) {
+        if ((*screenFp)[i]) {
+            if (ref.foldedCounts[i] > 0) {
+                maxCommon += ref.foldedCounts[i];
+            } else {
+                ++minUnmatched;
+            }
+        }
+    }
+
+    unsigned int minUnion = ref.onBits + minUnmatched;
+    if (minUnion == 0) {
+        return 1.0;
+    }
+    return 1.0 - (double) maxCommon / minUnion;
+}
@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "global_types.h"
+#include "fingerprint_selectors.h"
+#include "simcoeff_selectors.h"
+#include "chem/fingerprintStrategy/FingerprintStrategy.h"
+
+#ifndef FOLDEDSCREEN_BITS
+#define FOLDEDSCREEN_BITS 256
+#endif
+
+/**
+    First tier of the two-tier distance computation. Morgan fingerprints
+    set bit (hash % nBits), so a short one is an exact fold of the full
+    one (FP_MORGAN only, see IsApplicable). Knowing the full reference fingerprint
+    (target, decoy), the short fingerprint of a morph gives an upper bound
+    on the Tanimoto coefficient and thus a lower bound on the distance:
+    every folded bit shared with the reference contributes at most all
+    full reference bits folded into it, every other folded bit contributes
+    at least one full bit to the union.
+ */
+class FoldedScreen
+{
+public:
+    FoldedScreen(FingerprintSelector fp, unsigned int nBits = FOLDEDSCREEN_BITS);
+    ~FoldedScreen();
+
+    static bool IsApplicable(FingerprintSelector fp, SimCoeffSelector sc);
+
+    /// Returns index of the reference for GetDistanceLowerBound.
+    int AddReference(Fingerprint *fullFp);
+
+    Fingerprint *GetFingerprint(RDKit::ROMol *mol);
+    double GetDistanceLowerBound(Fingerprint *screenFp, int reference) const;
+
+private:
+    struct Reference
+    {
+        // number of full bits folded into each short bit
+        std::vector<unsigned short> foldedCounts;
+        unsigned int onBits;
+    };
+
+    unsigned int mNBits;
+    FingerprintStrategy *mFpStrategy;
+    std::vector<Reference> mReferences;
+};
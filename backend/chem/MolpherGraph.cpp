@@ -0,0 +1,483 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <GraphMol/RDKitBase.h>
+#include <GraphMol/QueryOps.h>
+
+#include "chem/MolpherGraph.hpp"
+
+MolpherGraph::MolpherGraph()
+{
+    // no-op
+}
+
+MolpherGraph::MolpherGraph(RDKit::ROMol &mol)
+{
+    Assign(mol);
+}
+
+void MolpherGraph::Assign(RDKit::ROMol &mol)
+{
+    atoms.resize(mol.getNumAtoms());
+    for (AtomIdx i = 0; i < mol.getNumAtoms(); ++i) {
+        RDKit::Atom *atom = mol.getAtomWithIdx(i);
+        atoms[i].atomicNum = atom->getAtomicNum();
+        atoms[i].formalCharge = atom->getFormalCharge();
+        atoms[i].mass = atom->getMass();
+        atoms[i].valence = 0.0;
+    }
+
+    bonds.resize(mol.getNumBonds());
+    for (BondIdx i = 0; i < mol.getNumBonds(); ++i) {
+        RDKit::Bond *bond = mol.getBondWithIdx(i);
+        bonds[i].begin = bond->getBeginAtomIdx();
+        bonds[i].end = bond->getEndAtomIdx();
+        bonds[i].type = bond->getBondType();
+        bonds[i].inRing = RDKit::queryIsBondInRing(bond);
+
+        double contrib = GetValenceContrib(bonds[i].type);
+        atoms[bonds[i].begin].valence += contrib;
+        atoms[bonds[i].end].valence += contrib;
+    }
+}
+
+double MolpherGraph::GetValenceContrib(RDKit::Bond::BondType type)
+{
+    int bo = static_cast<int>(type);
+    if (bo >= 1 && bo <= 6) {
+        return bo;
+    } else if (bo >= 7 && bo <= 11) {
+        // ONEANDAHALF .. FIVEANDAHALF
+        return bo - 5.5;
+    } else if (type == RDKit::Bond::AROMATIC) {
+        return 1.5;
+    }
+    return 0.0;
+}
+
+AtomIdx MolpherGraph::AddAtom(const MolpherAtom &atom)
+{
+    Atom newAtom;
+    newAtom.atomicNum = atom.atomicNum;
+    newAtom.formalCharge = atom.formalCharge;
+    newAtom.mass = atom.mass;
+    newAtom.valence = 0.0;
+    atoms.push_back(newAtom);
+    return atoms.size() - 1;
+}
+
+void MolpherGraph::ReplaceAtom(AtomIdx idx, const MolpherAtom &atom)
+{
+    atoms[idx].atomicNum = atom.atomicNum;
+    atoms[idx].formalCharge = atom.formalCharge;
+    atoms[idx].mass = atom.mass;
+}
+
+void MolpherGraph::RemoveAtom(AtomIdx idx)
+{
+    std::vector<Bond> kept;
+    kept.reserve(bonds.size());
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        Bond bond = bonds[i];
+        if ((bond.begin == idx) || (bond.end == idx)) {
+            double contrib = GetValenceContrib(bond.type);
+            atoms[bond.begin].valence -= contrib;
+            atoms[bond.end].valence -= contrib;
+            continue;
+        }
+        if (bond.begin > idx) {
+            --bond.begin;
+        }
+        if (bond.end > idx) {
+            --bond.end;
+        }
+        kept.push_back(bond);
+    }
+    bonds.swap(kept);
+    atoms.erase(atoms.begin() + idx);
+}
+
+BondIdx MolpherGraph::AddBond(AtomIdx begin, AtomIdx end, RDKit::Bond::BondType type)
+{
+    Bond bond;
+    bond.begin = begin;
+    bond.end = end;
+    bond.type = type;
+    bond.inRing = false;
+    bonds.push_back(bond);
+
+    double contrib = GetValenceContrib(type);
+    atoms[begin].valence += contrib;
+    atoms[end].valence += contrib;
+    return bonds.size() - 1;
+}
+
+void MolpherGraph::RemoveBond(AtomIdx begin, AtomIdx end)
+{
+    int idx = FindBond(begin, end);
+    if (idx < 0) {
+        return;
+    }
+    double contrib = GetValenceContrib(bonds[idx].type);
+    atoms[bonds[idx].begin].valence -= contrib;
+    atoms[bonds[idx].end].valence -= contrib;
+    bonds.erase(bonds.begin() + idx);
+}
+
+void MolpherGraph::SetBondType(BondIdx idx, RDKit::Bond::BondType type)
+{
+    double diff = GetValenceContrib(type) - GetValenceContrib(bonds[idx].type);
+    atoms[bonds[idx].begin].valence += diff;
+    atoms[bonds[idx].end].valence += diff;
+    bonds[idx].type = type;
+}
+
+int MolpherGraph::FindBond(AtomIdx atom1, AtomIdx atom2) const
+{
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        if (((bonds[i].begin == atom1) && (bonds[i].end == atom2)) ||
+                ((bonds[i].begin == atom2) && (bonds[i].end == atom1))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MolpherGraph::GetAtomBonds(AtomIdx idx, std::vector<BondIdx> &result) const
+{
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        if ((bonds[i].begin == idx) || (bonds[i].end == idx)) {
+            result.push_back(i);
+        }
+    }
+}
+
+void MolpherGraph::GetNonSingleBonds(AtomIdx idx, std::vector<BondIdx> &result) const
+{
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        if ((bonds[i].begin == idx) || (bonds[i].end == idx)) {
+            int bo = static_cast<int>(bonds[i].type);
+            if (bo > 1 && bo <= 6) {
+                result.push_back(i);
+            }
+        }
+    }
+}
+
+bool MolpherGraph::IsValenceAcceptable() const
+{
+    const RDKit::PeriodicTable *pt = RDKit::PeriodicTable::getTable();
+    for (AtomIdx i = 0; i < atoms.size(); ++i) {
+        const RDKit::INT_VECT &valences = pt->getValenceList(atoms[i].atomicNum);
+        int maxValence = valences.back();
+        if (maxValence < 0) {
+            // no limit known for the element
+            continue;
+        }
+        if (atoms[i].valence > maxValence + std::abs(atoms[i].formalCharge)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MolpherGraph::Defect MolpherGraph::FindDefect() const
+{
+    if (!IsValenceAcceptable()) {
+        return DEFECT_VALENCE;
+    }
+    if (!IsAromaticityAcceptable()) {
+        return DEFECT_AROMATICITY;
+    }
+    if (!IsConnected()) {
+        return DEFECT_DISCONNECTED;
+    }
+    return DEFECT_NONE;
+}
+
+bool MolpherGraph::IsConnected() const
+{
+    if (atoms.empty()) {
+        return false;
+    }
+    if (bonds.size() + 1 < atoms.size()) {
+        // a tree is the sparsest connected graph
+        return false;
+    }
+
+    // union-find over the bonds
+    std::vector<AtomIdx> roots(atoms.size());
+    for (AtomIdx i = 0; i < atoms.size(); ++i) {
+        roots[i] = i;
+    }
+    size_t components = atoms.size();
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        AtomIdx a = bonds[i].begin;
+        while (roots[a] != a) {
+            a = roots[a] = roots[roots[a]];
+        }
+        AtomIdx b = bonds[i].end;
+        while (roots[b] != b) {
+            b = roots[b] = roots[roots[b]];
+        }
+        if (a != b) {
+            roots[a] = b;
+            --components;
+        }
+    }
+    return components == 1;
+}
+
+bool MolpherGraph::IsBondInCycle(BondIdx idx) const
+{
+    AtomIdx target = bonds[idx].end;
+    std::vector<bool> visited(atoms.size(), false);
+    std::vector<AtomIdx> stack(1, bonds[idx].begin);
+    visited[bonds[idx].begin] = true;
+    while (!stack.empty()) {
+        AtomIdx atom = stack.back();
+        stack.pop_back();
+        for (BondIdx i = 0; i < bonds.size(); ++i) {
+            if (i == idx) {
+                continue;
+            }
+            AtomIdx next;
+            if (bonds[i].begin == atom) {
+                next = bonds[i].end;
+            } else if (bonds[i].end == atom) {
+                next = bonds[i].begin;
+            } else {
+                continue;
+            }
+            if (next == target) {
+                return true;
+            }
+            if (!visited[next]) {
+                visited[next] = true;
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+bool MolpherGraph::IsAromaticityAcceptable() const
+{
+    // molecules are kekulized before morphing, aromatic bonds are rare
+    std::vector<int> aromaticDegree(atoms.size(), 0);
+    std::vector<bool> otherMultiple(atoms.size(), false);
+    bool anyAromatic = false;
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        if (bonds[i].type == RDKit::Bond::AROMATIC) {
+            ++aromaticDegree[bonds[i].begin];
+            ++aromaticDegree[bonds[i].end];
+            anyAromatic = true;
+        } else if (GetValenceContrib(bonds[i].type) > 1.0) {
+            otherMultiple[bonds[i].begin] = true;
+            otherMultiple[bonds[i].end] = true;
+        }
+    }
+    if (!anyAromatic) {
+        return true;
+    }
+
+    // Kekulize refuses aromatic atoms outside of rings
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        if ((bonds[i].type == RDKit::Bond::AROMATIC) && !IsBondInCycle(i)) {
+            return false;
+        }
+    }
+
+    /*
+     An isolated aromatic ring of neutral carbons without other multiple
+     bonds needs every atom in exactly one double bond of the ring, which is
+     impossible for an odd ring size. Rings with heteroatoms, charges or
+     fused systems are left to RDKit, the rule would not be certain there.
+     */
+    std::vector<bool> visited(atoms.size(), false);
+    for (AtomIdx start = 0; start < atoms.size(); ++start) {
+        if (visited[start] || (aromaticDegree[start] == 0)) {
+            continue;
+        }
+        bool simpleCarbonRing = true;
+        size_t size = 0;
+        std::vector<AtomIdx> stack(1, start);
+        visited[start] = true;
+        while (!stack.empty()) {
+            AtomIdx atom = stack.back();
+            stack.pop_back();
+            ++size;
+            if ((atoms[atom].atomicNum != 6) || (atoms[atom].formalCharge != 0) ||
+                    (aromaticDegree[atom] != 2) || otherMultiple[atom]) {
+                simpleCarbonRing = false;
+            }
+            for (BondIdx i = 0; i < bonds.size(); ++i) {
+                if (bonds[i].type != RDKit::Bond::AROMATIC) {
+                    continue;
+                }
+                AtomIdx next;
+                if (bonds[i].begin == atom) {
+                    next = bonds[i].end;
+                } else if (bonds[i].end == atom) {
+                    next = bonds[i].begin;
+                } else {
+                    continue;
+                }
+                if (!visited[next]) {
+                    visited[next] = true;
+                    stack.push_back(next);
+                }
+            }
+        }
+        if (simpleCarbonRing && (size % 2 == 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+static void AppendBytes(std::string &key, const T &value)
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void MolpherGraph::GetKey(std::string &key,
+    std::vector<boost::uint64_t> &bondKeys) const
+{
+    key.clear();
+    AppendBytes(key, static_cast<boost::uint32_t>(atoms.size()));
+    for (AtomIdx i = 0; i < atoms.size(); ++i) {
+        AppendBytes(key, atoms[i].atomicNum);
+        AppendBytes(key, atoms[i].formalCharge);
+        AppendBytes(key, atoms[i].mass);
+    }
+    // bond ends ordered, 24 bits each, and the type in the low bits
+    bondKeys.clear();
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        boost::uint64_t a = std::min(bonds[i].begin, bonds[i].end);
+        boost::uint64_t b = std::max(bonds[i].begin, bonds[i].end);
+        bondKeys.push_back((a << 40) | (b << 16) |
+            static_cast<boost::uint64_t>(bonds[i].type));
+    }
+    std::sort(bondKeys.begin(), bondKeys.end());
+    for (size_t i = 0; i < bondKeys.size(); ++i) {
+        AppendBytes(key, bondKeys[i]);
+    }
+}
+
+static boost::uint64_t Avalanche(boost::uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+static boost::uint64_t Combine(boost::uint64_t seed, boost::uint64_t value)
+{
+    return Avalanche(seed ^
+        (value + UINT64_C(0x9e3779b97f4a7c15) + (seed << 6) + (seed >> 2)));
+}
+
+static size_t CountClasses(const std::vector<boost::uint64_t> &colors)
+{
+    std::vector<boost::uint64_t> sorted(colors);
+    std::sort(sorted.begin(), sorted.end());
+    return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+}
+
+boost::uint64_t MolpherGraph::GetCanonicalHash(bool *discrete) const
+{
+    size_t atomCount = atoms.size();
+    std::vector<std::vector<std::pair<AtomIdx, int> > > neighbours(atomCount);
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        int type = static_cast<int>(bonds[i].type);
+        neighbours[bonds[i].begin].push_back(std::make_pair(bonds[i].end, type));
+        neighbours[bonds[i].end].push_back(std::make_pair(bonds[i].begin, type));
+    }
+
+    std::vector<boost::uint64_t> colors(atomCount);
+    for (AtomIdx i = 0; i < atomCount; ++i) {
+        boost::uint64_t color = Combine(0, atoms[i].atomicNum);
+        color = Combine(color, static_cast<boost::int64_t>(atoms[i].formalCharge));
+        // isotopes differ in mass by far more than the rounding
+        color = Combine(color,
+            static_cast<boost::uint64_t>(atoms[i].mass * 1000.0 + 0.5));
+        colors[i] = color;
+    }
+
+    std::vector<boost::uint64_t> refined(atomCount);
+    std::vector<boost::uint64_t> around;
+    size_t classes = CountClasses(colors);
+    for (size_t round = 0; round < atomCount; ++round) {
+        for (AtomIdx i = 0; i < atomCount; ++i) {
+            around.clear();
+            for (size_t j = 0; j < neighbours[i].size(); ++j) {
+                around.push_back(Combine(neighbours[i][j].second,
+                    colors[neighbours[i][j].first]));
+            }
+            std::sort(around.begin(), around.end());
+            boost::uint64_t color = colors[i];
+            for (size_t j = 0; j < around.size(); ++j) {
+                color = Combine(color, around[j]);
+            }
+            refined[i] = color;
+        }
+        colors.swap(refined);
+
+        size_t refinedClasses = CountClasses(colors);
+        if (refinedClasses == classes) {
+            break;
+        }
+        classes = refinedClasses;
+    }
+
+    if (discrete) {
+        *discrete = (classes == atomCount);
+    }
+
+    std::sort(colors.begin(), colors.end());
+    boost::uint64_t hash = Combine(atomCount, bonds.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+        hash = Combine(hash, colors[i]);
+    }
+    return hash;
+}
+
+RDKit::RWMol *MolpherGraph::ToRWMol(RDKit::RWMol *mol) const
+{
+    if (!mol) {
+        mol = new RDKit::RWMol();
+    }
+    for (AtomIdx i = 0; i < atoms.size(); ++i) {
+        RDKit::Atom newAtom(atoms[i].atomicNum);
+        newAtom.setFormalCharge(atoms[i].formalCharge);
+        newAtom.setMass(atoms[i].mass);
+        mol->addAtom(&newAtom);
+    }
+    for (BondIdx i = 0; i < bonds.size(); ++i) {
+        mol->addBond(bonds[i].begin, bonds[i].end, bonds[i].type);
+    }
+    return mol;
+}
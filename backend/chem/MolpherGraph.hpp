@@ -0,0 +1,138 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+#include <GraphMol/GraphMol.h>
+
+#include "global_types.h"
+
+/**
+    Compact molecular graph the morphing operators edit instead of a full
+    RDKit::RWMol copy. Only the data CopyMol transfers to the morph are
+    kept (element, charge, mass, bond ends and type) plus the bond valence
+    sum of each atom, ring membership of the original bonds and the order
+    of atoms and bonds, which follows RDKit index semantics (removal shifts
+    the following indices down).
+ */
+class MolpherGraph
+{
+public:
+    struct Atom
+    {
+        AtomicNum atomicNum;
+        int formalCharge;
+        double mass;
+        double valence; // sum of valence contributions of its bonds
+    };
+
+    struct Bond
+    {
+        AtomIdx begin;
+        AtomIdx end;
+        RDKit::Bond::BondType type;
+        bool inRing; // of the molecule the graph was built from
+    };
+
+    enum Defect
+    {
+        DEFECT_NONE,
+        DEFECT_VALENCE,
+        DEFECT_AROMATICITY,
+        DEFECT_DISCONNECTED
+    };
+
+    MolpherGraph();
+    explicit MolpherGraph(RDKit::ROMol &mol);
+    /// Rebuilds the graph from mol, keeping the allocated storage.
+    void Assign(RDKit::ROMol &mol);
+
+    AtomIdx AddAtom(const MolpherAtom &atom);
+    void ReplaceAtom(AtomIdx idx, const MolpherAtom &atom);
+    void RemoveAtom(AtomIdx idx);
+
+    BondIdx AddBond(AtomIdx begin, AtomIdx end, RDKit::Bond::BondType type);
+    void RemoveBond(AtomIdx begin, AtomIdx end);
+    void SetBondType(BondIdx idx, RDKit::Bond::BondType type);
+    /// Returns index of the bond between the atoms or -1.
+    int FindBond(AtomIdx atom1, AtomIdx atom2) const;
+    /// Bonds of the atom in the order of their indices.
+    void GetAtomBonds(AtomIdx idx, std::vector<BondIdx> &bonds) const;
+    /// Bonds of the atom with order in (1, 6], same as GetNonSingleBonds.
+    void GetNonSingleBonds(AtomIdx idx, std::vector<BondIdx> &bonds) const;
+
+    /**
+        Cheap pre-check before conversion. Rejects only atoms whose bond
+        valence exceeds the largest valence RDKit allows for the element
+        (widened by the absolute formal charge), such a morph would fail
+        sanitization anyway.
+     */
+    bool IsValenceAcceptable() const;
+
+    /**
+        Structural pre-check run right after an edit, the first defect found
+        is returned. Besides IsValenceAcceptable it rejects aromatic bonds
+        outside of any ring and all-carbon aromatic rings of odd size, both
+        make kekulization fail, and graphs that are empty or fall apart into
+        fragments, which no operator means to produce. The valence limit is
+        not GetMaxBondsMod: that is the default valence, sanitization accepts
+        the higher ones (e.g. sulfur in sulfones).
+     */
+    Defect FindDefect() const;
+
+    /**
+        Key equal for equal graphs regardless of bond order, used to drop
+        identical morphs before they are converted. The key is written into
+        key, bondKeys is scratch space; both keep their storage, so reused
+        buffers do not allocate.
+     */
+    void GetKey(std::string &key, std::vector<boost::uint64_t> &bondKeys) const;
+
+    /**
+        Weisfeiler-Lehman style hash independent of the atom order. Atom
+        colors start from element, charge and mass and are refined by the
+        sorted (bond type, neighbour color) pairs until the number of color
+        classes stops growing. Isomorphic graphs with the same bond orders
+        get the same hash; the same molecule in another Kekule form may not.
+        If discrete is given, it is set when every atom ended in its own
+        class. Such graphs are identified by the refinement, so equal hashes
+        mean the same molecule up to a collision of the 64-bit digest.
+     */
+    boost::uint64_t GetCanonicalHash(bool *discrete = NULL) const;
+
+    /**
+        Same molecule as CopyMol of the RDKit molecule with applied edits.
+        Built into mol if given (it must be empty), else into a new one.
+     */
+    RDKit::RWMol *ToRWMol(RDKit::RWMol *mol = NULL) const;
+
+    static double GetValenceContrib(RDKit::Bond::BondType type);
+
+protected:
+    bool IsConnected() const;
+    bool IsAromaticityAcceptable() const;
+    /// Whether begin and end of the bond are connected by another path.
+    bool IsBondInCycle(BondIdx idx) const;
+
+    std::vector<Atom> atoms;
+    std::vector<Bond> bonds;
+};
@@ -15,6 +15,7 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cassert>
 #include <vector>
 
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
@@ -27,6 +28,8 @@
 #include "chem/fingerprintStrategy/TopolLayeredFngpr2.hpp"
 #include "chem/fingerprintStrategy/TopolSingleFngpr.hpp"
 #include "chem/fingerprintStrategy/TopolTorsFngpr.hpp"
+#include "chem/fingerprintStrategy/AtomPairsCountFngpr.hpp"
+#include "chem/fingerprintStrategy/MorganCountFngpr.hpp"
 #include "chem/SimCoefCalculator.hpp"
 
 // TODO: merge into one?
@@ -50,9 +53,11 @@ SimCoefCalculator::SimCoefCalculator(
     FingerprintSelector fp,
     RDKit::ROMol *source,
     RDKit::ROMol *target
-    )
+    ) :
+    mSparseFpStrategy(NULL),
+    mMorganFpStrategy(NULL)
 {
-    if (fp <= MAX_STANDARD_FP) {
+    if (fp <= MAX_STANDARD_FP || fp > MAX_EXTENDED_FP) {
         mExtended = false;
     } else {
         if (source == NULL || target == NULL) {
@@ -136,7 +141,16 @@ SimCoefCalculator::SimCoefCalculator(
         mFpStrategy = new TopolTorsFngpr();
         break;
     case FP_MORGAN:
-        mFpStrategy = new MorganFngpr();
+        mMorganFpStrategy = new MorganFngpr();
+        mFpStrategy = mMorganFpStrategy;
+        break;
+    case FP_ATOM_PAIRS_COUNTS:
+        mSparseFpStrategy = new AtomPairsCountFngpr();
+        mFpStrategy = mSparseFpStrategy;
+        break;
+    case FP_MORGAN_COUNTS:
+        mSparseFpStrategy = new MorganCountFngpr();
+        mFpStrategy = mSparseFpStrategy;
         break;
     default:
         mFpStrategy = new MorganFngpr();
@@ -179,9 +193,23 @@ double SimCoefCalculator::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
     return mScStrategy->GetSimCoef(fp1, fp2);
 }
 
+double SimCoefCalculator::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    return mScStrategy->GetSimCoef(fp1, fp2);
+}
+
 double SimCoefCalculator::GetSimCoef(RDKit::ROMol *mol1, RDKit::ROMol *mol2)
 {
     double result;
+    if (IsSparse()) {
+        SparseFingerprint *fp1 = GetSparseFingerprint(mol1);
+        SparseFingerprint *fp2 = GetSparseFingerprint(mol2);
+        result = mScStrategy->GetSimCoef(fp1, fp2);
+        delete fp1;
+        delete fp2;
+        return result;
+    }
+
     Fingerprint *fp1 = GetFingerprint(mol1);
     Fingerprint *fp2 = GetFingerprint(mol2);
     result = mScStrategy->GetSimCoef(fp1, fp2);
@@ -206,6 +234,26 @@ double SimCoefCalculator::ConvertToDistance(double coef) const
     return mScStrategy->ConvertToDistance(coef);
 }
 
+bool SimCoefCalculator::IsSparse() const
+{
+    return mSparseFpStrategy != NULL;
+}
+
+SparseFingerprint *SimCoefCalculator::GetSparseFingerprint(RDKit::ROMol *mol)
+{
+    assert(IsSparse());
+    return mSparseFpStrategy->GetSparseFingerprint(mol);
+}
+
+MorganFngpr *SimCoefCalculator::GetSharedMorganStrategy()
+{
+    if (mExtended || (mMorganFpStrategy == NULL) ||
+            !mMorganFpStrategy->SharesSAScoreEnvironments()) {
+        return NULL;
+    }
+    return mMorganFpStrategy;
+}
+
 Fingerprint *SimCoefCalculator::GetFingerprint(RDKit::ROMol *mol)
 {
     Fingerprint *fp = mFpStrategy->GetFingerprint(mol);
@@ -18,6 +18,9 @@
 #pragma once
 
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
+#include "chem/fingerprintStrategy/SparseFingerprintStrategy.h"
+
+class MorganFngpr;
 
 class SimCoefCalculator
 {
@@ -34,12 +37,22 @@ public:
     ~SimCoefCalculator();
 
     double GetSimCoef(Fingerprint *fp1, Fingerprint *fp2);
+    double GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2);
     double GetSimCoef(RDKit::ROMol *mol1, RDKit::ROMol *mol2);
     double GetSimCoef(Fingerprint *fp1, RDKit::ROMol *mol2);
 
     double ConvertToDistance(double coef) const;
 
+    /// True for count-based selectors, GetFingerprint then returns
+    /// the folded form while GetSparseFingerprint the unfolded one.
+    bool IsSparse() const;
+
     Fingerprint *GetFingerprint(RDKit::ROMol *mol);
+    SparseFingerprint *GetSparseFingerprint(RDKit::ROMol *mol);
+
+    /// Non-extended FP_MORGAN strategy whose environments are the SAScore
+    /// fragments (see MorganFngpr::SharesSAScoreEnvironments), NULL otherwise.
+    MorganFngpr *GetSharedMorganStrategy();
 
 protected:
     Fingerprint *Extend(RDKit::ROMol *mol, Fingerprint *fp);
@@ -49,4 +62,6 @@ private:
     std::map<AtomicNum, unsigned short> mAtomTypesToIdx;
     SimCoefStrategy *mScStrategy;
     FingerprintStrategy *mFpStrategy;
+    SparseFingerprintStrategy *mSparseFpStrategy; // alias of mFpStrategy
+    MorganFngpr *mMorganFpStrategy; // alias of mFpStrategy
 };
\ No newline at end of file
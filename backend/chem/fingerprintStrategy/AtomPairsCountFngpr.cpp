@@ -0,0 +1,39 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AtomPairsCountFngpr.hpp"
+
+AtomPairsCountFngpr::AtomPairsCountFngpr(
+    unsigned int nFoldBits,
+    unsigned int minLength,
+    unsigned int maxLength
+    ) :
+    SparseFingerprintStrategy(nFoldBits),
+    mMinLength(minLength),
+    mMaxLength(maxLength)
+{
+    // no-op
+}
+
+SparseFingerprint *AtomPairsCountFngpr::GetSparseFingerprint(RDKit::ROMol *mol)
+{
+    RDKit::SparseIntVect<boost::int32_t> *vect =
+        RDKit::AtomPairs::getAtomPairFingerprint(*mol, mMinLength, mMaxLength);
+    SparseFingerprint *result = Convert(*vect);
+    delete vect;
+    return result;
+}
@@ -0,0 +1,46 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "SparseFingerprintStrategy.h"
+
+class AtomPairsCountFngpr : public SparseFingerprintStrategy
+{
+public:
+    /**
+        Returns the unhashed atom-pair fingerprint with occurrence counts.
+
+        @param nFoldBits [in] the number of bits of the folded fingerprint
+            returned by GetFingerprint
+        @param minLength [in] minimum distance between atoms to be  considered
+            in a pair. Default is 1 bond.
+        @param maxLength [in] maximum distance between atoms to be considered
+            in a pair. Default is maxPathLen-1 bonds.
+     */
+    AtomPairsCountFngpr(
+        unsigned int nFoldBits = 2048,
+        unsigned int minLength = 1,
+        unsigned int maxLength = RDKit::AtomPairs::maxPathLen - 1
+        );
+
+    SparseFingerprint *GetSparseFingerprint(RDKit::ROMol *mol);
+
+private:
+    unsigned int mMinLength;
+    unsigned int mMaxLength;
+};
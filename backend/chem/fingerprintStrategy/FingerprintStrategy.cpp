@@ -24,6 +24,8 @@
 #include "TopolLayeredFngpr2.hpp"
 #include "TopolSingleFngpr.hpp"
 #include "TopolTorsFngpr.hpp"
+#include "AtomPairsCountFngpr.hpp"
+#include "MorganCountFngpr.hpp"
 
 Fingerprint *GetFingerprint(RDKit::ROMol *mol, FingerprintSelector fp)
 {
@@ -49,6 +51,12 @@ Fingerprint *GetFingerprint(RDKit::ROMol *mol, FingerprintSelector fp)
     case FP_MORGAN:
         strategy = new MorganFngpr();
         break;
+    case FP_ATOM_PAIRS_COUNTS:
+        strategy = new AtomPairsCountFngpr();
+        break;
+    case FP_MORGAN_COUNTS:
+        strategy = new MorganCountFngpr();
+        break;
     default:
         strategy = new MorganFngpr();
         break;
@@ -29,6 +29,7 @@
 class FingerprintStrategy
 {
 public:
+    virtual ~FingerprintStrategy() {}
     virtual Fingerprint *GetFingerprint(RDKit::ROMol *mol) = 0;
 };
 
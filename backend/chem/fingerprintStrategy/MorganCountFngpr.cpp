@@ -0,0 +1,42 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MorganCountFngpr.hpp"
+
+MorganCountFngpr::MorganCountFngpr(
+    unsigned int radius,
+    unsigned int nFoldBits,
+    bool useChirality,
+    bool useBondTypes
+    ) :
+    SparseFingerprintStrategy(nFoldBits),
+    mRadius(radius),
+    mUseChirality(useChirality),
+    mUseBondTypes(useBondTypes)
+{
+    // no-op
+}
+
+SparseFingerprint *MorganCountFngpr::GetSparseFingerprint(RDKit::ROMol *mol)
+{
+    RDKit::SparseIntVect<boost::uint32_t> *vect =
+        RDKit::MorganFingerprints::getFingerprint(*mol, mRadius, 0, 0,
+            mUseChirality, mUseBondTypes, true);
+    SparseFingerprint *result = Convert(*vect);
+    delete vect;
+    return result;
+}
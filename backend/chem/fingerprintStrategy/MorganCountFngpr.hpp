@@ -0,0 +1,49 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "SparseFingerprintStrategy.h"
+
+class MorganCountFngpr : public SparseFingerprintStrategy
+{
+public:
+    /**
+        Returns the unfolded Morgan fingerprint with occurrence counts.
+
+        @param radius [in] the number of iterations to grow the fingerprint
+        @param nFoldBits [in] the number of bits of the folded fingerprint
+            returned by GetFingerprint
+        @param useChirality [in] if set, additional information will be added to
+            the fingerprint when chiral atoms are discovered
+        @param useBondTypes [in] if set, bond types will be included as part of
+            the hash for calculating bits
+     */
+    MorganCountFngpr(
+        unsigned int radius = 2,
+        unsigned int nFoldBits = 2048,
+        bool useChirality = false,
+        bool useBondTypes = true
+        );
+
+    SparseFingerprint *GetSparseFingerprint(RDKit::ROMol *mol);
+
+private:
+    unsigned int mRadius;
+    bool mUseChirality;
+    bool mUseBondTypes;
+};
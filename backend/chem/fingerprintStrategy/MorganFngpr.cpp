@@ -38,7 +38,33 @@ MorganFngpr::~MorganFngpr()
 
 Fingerprint *MorganFngpr::GetFingerprint(RDKit::ROMol *mol)
 {
-    return RDKit::MorganFingerprints::getFingerprintAsBitVect(*mol, mRadius,
-        mNBits, mInvariants, mFromAtoms, mUseBondTypes, mOnlyNonzeroInvariants,
-        mAtomsSettingBits);
+    Environments *envs = GetEnvironments(mol);
+    Fingerprint *fp = Fold(*envs);
+    delete envs;
+    return fp;
+}
+
+MorganFngpr::Environments *MorganFngpr::GetEnvironments(RDKit::ROMol *mol)
+{
+    return RDKit::MorganFingerprints::getFingerprint(*mol, mRadius,
+        mInvariants, mFromAtoms, mUseChirality, mUseBondTypes, false,
+        mOnlyNonzeroInvariants, mAtomsSettingBits);
+}
+
+Fingerprint *MorganFngpr::Fold(const Environments &envs)
+{
+    // same folding as getFingerprintAsBitVect, identifier modulo length
+    Fingerprint *fp = new Fingerprint(mNBits);
+    Environments::StorageType::const_iterator it;
+    for (it = envs.getNonzeroElements().begin();
+            it != envs.getNonzeroElements().end(); ++it) {
+        fp->setBit(it->first % mNBits);
+    }
+    return fp;
+}
+
+bool MorganFngpr::SharesSAScoreEnvironments() const
+{
+    return (mRadius == 2) && (mInvariants == 0) && (mFromAtoms == 0) &&
+        !mUseChirality && mUseBondTypes && !mOnlyNonzeroInvariants;
 }
\ No newline at end of file
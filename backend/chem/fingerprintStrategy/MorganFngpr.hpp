@@ -44,22 +44,49 @@ public:
             information about the atoms that set each particular bit. The keys
             are the map are bit ids, the values are lists of (atomId, radius)
             pairs.
+
+        The defaults (chirality, no bond types) are what FP_MORGAN has always
+        computed, so stored fingerprints and distances stay comparable.
      */
     MorganFngpr(
         unsigned int radius = 2,
         unsigned int nBits = 2048,
         std::vector<boost::uint32_t> *invariants = 0,
         const std::vector<boost::uint32_t> *fromAtoms = 0,
-        bool useChirality = false,
-        bool useBondTypes = true,
+        bool useChirality = true,
+        bool useBondTypes = false,
         bool onlyNonzeroInvariants = false,
         RDKit::MorganFingerprints::BitInfoMap *atomsSettingBits = 0
         );
 
     ~MorganFngpr();
 
+    typedef RDKit::SparseIntVect<boost::uint32_t> Environments;
+
+    /**
+        Returns the bit vector, computed as GetEnvironments folded by Fold.
+     */
     Fingerprint *GetFingerprint(RDKit::ROMol *mol);
 
+    /**
+        Returns the unfolded (2^32) environment identifiers of a molecule,
+        each present with count one. Caller owns the result.
+     */
+    Environments *GetEnvironments(RDKit::ROMol *mol);
+
+    /**
+        Folds environments returned by GetEnvironments into the bit vector.
+     */
+    Fingerprint *Fold(const Environments &envs);
+
+    /**
+        True if GetEnvironments yields the fragments SAScore works with
+        (radius 2, bond types, no chirality, default invariants), so one
+        pass over a molecule can serve both. False for the FP_MORGAN
+        defaults; SAScore then computes its own environments.
+     */
+    bool SharesSAScoreEnvironments() const;
+
 private:
     unsigned int mRadius;
     unsigned int mNBits;
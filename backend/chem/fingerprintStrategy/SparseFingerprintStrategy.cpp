@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SparseFingerprintStrategy.h"
+
+// include strategies ..
+#include "AtomPairsCountFngpr.hpp"
+#include "MorganCountFngpr.hpp"
+
+SparseFingerprintStrategy::SparseFingerprintStrategy(unsigned int nFoldBits) :
+    mNFoldBits(nFoldBits)
+{
+    // no-op
+}
+
+Fingerprint *SparseFingerprintStrategy::GetFingerprint(RDKit::ROMol *mol)
+{
+    SparseFingerprint *sparse = GetSparseFingerprint(mol);
+    Fingerprint *result = Fold(*sparse, mNFoldBits);
+    delete sparse;
+    return result;
+}
+
+Fingerprint *SparseFingerprintStrategy::Fold(
+    const SparseFingerprint &fp, unsigned int nBits)
+{
+    Fingerprint *result = new Fingerprint(nBits);
+    SparseFingerprint::const_iterator it;
+    for (it = fp.begin(); it != fp.end(); ++it) {
+        result->setBit(it->first % nBits);
+    }
+    return result;
+}
+
+SparseFingerprint *GetSparseFingerprint(RDKit::ROMol *mol, FingerprintSelector fp)
+{
+    SparseFingerprint *result;
+
+    SparseFingerprintStrategy *strategy;
+    switch (fp) {
+    case FP_ATOM_PAIRS_COUNTS:
+        strategy = new AtomPairsCountFngpr();
+        break;
+    case FP_MORGAN_COUNTS:
+        strategy = new MorganCountFngpr();
+        break;
+    default:
+        strategy = new MorganCountFngpr();
+        break;
+    }
+
+    result = strategy->GetSparseFingerprint(mol);
+    delete strategy;
+    return result;
+}
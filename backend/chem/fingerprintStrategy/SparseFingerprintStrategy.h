@@ -0,0 +1,68 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <DataStructs/SparseIntVect.h>
+
+#include "FingerprintStrategy.h"
+
+/**
+    Fingerprint strategy that keeps the unfolded count form of the
+    fingerprint. The folded bit vector is still available through
+    GetFingerprint so that the sparse strategies can be used wherever
+    a plain bit fingerprint is expected (dimension reduction, frontend).
+ */
+class SparseFingerprintStrategy : public FingerprintStrategy
+{
+public:
+    SparseFingerprintStrategy(unsigned int nFoldBits = 2048);
+
+    virtual SparseFingerprint *GetSparseFingerprint(RDKit::ROMol *mol) = 0;
+
+    /// Fingerprint folded to nFoldBits, count information is lost.
+    Fingerprint *GetFingerprint(RDKit::ROMol *mol);
+
+    static Fingerprint *Fold(const SparseFingerprint &fp, unsigned int nBits);
+
+protected:
+    /// Non-zero elements of RDKit map are already ordered by key.
+    template <typename IndexType>
+    static SparseFingerprint *Convert(const RDKit::SparseIntVect<IndexType> &vect)
+    {
+        typedef typename RDKit::SparseIntVect<IndexType>::StorageType Storage;
+        const Storage &elements = vect.getNonzeroElements();
+
+        SparseFingerprint *result = new SparseFingerprint();
+        result->reserve(elements.size());
+        for (typename Storage::const_iterator it = elements.begin();
+                it != elements.end(); ++it) {
+            if (it->second > 0) {
+                result->push_back(std::make_pair(
+                    static_cast<boost::uint32_t>(it->first),
+                    static_cast<boost::uint32_t>(it->second)));
+            }
+        }
+        return result;
+    }
+
+private:
+    unsigned int mNFoldBits;
+};
+
+SparseFingerprint *GetSparseFingerprint(
+    RDKit::ROMol *mol, FingerprintSelector fp = FP_MORGAN_COUNTS);
@@ -33,6 +33,9 @@
 #include "MorphingData.h"
 #include "chem/morphingStrategy/MorphingStrategy.h"
 #include "chem/SimCoefCalculator.hpp"
+#include "chem/FoldedScreen.hpp"
+#include "chem/fingerprintStrategy/MorganFngpr.hpp"
+#include "chem/morphing/MorphingStatsCollector.hpp"
 
 class CalculateDistances
 {
@@ -42,9 +45,17 @@ public:
         SimCoefCalculator &scCalc,
         Fingerprint *targetFp,
         std::vector<Fingerprint *> &decoysFp,
+        SparseFingerprint *targetSparseFp,
+        std::vector<SparseFingerprint *> &decoysSparseFp,
+        MorganFngpr::Environments **environments,
         double *distToTarget,
         double *distToClosestDecoy,
-        int nextDecoy
+        int nextDecoy,
+        FoldedScreen *screen,
+        double screenCutoff,
+        tbb::atomic<unsigned int> &screenedOutCount,
+        const ChemOperSelector *opers = NULL,
+        MorphingStatsCollector *stats = NULL
         );
 
     void operator()(const tbb::blocked_range<int> &r) const;
@@ -54,6 +65,11 @@ public:
     SimCoefCalculator &mScCalc;
     Fingerprint *mTargetFp;
     std::vector<Fingerprint *> &mDecoysFp;
+    // used instead of the above when mScCalc.IsSparse()
+    SparseFingerprint *mTargetSparseFp;
+    std::vector<SparseFingerprint *> &mDecoysSparseFp;
+    // environments shared with SAScore, NULL if not shared
+    MorganFngpr::Environments **mEnvironments;
 
     double *mDistToTarget;
     double *mDistToClosestDecoy;
@@ -62,4 +78,17 @@ public:
      * Determine next decoy to visit.
      */
     int mNextDecoy;
+
+    /**
+     * Optional first tier (NULL if disabled). Reference 0 is the target,
+     * reference 1 the next decoy. Morphs whose lower bound of
+     * distToTarget + distToClosestDecoy exceeds the cutoff are dropped
+     * without computing the full fingerprint.
+     */
+    FoldedScreen *mScreen;
+    double mScreenCutoff;
+    tbb::atomic<unsigned int> &mScreenedOutCount;
+    // the release of screened morphs is charged to their operator
+    const ChemOperSelector *mOpers;
+    MorphingStatsCollector *mStats;
 };
\ No newline at end of file
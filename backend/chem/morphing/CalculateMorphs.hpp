@@ -26,6 +26,8 @@
 #include <tbb/atomic.h>
 #include <tbb/blocked_range.h>
 
+#include <boost/cstdint.hpp>
+
 #include "chemoper_selectors.h"
 #include "chem/fingerprintStrategy/FingerprintStrategy.h"
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
@@ -33,19 +35,87 @@
 #include "MorphingData.h"
 #include "chem/morphingStrategy/MorphingStrategy.h"
 #include "chem/SimCoefCalculator.hpp"
+#include "chem/fingerprintStrategy/MorganFngpr.hpp"
+#include "chem/morphing/Morphing.hpp"
+#include "chem/morphing/ChemOperBandit.hpp"
+#include "chem/morphing/MorphingStatsCollector.hpp"
 
 class CalculateMorphs
 {
 public:
+    /**
+     * Canonical graph hashes of the graphs seen by one GenerateMorphs call,
+     * each with the MolpherGraph::GetKey of the first graph that had it
+     * (empty if the hash identifies the graph). Open addressing over
+     * storage that is kept between calls, so reuse does not allocate.
+     */
+    class GraphKeyTable
+    {
+    public:
+        enum InsertResult
+        {
+            INSERTED,
+            SAME_GRAPH,
+            HASH_COLLISION
+        };
+
+        /// Makes room for count graphs and forgets the previous ones.
+        void Reset(size_t count);
+
+        /**
+         * Records the graph with hash and key (NULL if the hash identifies
+         * the graph) under the given slot, unless its hash is already
+         * there. Each slot must be used at most once after Reset.
+         */
+        InsertResult Insert(boost::uint64_t hash, const std::string *key,
+            size_t slot);
+
+        size_t GetCapacity() const;
+
+    private:
+        enum EntryState
+        {
+            ENTRY_EMPTY,
+            ENTRY_WRITING,
+            ENTRY_READY
+        };
+
+        struct Entry
+        {
+            tbb::atomic<int> state;
+            boost::uint64_t hash;
+            size_t slot;
+            bool hasKey;
+        };
+
+        std::vector<Entry> mEntries;
+        std::vector<std::string> mKeys;
+    };
+
     CalculateMorphs(
         MorphingData &data,
         std::vector<MorphingStrategy *> &strategies,
+        const EditDescriptor *edits,
+        const std::vector<int> *strategyWeights,
+        ChemOperBandit *bandit,
+        MorphingStatsCollector *stats,
         ChemOperSelector *opers,
         RDKit::RWMol **newMols,
         std::string *smiles,
         std::string *formulas,
         double *weights,
         double *sascores,
+        MorganFngpr *sharedMorgan,
+        MorganFngpr::Environments **environments,
+        boost::uint64_t *hashes,
+        GraphKeyTable &graphKeys,
+        const GraphHashMap *knownGraphs,
+        tbb::atomic<unsigned int> &valenceRejectCount,
+        tbb::atomic<unsigned int> &aromaticityRejectCount,
+        tbb::atomic<unsigned int> &disconnectedRejectCount,
+        tbb::atomic<unsigned int> &duplicateCount,
+        tbb::atomic<unsigned int> &knownCount,
+        tbb::atomic<unsigned int> &hashFallbackCount,
         tbb::atomic<unsigned int> &kekulizeFailureCount,
         tbb::atomic<unsigned int> &sanitizeFailureCount,
         tbb::atomic<unsigned int> &morphingFailureCount
@@ -56,6 +126,19 @@ public:
 private:
     MorphingData &mData;
     std::vector<MorphingStrategy *> &mStrategies;
+    /**
+     * Edits to apply (one per attempt) or NULL to pick them at random.
+     */
+    const EditDescriptor *mEdits;
+    /**
+     * Cumulative weights of mStrategies (see ChemOperBandit) or NULL to
+     * pick them uniformly.
+     */
+    const std::vector<int> *mStrategyWeights;
+    // if not NULL, the time of each attempt is charged to its operator
+    ChemOperBandit *mBandit;
+    // per operator counters and timing or NULL
+    MorphingStatsCollector *mStats;
 
     ChemOperSelector *mOpers;
     RDKit::RWMol **mNewMols;
@@ -63,6 +146,32 @@ private:
     std::string *mFormulas;
     double *mWeights;
     double *mSascore;
+    /**
+     * If not NULL, Morgan environments computed for SAScore are kept in
+     * mEnvironments so that CalculateDistances only folds them.
+     */
+    MorganFngpr *mSharedMorgan;
+    MorganFngpr::Environments **mEnvironments;
+    boost::uint64_t *mHashes;
+    /**
+     * Graphs converted so far. A morph with the hash of an earlier one is
+     * dropped if the hash identifies the graph or the keys are equal.
+     * Otherwise it is converted and CollectMorphs compares the SMILES.
+     */
+    GraphKeyTable &mGraphKeys;
+    /**
+     * Molecules already in the tree or NULL. A morph with a known hash is
+     * dropped without conversion if the hash identifies the graph, else
+     * only if its SMILES equals the stored one.
+     */
+    const GraphHashMap *mKnownGraphs;
+    // morphs rejected by MolpherGraph::FindDefect before sanitization
+    tbb::atomic<unsigned int> &mValenceRejectCount;
+    tbb::atomic<unsigned int> &mAromaticityRejectCount;
+    tbb::atomic<unsigned int> &mDisconnectedRejectCount;
+    tbb::atomic<unsigned int> &mDuplicateCount;
+    tbb::atomic<unsigned int> &mKnownCount;
+    tbb::atomic<unsigned int> &mHashFallbackCount;
     tbb::atomic<unsigned int> &mKekulizeFailureCount;
     tbb::atomic<unsigned int> &mSanitizeFailureCount;
     tbb::atomic<unsigned int> &mMorphingFailureCount;
@@ -0,0 +1,141 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "auxiliary/SynchRand.h"
+#include "chem/morphing/ChemOperBandit.hpp"
+
+// probability spread evenly over all operators regardless of their rating
+static const double MIN_EXPLORATION = 0.1;
+// weight of the totals from the previous iterations
+static const double DECAY = 0.8;
+// prior shared by all operators, avoids starving the ones not tried yet
+static const double PRIOR_SURVIVORS = 1.0;
+static const double PRIOR_MILISECONDS = 100.0;
+
+ChemOperBandit::ChemOperBandit()
+{
+    Clear();
+}
+
+ChemOperBandit::ChemOperBandit(const ChemOperBandit &other)
+{
+    Assign(other);
+}
+
+ChemOperBandit &ChemOperBandit::operator=(const ChemOperBandit &other)
+{
+    if (this != &other) {
+        Assign(other);
+    }
+    return *this;
+}
+
+void ChemOperBandit::Assign(const ChemOperBandit &other)
+{
+    for (int i = 0; i < OPER_COUNT; ++i) {
+        mPendingSurvivors[i] = other.mPendingSurvivors[i];
+        mPendingMicroseconds[i] = other.mPendingMicroseconds[i];
+        mSurvivors[i] = other.mSurvivors[i];
+        mMiliseconds[i] = other.mMiliseconds[i];
+    }
+}
+
+void ChemOperBandit::AddCost(ChemOperSelector oper, double seconds)
+{
+    mPendingMicroseconds[oper] += static_cast<boost::uint64_t>(seconds * 1e6);
+}
+
+void ChemOperBandit::AddSurvivor(ChemOperSelector oper)
+{
+    ++mPendingSurvivors[oper];
+}
+
+void ChemOperBandit::EndIteration()
+{
+    for (int i = 0; i < OPER_COUNT; ++i) {
+        mSurvivors[i] = DECAY * mSurvivors[i] +
+            mPendingSurvivors[i].fetch_and_store(0);
+        mMiliseconds[i] = DECAY * mMiliseconds[i] +
+            mPendingMicroseconds[i].fetch_and_store(0) / 1000.0;
+    }
+}
+
+void ChemOperBandit::GetCumulativeWeights(
+    const std::vector<ChemOperSelector> &opers,
+    std::vector<int> &cumulative) const
+{
+    cumulative.clear();
+    if (opers.empty()) {
+        return;
+    }
+
+    std::vector<double> ratings(opers.size());
+    double ratingSum = 0.0;
+    for (size_t i = 0; i < opers.size(); ++i) {
+        ratings[i] = (mSurvivors[opers[i]] + PRIOR_SURVIVORS) /
+            (mMiliseconds[opers[i]] + PRIOR_MILISECONDS);
+        ratingSum += ratings[i];
+    }
+
+    double sum = 0.0;
+    cumulative.resize(opers.size());
+    for (size_t i = 0; i < opers.size(); ++i) {
+        sum += MIN_EXPLORATION / opers.size() +
+            (1.0 - MIN_EXPLORATION) * ratings[i] / ratingSum;
+        cumulative[i] = static_cast<int>(sum * WEIGHT_SCALE);
+    }
+    cumulative.back() = WEIGHT_SCALE;
+}
+
+int ChemOperBandit::Sample(const std::vector<int> &cumulative)
+{
+    int draw = SynchRand::GetRandomNumber(WEIGHT_SCALE - 1);
+    return std::upper_bound(cumulative.begin(), cumulative.end(), draw) -
+        cumulative.begin();
+}
+
+void ChemOperBandit::Save(std::vector<double> &survivors,
+    std::vector<double> &miliseconds) const
+{
+    survivors.assign(mSurvivors, mSurvivors + OPER_COUNT);
+    miliseconds.assign(mMiliseconds, mMiliseconds + OPER_COUNT);
+}
+
+void ChemOperBandit::Load(const std::vector<double> &survivors,
+    const std::vector<double> &miliseconds)
+{
+    Clear();
+    // snapshots of new jobs carry no statistics
+    for (size_t i = 0; i < OPER_COUNT && i < survivors.size(); ++i) {
+        mSurvivors[i] = survivors[i];
+    }
+    for (size_t i = 0; i < OPER_COUNT && i < miliseconds.size(); ++i) {
+        mMiliseconds[i] = miliseconds[i];
+    }
+}
+
+void ChemOperBandit::Clear()
+{
+    for (int i = 0; i < OPER_COUNT; ++i) {
+        mPendingSurvivors[i] = 0;
+        mPendingMicroseconds[i] = 0;
+        mSurvivors[i] = 0.0;
+        mMiliseconds[i] = 0.0;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <tbb/atomic.h>
+
+#include "chemoper_selectors.h"
+
+/**
+ * Multi-armed bandit over the chemical operators. An operator is rated by
+ * the number of its morphs accepted into the tree per CPU milisecond spent
+ * on producing them (editing, conversion and properties). Operators are
+ * drawn proportionally to their rating, but each of them keeps at least
+ * its share of MIN_EXPLORATION of the probability.
+ *
+ * Costs and survivors are collected concurrently during the iteration and
+ * folded into decayed totals by EndIteration, so the weights do not change
+ * while the morphs of one iteration are generated.
+ */
+class ChemOperBandit
+{
+public:
+    static const int OPER_COUNT = OP_BOND_CONTRACTION + 1;
+    // resolution of the cumulative weights
+    static const int WEIGHT_SCALE = 1 << 16;
+
+    ChemOperBandit();
+    ChemOperBandit(const ChemOperBandit &other);
+    ChemOperBandit &operator=(const ChemOperBandit &other);
+
+    void AddCost(ChemOperSelector oper, double seconds);
+    void AddSurvivor(ChemOperSelector oper);
+    void EndIteration();
+
+    /**
+     * Fills cumulative with running sums of the operator weights in the
+     * given order, the last one equals WEIGHT_SCALE.
+     */
+    void GetCumulativeWeights(const std::vector<ChemOperSelector> &opers,
+        std::vector<int> &cumulative) const;
+    /// Index into the cumulative weights drawn at random.
+    static int Sample(const std::vector<int> &cumulative);
+
+    void Save(std::vector<double> &survivors,
+        std::vector<double> &miliseconds) const;
+    void Load(const std::vector<double> &survivors,
+        const std::vector<double> &miliseconds);
+    void Clear();
+
+private:
+    void Assign(const ChemOperBandit &other);
+
+    tbb::atomic<boost::uint32_t> mPendingSurvivors[OPER_COUNT];
+    tbb::atomic<boost::uint64_t> mPendingMicroseconds[OPER_COUNT];
+    double mSurvivors[OPER_COUNT];
+    double mMiliseconds[OPER_COUNT];
+};
@@ -16,8 +16,10 @@
  */
 
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <GraphMol/GraphMol.h>
 #include <GraphMol/SmilesParse/SmilesParse.h>
@@ -26,15 +28,19 @@
 #include <tbb/partitioner.h>
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
 
 #include "main.hpp"
 #include "inout.h"
+#include "auxiliary/SynchRand.h"
 #include "chem/fingerprintStrategy/FingerprintStrategy.h"
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
 #include "MorphingData.h"
 #include "chem/morphingStrategy/MorphingStrategy.h"
 #include "chem/morphing/MorphingFtors.hpp"
 #include "chem/morphing/Morphing.hpp"
+#include "chem/FoldedScreen.hpp"
+#include "chem/morphing/RWMolPool.hpp"
 
 // TODO: merge into one header file ?
 #include "chem/morphingStrategy/OpAddAtom.hpp"
@@ -52,43 +58,324 @@
 #define REPORT_RECOVERY(x)
 #endif
 
+// operators keep no state, all callers share one instance of each
+static OpAddAtom gOpAddAtom;
+static OpRemoveAtom gOpRemoveAtom;
+static OpAddBond gOpAddBond;
+static OpRemoveBond gOpRemoveBond;
+static OpMutateAtom gOpMutateAtom;
+static OpInterlayAtom gOpInterlayAtom;
+static OpBondReroute gOpBondReroute;
+static OpBondContraction gOpBondContraction;
+
+MorphingStrategy *GetMorphingStrategy(ChemOperSelector oper)
+{
+    switch (oper) {
+    case OP_ADD_ATOM:
+        return &gOpAddAtom;
+    case OP_REMOVE_ATOM:
+        return &gOpRemoveAtom;
+    case OP_ADD_BOND:
+        return &gOpAddBond;
+    case OP_REMOVE_BOND:
+        return &gOpRemoveBond;
+    case OP_MUTATE_ATOM:
+        return &gOpMutateAtom;
+    case OP_INTERLAY_ATOM:
+        return &gOpInterlayAtom;
+    case OP_BOND_REROUTE:
+        return &gOpBondReroute;
+    case OP_BOND_CONTRACTION:
+        return &gOpBondContraction;
+    default:
+        return NULL;
+    }
+}
+
 static void InitStrategies(
     std::vector<ChemOperSelector> &chemOperSelectors,
     std::vector<MorphingStrategy *> &strategies)
 {
+    strategies.clear();
     for (int i = 0; i < chemOperSelectors.size(); ++i) {
-        switch (chemOperSelectors[i]) {
-        case OP_ADD_ATOM:
-            strategies.push_back(new OpAddAtom());
-            break;
-        case OP_REMOVE_ATOM:
-            strategies.push_back(new OpRemoveAtom());
-            break;
-        case OP_ADD_BOND:
-            strategies.push_back(new OpAddBond());
-            break;
-        case OP_REMOVE_BOND:
-            strategies.push_back(new OpRemoveBond());
-            break;
-        case OP_MUTATE_ATOM:
-            strategies.push_back(new OpMutateAtom());
-            break;
-        case OP_INTERLAY_ATOM:
-            strategies.push_back(new OpInterlayAtom());
-            break;
-        case OP_BOND_REROUTE:
-            strategies.push_back(new OpBondReroute());
-            break;
-        case OP_BOND_CONTRACTION:
-            strategies.push_back(new OpBondContraction());
-            break;
-        default:
-            break;
+        MorphingStrategy *strategy = GetMorphingStrategy(chemOperSelectors[i]);
+        if (strategy) {
+            strategies.push_back(strategy);
+        }
+    }
+}
+
+static tbb::atomic<unsigned long> gWorkspaceAllocations;
+
+/*
+ Kekulized molecules by slot (target, then decoys). They stay the same
+ during a job, so they are parsed only when the SMILES of the slot
+ changes. NULL marks a SMILES that cannot be parsed or kekulized.
+ */
+class ParsedMolCache
+{
+public:
+    ~ParsedMolCache()
+    {
+        for (size_t i = 0; i < mMols.size(); ++i) {
+            delete mMols[i];
+        }
+    }
+
+    RDKit::RWMol *Get(size_t slot, const std::string &smile)
+    {
+        if (slot >= mMols.size()) {
+            mSmiles.resize(slot + 1);
+            mMols.resize(slot + 1, NULL);
+        } else if (mSmiles[slot] == smile) {
+            return mMols[slot];
+        }
+
+        delete mMols[slot];
+        mMols[slot] = NULL;
+        mSmiles[slot] = smile;
+        RDKit::RWMol *mol = NULL;
+        try {
+            mol = RDKit::SmilesToMol(smile);
+            if (mol) {
+                RDKit::MolOps::Kekulize(*mol);
+            }
+        } catch (const ValueErrorException &exc) {
+            delete mol;
+            mol = NULL;
+        }
+        mMols[slot] = mol;
+        return mol;
+    }
+
+private:
+    std::vector<std::string> mSmiles;
+    std::vector<RDKit::RWMol *> mMols;
+};
+
+/*
+ Buffers of one GenerateMorphs call. They only grow, so once a thread has
+ seen the largest morphAttempts of the job the buffers are not allocated
+ again. Growth is counted in gWorkspaceAllocations. The graph scratch of
+ CalculateMorphs is per thread and reused the same way.
+ */
+struct MorphingWorkspace
+{
+    MorphingWorkspace() :
+        mFootprint(0)
+    {
+        ++gWorkspaceAllocations;
+    }
+
+    // Makes room for size attempts and resets their slots.
+    void Prepare(size_t size)
+    {
+        size_t footprint = Footprint();
+        if (newMols.size() < size) {
+            newMols.resize(size);
+            opers.resize(size);
+            smiles.resize(size);
+            formulas.resize(size);
+            weights.resize(size);
+            sascores.resize(size);
+            hashes.resize(size);
+            environments.resize(size);
+            distToTarget.resize(size);
+            distToClosestDecoy.resize(size);
+        }
+        std::fill(newMols.begin(), newMols.begin() + size, (RDKit::RWMol *) NULL);
+        std::fill(hashes.begin(), hashes.begin() + size, 0);
+        std::fill(environments.begin(), environments.begin() + size,
+            (MorganFngpr::Environments *) NULL);
+        for (size_t i = 0; i < size; ++i) {
+            smiles[i].clear();
+            formulas[i].clear();
+        }
+        mFootprint = footprint;
+    }
+
+    // Gives back the morphs of the last call, buffers are kept.
+    void Release(size_t size, MorphingStatsCollector *stats)
+    {
+        for (size_t i = 0; i < size; ++i) {
+            if (newMols[i]) {
+                StageTimer allocTimer(stats ?
+                    &stats->Local().opers[opers[i]].allocNanoseconds : NULL);
+                RWMolPool::Release(newMols[i]);
+                newMols[i] = NULL;
+            }
+            delete environments[i];
+            environments[i] = NULL;
+        }
+        if (Footprint() > mFootprint) {
+            ++gWorkspaceAllocations;
+        }
+    }
+
+    size_t Footprint() const
+    {
+        size_t footprint = newMols.capacity() + plan.capacity() +
+            strategies.capacity() + strategyOpers.capacity() +
+            strategyWeights.capacity() + pools.capacity() + nonEmpty.capacity() +
+            graphKeys.GetCapacity() + bondKeys.capacity();
+        for (size_t i = 0; i < pools.size(); ++i) {
+            footprint += pools[i].capacity();
+        }
+        return footprint;
+    }
+
+    MorphingData data;
+    ParsedMolCache parsedMols;
+    std::vector<RDKit::RWMol *> newMols;
+    std::vector<ChemOperSelector> opers;
+    std::vector<std::string> smiles;
+    std::vector<std::string> formulas;
+    std::vector<double> weights;
+    std::vector<double> sascores;
+    std::vector<boost::uint64_t> hashes;
+    std::vector<MorganFngpr::Environments *> environments;
+    std::vector<double> distToTarget;
+    std::vector<double> distToClosestDecoy;
+    CalculateMorphs::GraphKeyTable graphKeys;
+    std::string candidateKey;
+    std::vector<boost::uint64_t> bondKeys;
+
+    std::vector<EditDescriptor> plan;
+    std::vector<MorphingStrategy *> strategies;
+    std::vector<ChemOperSelector> strategyOpers;
+    std::vector<int> strategyWeights;
+    // PlanEdits scratch
+    std::vector<std::vector<EditDescriptor> > pools;
+    std::vector<int> nonEmpty;
+
+private:
+    size_t mFootprint;
+};
+
+/*
+ Workspaces of one thread. The thread can enter GenerateMorphs again while
+ it waits for its parallel_for (work stealing), each nesting level gets its
+ own workspace.
+ */
+class WorkspaceStack
+{
+public:
+    WorkspaceStack() :
+        mDepth(0)
+    {
+    }
+
+    ~WorkspaceStack()
+    {
+        for (size_t i = 0; i < mItems.size(); ++i) {
+            delete mItems[i];
+        }
+    }
+
+    MorphingWorkspace &Push()
+    {
+        if (mDepth == mItems.size()) {
+            mItems.push_back(new MorphingWorkspace());
+        }
+        return *mItems[mDepth++];
+    }
+
+    void Pop()
+    {
+        --mDepth;
+    }
+
+private:
+    std::vector<MorphingWorkspace *> mItems;
+    size_t mDepth;
+};
+
+static tbb::enumerable_thread_specific<WorkspaceStack> gWorkspaces;
+
+class WorkspaceLease
+{
+public:
+    WorkspaceLease() :
+        mStack(gWorkspaces.local()),
+        mWorkspace(mStack.Push())
+    {
+    }
+
+    ~WorkspaceLease()
+    {
+        mStack.Pop();
+    }
+
+    MorphingWorkspace &Get()
+    {
+        return mWorkspace;
+    }
+
+private:
+    WorkspaceStack &mStack;
+    MorphingWorkspace &mWorkspace;
+};
+
+unsigned long GetMorphingWorkspaceAllocations()
+{
+    return gWorkspaceAllocations;
+}
+
+/*
+ Fills plan with edits to apply, one per attempt. If the whole edit space
+ fits into morphAttempts it is used completely, otherwise an operator is
+ chosen at random and one of its not yet planned edits is drawn (sampling
+ without replacement). Unused slots keep pos == -1.
+ */
+static void PlanEdits(
+    MorphingData &data,
+    std::vector<MorphingStrategy *> &strategies,
+    unsigned int morphAttempts,
+    std::vector<EditDescriptor> &plan,
+    std::vector<std::vector<EditDescriptor> > &pools,
+    std::vector<int> &nonEmpty)
+{
+    if (pools.size() < strategies.size()) {
+        pools.resize(strategies.size());
+    }
+    size_t spaceSize = 0;
+    for (int i = 0; i < strategies.size(); ++i) {
+        pools[i].clear();
+        data.Prepare(strategies[i]->GetSelector());
+        strategies[i]->EnumerateEdits(data, pools[i]);
+        spaceSize += pools[i].size();
+    }
+
+    plan.clear();
+    plan.reserve(morphAttempts);
+    if (spaceSize <= morphAttempts) {
+        for (int i = 0; i < strategies.size(); ++i) {
+            plan.insert(plan.end(), pools[i].begin(), pools[i].end());
+        }
+    } else {
+        nonEmpty.clear();
+        for (int i = 0; i < strategies.size(); ++i) {
+            if (!pools[i].empty()) {
+                nonEmpty.push_back(i);
+            }
+        }
+        while (plan.size() < morphAttempts) {
+            int which = SynchRand::GetRandomNumber(nonEmpty.size() - 1);
+            std::vector<EditDescriptor> &pool = pools[nonEmpty[which]];
+            int randPos = SynchRand::GetRandomNumber(pool.size() - 1);
+            plan.push_back(pool[randPos]);
+            pool[randPos] = pool.back();
+            pool.pop_back();
+            if (pool.empty()) {
+                nonEmpty[which] = nonEmpty.back();
+                nonEmpty.pop_back();
+            }
         }
     }
+    plan.resize(morphAttempts);
 }
 
-void GenerateMorphs(
+unsigned int GenerateMorphs(
     MolpherMolecule &candidate,
     unsigned int morphAttempts,
     FingerprintSelector fingerprintSelector,
@@ -98,8 +385,15 @@ void GenerateMorphs(
     std::vector<MolpherMolecule> &decoys,
     tbb::task_group_context &tbbCtx ,
     void *callerState,
-    void (*deliver)(MolpherMolecule *, void *) )
+    void (*deliver)(MolpherMolecule *, void *),
+    double screenCutoff,
+    const GraphHashMap *knownGraphs,
+    ChemOperBandit *bandit,
+    MorphingStatsCollector *stats)
 {
+    WorkspaceLease lease;
+    MorphingWorkspace &ws = lease.Get();
+
     RDKit::RWMol *mol = NULL;
     try {
         mol = RDKit::SmilesToMol(candidate.smile);
@@ -110,38 +404,36 @@ void GenerateMorphs(
         }
     } catch (const ValueErrorException &exc) {
         delete mol;
-        return;
+        return 0;
     }
 
-    RDKit::RWMol *targetMol = NULL;
-    try {
-        targetMol = RDKit::SmilesToMol(target.smile);
-        if (targetMol) {
-            RDKit::MolOps::Kekulize(*targetMol);
-        } else {
-            throw ValueErrorException("");
-        }
-    } catch (const ValueErrorException &exc) {
-        delete targetMol;
+    // owned by the workspace, parsed again only if the target changes
+    RDKit::RWMol *targetMol = ws.parsedMols.Get(0, target.smile);
+    if (!targetMol) {
         delete mol;
-        return;
+        return 0;
     }
 
     SimCoefCalculator scCalc(simCoeffSelector , fingerprintSelector, mol, targetMol);
 
     Fingerprint *targetFp = scCalc.GetFingerprint(targetMol);
+    SparseFingerprint *targetSparseFp = NULL;
+    if (scCalc.IsSparse()) {
+        targetSparseFp = scCalc.GetSparseFingerprint(targetMol);
+    }
 
     std::vector<Fingerprint *> decoysFp;
+    std::vector<SparseFingerprint *> decoysSparseFp;
     decoysFp.reserve(decoys.size());
-    RDKit::RWMol *decoyMol = NULL;
     try {
         for (int i = 0; i < decoys.size(); ++i) {
-            RDKit::RWMol *decoyMol = RDKit::SmilesToMol(decoys[i].smile);
+            RDKit::RWMol *decoyMol = ws.parsedMols.Get(i + 1, decoys[i].smile);
             if (decoyMol) {
-                RDKit::MolOps::Kekulize(*decoyMol);
                 decoysFp.push_back(scCalc.GetFingerprint(decoyMol));
-                delete decoyMol;
-                decoyMol = NULL;
+                if (scCalc.IsSparse()) {
+                    decoysSparseFp.push_back(
+                        scCalc.GetSparseFingerprint(decoyMol));
+                }
             } else {
                 throw ValueErrorException("");
             }
@@ -151,45 +443,135 @@ void GenerateMorphs(
         for (int i = 0; i < decoysFp.size(); ++i) {
             delete decoysFp[i];
         }
-        delete decoyMol;
-        delete targetMol;
+        for (int i = 0; i < decoysSparseFp.size(); ++i) {
+            delete decoysSparseFp[i];
+        }
+        delete targetSparseFp;
+        delete targetFp;
         delete mol;
-        return;
+        return 0;
     }
-    
-    std::vector<MorphingStrategy *> strategies;
+
+    std::vector<MorphingStrategy *> &strategies = ws.strategies;
     InitStrategies(chemOperSelectors, strategies);
 
-    RDKit::RWMol **newMols = new RDKit::RWMol *[morphAttempts];
-    std::memset(newMols, 0, sizeof(RDKit::RWMol *) * morphAttempts);
-    ChemOperSelector *opers = new ChemOperSelector [morphAttempts];
-    std::string *smiles = new std::string [morphAttempts];
-    std::string *formulas = new std::string [morphAttempts];
-    double *weights = new double [morphAttempts];
-    double *sascores = new double [morphAttempts]; // added for SAScore
-    double *distToTarget = new double [morphAttempts];
-    double *distToClosestDecoy = new double [morphAttempts];
-                
+    ws.Prepare(std::max(morphAttempts, 1u));
+    RDKit::RWMol **newMols = &ws.newMols[0];
+    ChemOperSelector *opers = &ws.opers[0];
+    std::string *smiles = &ws.smiles[0];
+    std::string *formulas = &ws.formulas[0];
+    double *weights = &ws.weights[0];
+    double *sascores = &ws.sascores[0]; // added for SAScore
+    boost::uint64_t *hashes = &ws.hashes[0];
+    // Morgan environments shared by SAScore and the fingerprint
+    MorganFngpr *sharedMorgan = scCalc.GetSharedMorganStrategy();
+    MorganFngpr::Environments **environments = NULL;
+    if (sharedMorgan) {
+        environments = &ws.environments[0];
+    }
+    double *distToTarget = &ws.distToTarget[0];
+    double *distToClosestDecoy = &ws.distToClosestDecoy[0];
+
     // compute new morphs and smiles
     if (!tbbCtx.is_group_execution_cancelled()) {
+        CalculateMorphs::GraphKeyTable &graphKeys = ws.graphKeys;
+        // morph slots and one for the candidate
+        graphKeys.Reset(morphAttempts + 1);
+        tbb::atomic<unsigned int> valenceRejectCount;
+        tbb::atomic<unsigned int> aromaticityRejectCount;
+        tbb::atomic<unsigned int> disconnectedRejectCount;
+        tbb::atomic<unsigned int> duplicateCount;
+        tbb::atomic<unsigned int> knownCount;
+        tbb::atomic<unsigned int> hashFallbackCount;
         tbb::atomic<unsigned int> kekulizeFailureCount;
         tbb::atomic<unsigned int> sanitizeFailureCount;
         tbb::atomic<unsigned int> morphingFailureCount;
+        valenceRejectCount = 0;
+        aromaticityRejectCount = 0;
+        disconnectedRejectCount = 0;
+        duplicateCount = 0;
+        knownCount = 0;
+        hashFallbackCount = 0;
         kekulizeFailureCount = 0;
         sanitizeFailureCount = 0;
         morphingFailureCount = 0;
         try {
-            MorphingData data(*mol, *targetMol, chemOperSelectors);
-            
+            MorphingData &data = ws.data;
+            data.Reset(*mol, *targetMol, chemOperSelectors);
+            {
+                // morphs identical to the candidate count as duplicates
+                bool discrete = false;
+                boost::uint64_t hash = data.graph.GetCanonicalHash(&discrete);
+                if (!discrete) {
+                    data.graph.GetKey(ws.candidateKey, ws.bondKeys);
+                }
+                graphKeys.Insert(hash, discrete ? NULL : &ws.candidateKey,
+                    morphAttempts);
+            }
+
+            std::vector<EditDescriptor> &plan = ws.plan;
+            plan.clear();
+#if MORPHING_EDIT_SPACE == 1
+            PlanEdits(data, strategies, morphAttempts, plan, ws.pools,
+                ws.nonEmpty);
+#endif
+            std::vector<int> &strategyWeights = ws.strategyWeights;
+            strategyWeights.clear();
+            if (bandit && plan.empty()) {
+                std::vector<ChemOperSelector> &strategyOpers = ws.strategyOpers;
+                strategyOpers.clear();
+                for (int i = 0; i < strategies.size(); ++i) {
+                    strategyOpers.push_back(strategies[i]->GetSelector());
+                }
+                bandit->GetCumulativeWeights(strategyOpers, strategyWeights);
+            }
+
             CalculateMorphs calculateMorphs(
-                data, strategies, opers, newMols, smiles, formulas, weights, sascores,
-                kekulizeFailureCount, sanitizeFailureCount, morphingFailureCount);
+                data, strategies, plan.empty() ? NULL : &plan[0],
+                strategyWeights.empty() ? NULL : &strategyWeights, bandit, stats,
+                opers, newMols, smiles, formulas, weights, sascores,
+                sharedMorgan, environments, hashes, graphKeys, knownGraphs,
+                valenceRejectCount, aromaticityRejectCount,
+                disconnectedRejectCount, duplicateCount, knownCount,
+                hashFallbackCount, kekulizeFailureCount, sanitizeFailureCount,
+                morphingFailureCount);
             
             tbb::parallel_for(tbb::blocked_range<int>(0, morphAttempts),
                 calculateMorphs, tbb::auto_partitioner(), tbbCtx);
         } catch (const std::exception &exc) {
             REPORT_RECOVERY("Recovered from morphing data construction failure.");
         }
+        unsigned int structureRejectCount = valenceRejectCount +
+            aromaticityRejectCount;
+        if (structureRejectCount > 0) {
+            std::stringstream report;
+            report << "Saved " << structureRejectCount <<
+                " sanitizations by structure pre-check (valence " <<
+                valenceRejectCount << ", aromaticity " <<
+                aromaticityRejectCount << ").";
+            REPORT_RECOVERY(report.str());
+        }
+        if (disconnectedRejectCount > 0) {
+            std::stringstream report;
+            report << "Rejected " << disconnectedRejectCount <<
+                " empty or disconnected morphs.";
+            REPORT_RECOVERY(report.str());
+        }
+        if (duplicateCount > 0) {
+            std::stringstream report;
+            report << "Skipped " << duplicateCount << " duplicate morphs before conversion.";
+            REPORT_RECOVERY(report.str());
+        }
+        if (knownCount > 0) {
+            std::stringstream report;
+            report << "Skipped " << knownCount << " morphs already in the tree.";
+            REPORT_RECOVERY(report.str());
+        }
+        if (hashFallbackCount > 0) {
+            std::stringstream report;
+            report << "Compared SMILES of " << hashFallbackCount << " morphs with ambiguous graph hash.";
+            REPORT_RECOVERY(report.str());
+        }
         if (kekulizeFailureCount > 0) {
             std::stringstream report;
             report << "Recovered from " << kekulizeFailureCount << " kekulization failures.";
@@ -209,9 +591,23 @@ void GenerateMorphs(
     
     // compute distances
     // we need to announce the decoy which we want to use    
+    int nextDecoy = 0/*candidate.nextDecoy*/;
+    tbb::atomic<unsigned int> screenedOutCount;
+    screenedOutCount = 0;
+    FoldedScreen *screen = NULL;
+    if (screenCutoff >= 0.0 && !scCalc.IsSparse() &&
+            FoldedScreen::IsApplicable(fingerprintSelector, simCoeffSelector)) {
+        screen = new FoldedScreen(fingerprintSelector);
+        screen->AddReference(targetFp);
+        if (nextDecoy < decoysFp.size()) {
+            screen->AddReference(decoysFp[nextDecoy]);
+        }
+    }
     if (!tbbCtx.is_group_execution_cancelled()) {
         CalculateDistances calculateDistances(newMols, scCalc, targetFp,
-            decoysFp, distToTarget, distToClosestDecoy, 0/*candidate.nextDecoy*/);
+            decoysFp, targetSparseFp, decoysSparseFp, environments, distToTarget,
+            distToClosestDecoy, nextDecoy, screen, screenCutoff,
+            screenedOutCount, opers, stats);
         tbb::parallel_for(tbb::blocked_range<int>(0, morphAttempts),
             calculateDistances, tbb::auto_partitioner(), tbbCtx);
     }
@@ -220,33 +616,25 @@ void GenerateMorphs(
     if (!tbbCtx.is_group_execution_cancelled()) {
         ReturnResults returnResults(
             newMols, smiles, formulas, candidate.smile, opers, weights, sascores,
-            distToTarget, distToClosestDecoy, callerState, deliver);
+            hashes, distToTarget, distToClosestDecoy, callerState, deliver);
         tbb::parallel_for(tbb::blocked_range<int>(0, morphAttempts),
             returnResults, tbb::auto_partitioner(), tbbCtx);
     }
     
-    for (int i = 0; i < morphAttempts; ++i) {
-        delete newMols[i];
-    }
-    delete[] newMols;
-    delete[] opers;
-    delete[] smiles;
-    delete[] formulas;
-    delete[] weights;
-    delete[] sascores;
-    delete[] distToTarget;
-    delete[] distToClosestDecoy;
+    ws.Release(morphAttempts, stats);
 
     delete mol;
-    delete targetMol;
     delete targetFp;
+    delete targetSparseFp;
 
     for (int i = 0; i < decoysFp.size(); ++i) {
         delete decoysFp[i];
     }
-
-    for (int i = 0; i < strategies.size(); ++i) {
-        delete strategies[i];
+    for (int i = 0; i < decoysSparseFp.size(); ++i) {
+        delete decoysSparseFp[i];
     }
-    
+
+    delete screen;
+
+    return screenedOutCount;
 }
@@ -18,17 +18,54 @@
 #pragma once
 
 #include <vector>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+#include <tbb/concurrent_hash_map.h>
 
 #include "fingerprint_selectors.h"
 #include "simcoeff_selectors.h"
 #include "chemoper_selectors.h"
 #include "MolpherMolecule.h"
+#include "chem/morphing/ChemOperBandit.hpp"
+#include "chem/morphing/MorphingStatsCollector.hpp"
 
 #ifndef MORPHING_REPORTING
 #define MORPHING_REPORTING 1
 #endif
 
-void GenerateMorphs(
+// list all edits of the candidate and apply each at most once (all of them
+// if there are at most morphAttempts) instead of sampling with replacement
+#ifndef MORPHING_EDIT_SPACE
+#define MORPHING_EDIT_SPACE 0
+#endif
+
+class MorphingStrategy;
+
+/**
+ * Canonical graph hash (see MolpherGraph::GetCanonicalHash) to SMILES of
+ * the molecule it was computed for.
+ */
+typedef tbb::concurrent_hash_map<boost::uint64_t, std::string> GraphHashMap;
+
+/**
+ * Generates morphs of the candidate and delivers them to the caller.
+ * If screenCutoff is not negative and the selectors allow it, morphs
+ * whose distance bound exceeds the cutoff are dropped without the full
+ * distance computation (see FoldedScreen).
+ * Morphs whose graph hash is in knownGraphs are dropped before their
+ * descriptors are computed. Unless the hash identifies the graph, the SMILES
+ * stored for it is compared first (see CalculateMorphs).
+ * If bandit is given, operators are drawn by its weights and the cost of
+ * every attempt is charged to it.
+ * If stats is given, the per operator counters of the attempts are added
+ * to the calling thread's MorphingStats.
+ * deliver may take over the content of the morph (MolpherMolecule::Swap),
+ * it is not used after the call.
+ * @return number of morphs dropped by the screening
+ */
+unsigned int GenerateMorphs(
     MolpherMolecule &candidate,
     unsigned int morphAttempts,
     FingerprintSelector fingerprintSelector,
@@ -38,5 +75,25 @@ void GenerateMorphs(
     std::vector<MolpherMolecule> &decoys,
     tbb::task_group_context &tbbCtx,
     void *callerState,
-    void (*deliver)(MolpherMolecule *, void *)
+    void (*deliver)(MolpherMolecule *, void *),
+    double screenCutoff = -1.0,
+    const GraphHashMap *knownGraphs = NULL,
+    ChemOperBandit *bandit = NULL,
+    MorphingStatsCollector *stats = NULL
     );
+
+/**
+ * Number of times GenerateMorphs had to allocate or grow its per thread
+ * workspace since the start of the process. It stays put once every
+ * thread has served the largest morphAttempts used. Only the workspace
+ * buffers are counted; canonical hashing, the structure pre-check, the
+ * operators and RDKit still allocate for each attempt (allocs/op of the
+ * generate-morphs benchmark counts everything).
+ */
+unsigned long GetMorphingWorkspaceAllocations();
+
+/**
+ * Shared instance of the operator (they keep no state) or NULL for an
+ * unknown selector.
+ */
+MorphingStrategy *GetMorphingStrategy(ChemOperSelector oper);
@@ -16,6 +16,7 @@
  */
 
 #include <queue>
+#include <algorithm>
 
 #include <GraphMol/RDKitBase.h>
 #include <GraphMol/QueryOps.h>
@@ -25,43 +26,39 @@
 #include "chem/ChemicalAuxiliary.h"
 #include "MorphingData.h"
 
+MorphingData::MorphingData() :
+    mol(NULL)
+{
+    for (int i = 0; i < OPER_COUNT; ++i) {
+        mPrepared[i] = false;
+    }
+}
+
 MorphingData::MorphingData(
     RDKit::ROMol &molecule,
     RDKit::ROMol &target,
     std::vector<ChemOperSelector> &operators
     ) :
-    mol(molecule),
-    operators(operators)
+    mol(NULL)
+{
+    Reset(molecule, target, operators);
+}
+
+void MorphingData::Reset(
+    RDKit::ROMol &molecule,
+    RDKit::ROMol &target,
+    std::vector<ChemOperSelector> &operators)
 {
+    mol = &molecule;
+    graph.Assign(molecule);
+    this->operators = operators;
+
+    atoms.clear();
     GetAtomTypesFromMol(target, atoms);
 
-    for (int i = 0; i < operators.size(); ++i) {
-        switch (operators[i]) {
-        case OP_ADD_ATOM:
-            InitAddAtom();
-            break;
-        case OP_REMOVE_ATOM:
-            InitRemoveAtom();
-            break;
-        case OP_ADD_BOND:
-            InitAddBond();
-            break;
-        case OP_REMOVE_BOND:
-            InitRemoveBond();
-            break;
-        case OP_MUTATE_ATOM:
-            InitMutateAtom();
-            break;
-        case OP_INTERLAY_ATOM:
-            InitInterlayAtom();
-            break;
-        case OP_BOND_REROUTE:
-            InitBondReroute();
-            break;
-        case OP_BOND_CONTRACTION:
-            InitBondContraction();
-            break;
-        }
+    for (int i = 0; i < OPER_COUNT; ++i) {
+        Clear(static_cast<ChemOperSelector>(i));
+        mPrepared[i] = false;
     }
 }
 
@@ -70,10 +67,93 @@ MorphingData::~MorphingData()
     // no-op
 }
 
+void MorphingData::Prepare(ChemOperSelector oper)
+{
+    if (mPrepared[oper]) {
+        return;
+    }
+
+    tbb::mutex::scoped_lock lock(mPrepareMutex[oper]);
+    if (mPrepared[oper]) {
+        // built by another thread meanwhile
+        return;
+    }
+    try {
+        Init(oper);
+    } catch (...) {
+        // do not retry with partially built candidates, the operator
+        // just has no candidates for this molecule
+        Clear(oper);
+        mPrepared[oper] = true;
+        throw;
+    }
+    mPrepared[oper] = true;
+}
+
+void MorphingData::Init(ChemOperSelector oper)
+{
+    switch (oper) {
+    case OP_ADD_ATOM:
+        InitAddAtom();
+        break;
+    case OP_REMOVE_ATOM:
+        InitRemoveAtom();
+        break;
+    case OP_ADD_BOND:
+        InitAddBond();
+        break;
+    case OP_REMOVE_BOND:
+        InitRemoveBond();
+        break;
+    case OP_MUTATE_ATOM:
+        InitMutateAtom();
+        break;
+    case OP_INTERLAY_ATOM:
+        InitInterlayAtom();
+        break;
+    case OP_BOND_REROUTE:
+        InitBondReroute();
+        break;
+    case OP_BOND_CONTRACTION:
+        InitBondContraction();
+        break;
+    }
+}
+
+void MorphingData::Clear(ChemOperSelector oper)
+{
+    switch (oper) {
+    case OP_ADD_ATOM:
+        addAtomCandidates.clear();
+        break;
+    case OP_REMOVE_ATOM:
+        removeAtomCandidates.clear();
+        break;
+    case OP_ADD_BOND:
+        addBondCandidates.clear();
+        break;
+    case OP_REMOVE_BOND:
+        removeBondCandidates.clear();
+        break;
+    case OP_MUTATE_ATOM:
+        mutateAtomCandidates.clear();
+        break;
+    case OP_INTERLAY_ATOM:
+        interlayAtomCandidates.clear();
+        break;
+    case OP_BOND_REROUTE:
+        bondRerouteCandidates.clear();
+        break;
+    case OP_BOND_CONTRACTION:
+        bondContractionCandidates.clear();
+        break;
+    }
+}
+
 void MorphingData::InitAddAtom()
 {
     int bondOrder = 1;
-    GetPossibleBondingAtoms(mol, bondOrder, addAtomCandidates);
+    GetPossibleBondingAtoms(*mol, bondOrder, addAtomCandidates);
 }
 
 void MorphingData::InitAddBond()
@@ -81,36 +161,18 @@ void MorphingData::InitAddBond()
     // Calculate atoms product.
 
     std::vector<RDKit::Atom *> atomsNMV;
-    GetAtomsWithNotMaxValence(mol, atomsNMV);
-
-    std::vector<RDKit::Atom *> &atoms1 = atomsNMV;
-    std::vector<RDKit::Atom *> &atoms2 = atomsNMV;
+    GetAtomsWithNotMaxValence(*mol, atomsNMV);
 
-    for (int i = 0; i < atoms1.size(); ++i) {
-        for (int j = 0; j < atoms2.size(); ++j) {
-            if (atoms1[i]->getIdx() != atoms2[j]->getIdx()) {
-                addBondCandidates.push_back(
-                    std::make_pair(atoms1[i]->getIdx(), atoms2[j]->getIdx()));
-            }
-        }
+    // unordered pairs only, each pair once
+    if (atomsNMV.size() > 1) {
+        addBondCandidates.reserve(atomsNMV.size() * (atomsNMV.size() - 1) / 2);
     }
-
-    std::vector<int> ixRemove;
-    for (int i = 0; i < addBondCandidates.size(); ++i) {
-        AtomIdx atomIdx1 = addBondCandidates[i].first;
-        AtomIdx atomIdx2 = addBondCandidates[i].second;
-        for (int j = i + 1; j < addBondCandidates.size(); ++j) {
-            if ((addBondCandidates[j].first == atomIdx1 && addBondCandidates[j].second == atomIdx2) ||
-                    (addBondCandidates[j].second == atomIdx1 && addBondCandidates[j].first == atomIdx2)) {
-                ixRemove.push_back(j);
-            }
+    for (int i = 0; i < atomsNMV.size(); ++i) {
+        for (int j = i + 1; j < atomsNMV.size(); ++j) {
+            addBondCandidates.push_back(
+                std::make_pair(atomsNMV[i]->getIdx(), atomsNMV[j]->getIdx()));
         }
     }
-
-    std::sort(ixRemove.begin(), ixRemove.end());
-    for (int i = ixRemove.size() - 1; i >= 0; i--) {
-        addBondCandidates.erase(addBondCandidates.begin() + ixRemove[i]);
-    }
 }
 
 void MorphingData::InitMutateAtom()
@@ -119,7 +181,7 @@ void MorphingData::InitMutateAtom()
     RDKit::Atom *atom;
     RDKit::PeriodicTable *pt = RDKit::PeriodicTable::getTable();
     RDKit::ROMol::AtomIterator iter;
-    for (iter = mol.beginAtoms(); iter != mol.endAtoms(); iter++) {
+    for (iter = mol->beginAtoms(); iter != mol->endAtoms(); iter++) {
         atom = *iter;
         std::vector<MolpherAtom> sub;
         for (MolpherAtomIdx idx = 0; idx < atoms.size(); ++idx) {
@@ -137,7 +199,7 @@ void MorphingData::InitRemoveAtom()
     // Find boundary atoms.
     RDKit::Atom *atom;
     RDKit::ROMol::AtomIterator iter;
-    for (iter = mol.beginAtoms(); iter != mol.endAtoms(); iter++) {
+    for (iter = mol->beginAtoms(); iter != mol->endAtoms(); iter++) {
         atom = *iter;
         if (RDKit::queryAtomHeavyAtomDegree(atom) == 1) {
             removeAtomCandidates.push_back(atom->getIdx());
@@ -150,7 +212,7 @@ void MorphingData::InitRemoveBond()
     // Find high-order or ring bonds.
     RDKit::Bond *bond;
     RDKit::ROMol::BondIterator iter;
-    for (iter = mol.beginBonds(); iter != mol.endBonds(); iter++) {
+    for (iter = mol->beginBonds(); iter != mol->endBonds(); iter++) {
         bond = *iter;
         if ((RDKit::queryBondOrder(bond) > 1) || RDKit::queryIsBondInRing(bond)) {
             removeBondCandidates.push_back(bond->getIdx());
@@ -163,7 +225,7 @@ void MorphingData::InitInterlayAtom()
     RDKit::Bond *bond;
     RDKit::ROMol::BondIterator iter;
     for (MolpherAtomIdx idx = 0; idx < atoms.size(); ++idx) {
-        for (iter = mol.beginBonds(); iter != mol.endBonds(); iter++) {
+        for (iter = mol->beginBonds(); iter != mol->endBonds(); iter++) {
             bond = *iter;
             // the aromatic bonds are reduced to single and double bonds
             if ((RDKit::queryBondOrder(bond) * 2) <= GetMaxBondsMod(atoms[idx])) {
@@ -179,10 +241,12 @@ void MorphingData::InitBondReroute()
     RDKit::Atom *atom0, *atom1, *bondAtoms[2];
     std::vector<RDKit::Atom *> candidates[2];
     std::queue<RDKit::Atom *> q;
+    std::vector<bool> visited(mol->getNumAtoms(), false);
+    std::vector<RDKit::Atom *> kept;
 
     RDKit::ROMol::BondIterator iter;
     // for each bond in the molecule
-    for (iter = mol.beginBonds(); iter != mol.endBonds(); iter++) {
+    for (iter = mol->beginBonds(); iter != mol->endBonds(); iter++) {
         // for begin and end atom of the selected bond
         bond = *iter;
         for (int i = 0; i < 2; ++i) {
@@ -197,6 +261,8 @@ void MorphingData::InitBondReroute()
             }
 
             // q is used for breadth-first-search
+            std::fill(visited.begin(), visited.end(), false);
+            visited[bondAtoms[1]->getIdx()] = true;
             q.push(bondAtoms[1]);
 
             while (!q.empty()) {
@@ -204,9 +270,9 @@ void MorphingData::InitBondReroute()
                 q.pop();
 
                 RDKit::ROMol::ADJ_ITER beg, end;
-                boost::tie(beg, end) = mol.getAtomNeighbors(atom0);
+                boost::tie(beg, end) = mol->getAtomNeighbors(atom0);
                 while (beg != end) {
-                    atom1 = mol[*beg++].get();
+                    atom1 = (*mol)[*beg++].get();
                     if ((atom0->getIdx() == bondAtoms[1]->getIdx()) &&
                             (atom1->getIdx() == bondAtoms[0]->getIdx())) {
                         // the same bond as we calculate with
@@ -216,14 +282,8 @@ void MorphingData::InitBondReroute()
                         // if we returned to the bond being rerouted
                         continue;
                     }
-                    bool alreadyCandidate = false;
-                    for (int j = 0; j < candidates[i].size(); ++j) {
-                        if (candidates[i][j]->getIdx() == atom1->getIdx()) {
-                            alreadyCandidate = true;
-                            break;
-                        }
-                    }
-                    if (!alreadyCandidate) {
+                    if (!visited[atom1->getIdx()]) {
+                        visited[atom1->getIdx()] = true;
                         if (atom1->getIdx() != bondAtoms[0]->getIdx()) {
                             candidates[i].push_back(atom1);
                         }
@@ -234,19 +294,21 @@ void MorphingData::InitBondReroute()
 
             // remove candidates which do not have enough free valence or the
             // bond already exists
-            for (int j = candidates[i].size() - 1; j >= 0 ; --j) {
+            kept.clear();
+            for (int j = 0; j < candidates[i].size(); ++j) {
                 int maxBond = GetMaxBondsMod(*candidates[i][j]);
                 int cntAlreadyBonded = candidates[i][j]->getExplicitValence();
                 int bondOrder = RDKit::queryBondOrder(bond);
 
                 // there is already a bond between atoms
-                bool existsBond = mol.getBondBetweenAtoms(
+                bool existsBond = mol->getBondBetweenAtoms(
                     bondAtoms[0]->getIdx(), candidates[i][j]->getIdx());
 
-                if (((cntAlreadyBonded + bondOrder) > maxBond) || existsBond) {
-                    candidates[i].erase(candidates[i].begin() + j);
+                if (((cntAlreadyBonded + bondOrder) <= maxBond) && !existsBond) {
+                    kept.push_back(candidates[i][j]);
                 }
             }
+            candidates[i].swap(kept);
         }
         if ((candidates[0].size() == 0) && (candidates[1].size() == 0)) {
             continue;
@@ -268,7 +330,7 @@ void MorphingData::InitBondContraction()
 {
     RDKit::Bond *bond;
     RDKit::ROMol::BondIterator iter;
-    for (iter = mol.beginBonds(); iter != mol.endBonds(); iter++) {
+    for (iter = mol->beginBonds(); iter != mol->endBonds(); iter++) {
         bond = *iter;
         RDKit::Atom *atomToStay = bond->getBeginAtom();
         RDKit::Atom *atomToRemove = bond->getEndAtom();
@@ -22,12 +22,38 @@
 
 #include <GraphMol/GraphMol.h>
 
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
 #include "global_types.h"
 #include "chemoper_selectors.h"
+#include "chem/MolpherGraph.hpp"
+
+/**
+ * One concrete edit of a molecule. The meaning of the indices depends
+ * on the operator, unused ones are -1:
+ * pos - position in the operator candidate list (atom index for mutation),
+ * sub - element (index into MorphingData::atoms), substitution or side,
+ * variant - reroute target or bond whose order is decreased by atom addition.
+ */
+struct EditDescriptor
+{
+    EditDescriptor(ChemOperSelector oper = OP_ADD_ATOM,
+        int pos = -1, int sub = -1, int variant = -1) :
+        oper(oper), pos(pos), sub(sub), variant(variant)
+    {
+    }
+
+    ChemOperSelector oper;
+    int pos;
+    int sub;
+    int variant;
+};
 
 class MorphingData
 {
 public:
+    MorphingData();
     MorphingData(
         RDKit::ROMol &molecule,
         RDKit::ROMol &target,
@@ -35,7 +61,29 @@ public:
         );
     ~MorphingData();
 
+    /**
+     * Starts over with another molecule. Candidate lists are emptied but
+     * keep their storage, so a reused instance does not allocate again
+     * for molecules of similar size. Must not run concurrently with
+     * Prepare.
+     */
+    void Reset(
+        RDKit::ROMol &molecule,
+        RDKit::ROMol &target,
+        std::vector<ChemOperSelector> &operators
+        );
+
+    /**
+     * Build candidates of the given operator if not built yet. Candidates
+     * are built lazily the first time the operator is sampled, concurrent
+     * callers wait until the first one finishes.
+     */
+    void Prepare(ChemOperSelector oper);
+
 protected:
+    void Init(ChemOperSelector oper);
+    void Clear(ChemOperSelector oper);
+
     void InitAddAtom();
     void InitAddBond();
     void InitMutateAtom();
@@ -46,7 +94,9 @@ protected:
     void InitBondContraction();
 
 public:
-    RDKit::ROMol &mol;
+    RDKit::ROMol *mol;
+    // compact copy of mol the operators edit
+    MolpherGraph graph;
     std::vector<MolpherAtom> atoms;
     std::vector<ChemOperSelector> operators;
 
@@ -63,4 +113,10 @@ public:
     std::map<MolpherAtomIdx, std::vector<BondIdx> > interlayAtomCandidates;
     std::vector<RerouteCandidates> bondRerouteCandidates;
     std::vector<BondIdx> bondContractionCandidates;
+
+private:
+    static const int OPER_COUNT = OP_BOND_CONTRACTION + 1;
+
+    tbb::atomic<bool> mPrepared[OPER_COUNT];
+    tbb::mutex mPrepareMutex[OPER_COUNT];
 };
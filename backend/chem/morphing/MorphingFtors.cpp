@@ -20,37 +20,216 @@
 #include <GraphMol/SmilesParse/SmilesWrite.h>
 #include <GraphMol/Descriptors/MolDescriptors.h>
 
+#include <tbb/tick_count.h>
+#include <tbb/tbb_machine.h>
+#include <tbb/enumerable_thread_specific.h>
+
 #include "main.hpp"
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 #include "chem/morphing/MorphingFtors.hpp"
 #include "extensions/SAScore.h"
+#include "chem/morphing/RWMolPool.hpp"
 
 /*
  Added code for working with SAScore
  */
 
+/*
+ Graph and key buffers of one attempt. CalculateMorphs does not wait for
+ other tasks while it uses them, so one set per thread is enough and its
+ storage is reused by all attempts the thread runs.
+ */
+struct AttemptScratch
+{
+    MolpherGraph graph;
+    std::string key;
+    std::vector<boost::uint64_t> bondKeys;
+};
+
+static tbb::enumerable_thread_specific<AttemptScratch> gAttemptScratch;
+
+void CalculateMorphs::GraphKeyTable::Reset(size_t count)
+{
+    // at most half full, so that probing stays short and terminates
+    size_t size = 1;
+    while (size < 2 * count) {
+        size <<= 1;
+    }
+    if (mEntries.size() < size) {
+        mEntries.resize(size);
+    }
+    if (mKeys.size() < count) {
+        mKeys.resize(count);
+    }
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        mEntries[i].state = ENTRY_EMPTY;
+    }
+}
+
+CalculateMorphs::GraphKeyTable::InsertResult
+CalculateMorphs::GraphKeyTable::Insert(
+    boost::uint64_t hash, const std::string *key, size_t slot)
+{
+    size_t mask = mEntries.size() - 1;
+    for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask) {
+        Entry &entry = mEntries[i];
+        if (entry.state == ENTRY_EMPTY && entry.state.compare_and_swap(
+                ENTRY_WRITING, ENTRY_EMPTY) == ENTRY_EMPTY) {
+            entry.hash = hash;
+            entry.slot = slot;
+            entry.hasKey = (key != NULL);
+            if (key) {
+                mKeys[slot] = *key;
+            }
+            entry.state = ENTRY_READY; // publishes the fields above
+            return INSERTED;
+        }
+        // the owner is only copying the key, pause and then yield
+        tbb::internal::atomic_backoff backoff;
+        while (entry.state == ENTRY_WRITING) {
+            backoff.pause();
+        }
+        if (entry.hash == hash) {
+            if (!key) {
+                return SAME_GRAPH;
+            }
+            return (entry.hasKey && mKeys[entry.slot] == *key) ?
+                SAME_GRAPH : HASH_COLLISION;
+        }
+    }
+}
+
+size_t CalculateMorphs::GraphKeyTable::GetCapacity() const
+{
+    return mEntries.capacity() + mKeys.capacity();
+}
+
+/*
+ Charges the time until the end of the scope to the operator.
+ */
+class AttemptCost
+{
+public:
+    AttemptCost(ChemOperBandit *bandit, ChemOperSelector oper) :
+        mBandit(bandit),
+        mOper(oper)
+    {
+        if (mBandit) {
+            mStart = tbb::tick_count::now();
+        }
+    }
+
+    ~AttemptCost()
+    {
+        if (mBandit) {
+            mBandit->AddCost(mOper, (tbb::tick_count::now() - mStart).seconds());
+        }
+    }
+
+private:
+    ChemOperBandit *mBandit;
+    ChemOperSelector mOper;
+    tbb::tick_count mStart;
+};
+
+static inline void CountFailure(ChemOperStats *stats)
+{
+    if (stats) {
+        ++stats->morphFailures;
+    }
+}
+
+static inline void CountSanitizeFailure(ChemOperStats *stats)
+{
+    if (stats) {
+        ++stats->sanitizeFailures;
+    }
+}
+
+static inline void CountStructureReject(ChemOperStats *stats,
+    MolpherGraph::Defect defect)
+{
+    if (stats) {
+        if (defect == MolpherGraph::DEFECT_DISCONNECTED) {
+            ++stats->fragmentRejects;
+        } else {
+            ++stats->structureRejects;
+        }
+    }
+}
+
+static inline void CountDuplicate(ChemOperStats *stats)
+{
+    if (stats) {
+        ++stats->duplicates;
+    }
+}
+
+/*
+ Gives the morph back to RWMolPool, the time is charged to allocNanoseconds.
+ The caller stops its own stage timer first so that it is not counted twice.
+ */
+static inline void ReleaseMorph(RDKit::RWMol *&mol, ChemOperStats *stats)
+{
+    if (mol) {
+        StageTimer allocTimer(stats ? &stats->allocNanoseconds : NULL);
+        RWMolPool::Release(mol);
+        mol = NULL;
+    }
+}
+
 CalculateMorphs::CalculateMorphs(
     MorphingData &data,
     std::vector<MorphingStrategy *> &strategies,
+    const EditDescriptor *edits,
+    const std::vector<int> *strategyWeights,
+    ChemOperBandit *bandit,
+    MorphingStatsCollector *stats,
     ChemOperSelector *opers,
     RDKit::RWMol **newMols,
     std::string *smiles,
     std::string *formulas,
     double *weights,
     double *sascore, // added for SAScore
+    MorganFngpr *sharedMorgan,
+    MorganFngpr::Environments **environments,
+    boost::uint64_t *hashes,
+    GraphKeyTable &graphKeys,
+    const GraphHashMap *knownGraphs,
+    tbb::atomic<unsigned int> &valenceRejectCount,
+    tbb::atomic<unsigned int> &aromaticityRejectCount,
+    tbb::atomic<unsigned int> &disconnectedRejectCount,
+    tbb::atomic<unsigned int> &duplicateCount,
+    tbb::atomic<unsigned int> &knownCount,
+    tbb::atomic<unsigned int> &hashFallbackCount,
     tbb::atomic<unsigned int> &kekulizeFailureCount,
     tbb::atomic<unsigned int> &sanitizeFailureCount,
     tbb::atomic<unsigned int> &morphingFailureCount
     ) :
     mData(data),
     mStrategies(strategies),
+    mEdits(edits),
+    mStrategyWeights(strategyWeights),
+    mBandit(bandit),
+    mStats(stats),
     mOpers(opers),
     mNewMols(newMols),
     mSmiles(smiles),
     mFormulas(formulas),
     mWeights(weights),
     mSascore(sascore), // added for SAScore
+    mSharedMorgan(sharedMorgan),
+    mEnvironments(environments),
+    mHashes(hashes),
+    mGraphKeys(graphKeys),
+    mKnownGraphs(knownGraphs),
+    mValenceRejectCount(valenceRejectCount),
+    mAromaticityRejectCount(aromaticityRejectCount),
+    mDisconnectedRejectCount(disconnectedRejectCount),
+    mDuplicateCount(duplicateCount),
+    mKnownCount(knownCount),
+    mHashFallbackCount(hashFallbackCount),
     mKekulizeFailureCount(kekulizeFailureCount),
     mSanitizeFailureCount(sanitizeFailureCount),
     mMorphingFailureCount(morphingFailureCount)
@@ -63,25 +242,112 @@ void CalculateMorphs::operator()(const tbb::blocked_range<int> &r) const
 //    DEBUG_REPORT("CalculateMorphs::operator")
     
     for (int i = r.begin(); i != r.end(); ++i) {
-        int randPos = SynchRand::GetRandomNumber(mStrategies.size() - 1);
-        MorphingStrategy *strategy = mStrategies[randPos];
+        MorphingStrategy *strategy = NULL;
+        if (mEdits) {
+            if (mEdits[i].pos < 0) {
+                // edit space exhausted
+                continue;
+            }
+            for (int s = 0; s < mStrategies.size(); ++s) {
+                if (mStrategies[s]->GetSelector() == mEdits[i].oper) {
+                    strategy = mStrategies[s];
+                    break;
+                }
+            }
+        } else if (mStrategyWeights) {
+            strategy = mStrategies[ChemOperBandit::Sample(*mStrategyWeights)];
+        } else {
+            int randPos = SynchRand::GetRandomNumber(mStrategies.size() - 1);
+            strategy = mStrategies[randPos];
+        }
         mOpers[i] = strategy->GetSelector();
+        AttemptCost cost(mBandit, mOpers[i]);
+        ChemOperStats *operStats = NULL;
+        if (mStats) {
+            operStats = &mStats->Local().opers[mOpers[i]];
+            ++operStats->attempts;
+        }
 
+        std::string knownSmile;
+        StageTimer morphTimer(operStats ? &operStats->morphNanoseconds : NULL);
         try {
-            strategy->Morph(mData, &mNewMols[i]);
+            mData.Prepare(mOpers[i]);
+            EditDescriptor edit;
+            if (mEdits) {
+                edit = mEdits[i];
+            } else if (!strategy->SampleEdit(mData, edit)) {
+                CountFailure(operStats);
+                continue;
+            }
+
+            // edit the compact graph, RDKit molecule only for the survivors
+            AttemptScratch &scratch = gAttemptScratch.local();
+            MolpherGraph &graph = scratch.graph;
+            graph = mData.graph;
+            strategy->Apply(mData, edit, graph);
+            // certain sanitization failures are not worth the conversion
+            MolpherGraph::Defect defect = graph.FindDefect();
+            if (defect != MolpherGraph::DEFECT_NONE) {
+                switch (defect) {
+                case MolpherGraph::DEFECT_VALENCE:
+                    ++mValenceRejectCount; // atomic
+                    break;
+                case MolpherGraph::DEFECT_AROMATICITY:
+                    ++mAromaticityRejectCount; // atomic
+                    break;
+                default:
+                    ++mDisconnectedRejectCount; // atomic
+                    break;
+                }
+                CountStructureReject(operStats, defect);
+                continue;
+            }
+
+            // drop duplicates before paying for conversion and SMILES
+            bool discrete = false;
+            mHashes[i] = graph.GetCanonicalHash(&discrete);
+            if (mKnownGraphs) {
+                GraphHashMap::const_accessor ac;
+                if (mKnownGraphs->find(ac, mHashes[i])) {
+                    if (discrete) {
+                        ++mKnownCount; // atomic
+                        CountDuplicate(operStats);
+                        continue;
+                    }
+                    knownSmile = ac->second;
+                }
+            }
+            if (!discrete) {
+                graph.GetKey(scratch.key, scratch.bondKeys);
+            }
+            GraphKeyTable::InsertResult inserted = mGraphKeys.Insert(
+                mHashes[i], discrete ? NULL : &scratch.key, i);
+            if (inserted == GraphKeyTable::SAME_GRAPH) {
+                // the same morph was already produced in this batch
+                ++mDuplicateCount; // atomic
+                CountDuplicate(operStats);
+                continue;
+            } else if (inserted == GraphKeyTable::HASH_COLLISION) {
+                // left to the SMILES check in CollectMorphs
+                ++mHashFallbackCount; // atomic
+            }
+            morphTimer.Stop();
+            StageTimer allocTimer(
+                operStats ? &operStats->allocNanoseconds : NULL);
+            mNewMols[i] = RWMolPool::Acquire();
+            graph.ToRWMol(mNewMols[i]);
         } catch (const std::exception &exc) {
             ++mMorphingFailureCount; // atomic
-            delete mNewMols[i];
-            mNewMols[i] = NULL;
+            CountFailure(operStats);
+            morphTimer.Stop();
+            ReleaseMorph(mNewMols[i], operStats);
         }
+        morphTimer.Stop();
 
         if (mNewMols[i]) {
+            StageTimer sanitizeTimer(
+                operStats ? &operStats->sanitizeNanoseconds : NULL);
             try {
-                RDKit::RWMol *copy = new RDKit::RWMol();
-                CopyMol(*(mNewMols[i]), *copy);
-                delete mNewMols[i];
-                mNewMols[i] = copy;
-
                 mNewMols[i]->clearComputedProps();
                 RDKit::MolOps::cleanUp(*(mNewMols[i]));
                 mNewMols[i]->updatePropertyCache();
@@ -89,23 +355,46 @@ void CalculateMorphs::operator()(const tbb::blocked_range<int> &r) const
                 RDKit::MolOps::adjustHs(*(mNewMols[i]));
 
                 //RDKit::MolOps::sanitizeMol(*(mNewMols[i]));
+                sanitizeTimer.Stop();
 
+                StageTimer propertyTimer(
+                    operStats ? &operStats->propertyNanoseconds : NULL);
                 mSmiles[i] = RDKit::MolToSmiles(*(mNewMols[i]));
+                if (!knownSmile.empty()) {
+                    if (mSmiles[i] == knownSmile) {
+                        ++mKnownCount; // atomic
+                        CountDuplicate(operStats);
+                        propertyTimer.Stop();
+                        ReleaseMorph(mNewMols[i], operStats);
+                        continue;
+                    }
+                    ++mHashFallbackCount; // atomic
+                }
                 mFormulas[i] = RDKit::Descriptors::calcMolFormula(*(mNewMols[i]));
                 mWeights[i] = RDKit::Descriptors::calcExactMW(*(mNewMols[i]));
-                mSascore[i] = SAScore::getInstance()->getScore(*(mNewMols[i])); // added for SAScore
+                if (mSharedMorgan) {
+                    // one Morgan pass for both SAScore and fingerprint
+                    mEnvironments[i] = mSharedMorgan->GetEnvironments(mNewMols[i]);
+                    mSascore[i] = SAScore::getInstance()->getScore(
+                        *(mNewMols[i]), *(mEnvironments[i]));
+                } else {
+                    mSascore[i] = SAScore::getInstance()->getScore(*(mNewMols[i])); // added for SAScore
+                }
             } catch (const ValueErrorException &exc) {
                 ++mKekulizeFailureCount; // atomic
-                delete mNewMols[i];
-                mNewMols[i] = NULL;
+                CountSanitizeFailure(operStats);
+                sanitizeTimer.Stop();
+                ReleaseMorph(mNewMols[i], operStats);
             } catch (const RDKit::MolSanitizeException &exc) {
                 ++mSanitizeFailureCount; // atomic
-                delete mNewMols[i];
-                mNewMols[i] = NULL;
+                CountSanitizeFailure(operStats);
+                sanitizeTimer.Stop();
+                ReleaseMorph(mNewMols[i], operStats);
             } catch (const std::exception &exc) {
                 ++mSanitizeFailureCount; // atomic
-                delete mNewMols[i];
-                mNewMols[i] = NULL;
+                CountSanitizeFailure(operStats);
+                sanitizeTimer.Stop();
+                ReleaseMorph(mNewMols[i], operStats);
             }
         }
     }
@@ -116,17 +405,33 @@ CalculateDistances::CalculateDistances(
     SimCoefCalculator &scCalc,
     Fingerprint *targetFp,
     std::vector<Fingerprint *> &decoysFp,
+    SparseFingerprint *targetSparseFp,
+    std::vector<SparseFingerprint *> &decoysSparseFp,
+    MorganFngpr::Environments **environments,
     double *distToTarget,
     double *distToClosestDecoy,
-    int nextDecoy
+    int nextDecoy,
+    FoldedScreen *screen,
+    double screenCutoff,
+    tbb::atomic<unsigned int> &screenedOutCount,
+    const ChemOperSelector *opers,
+    MorphingStatsCollector *stats
     ) :
     mNewMols(newMols),
     mScCalc(scCalc),
     mTargetFp(targetFp),
     mDecoysFp(decoysFp),
+    mTargetSparseFp(targetSparseFp),
+    mDecoysSparseFp(decoysSparseFp),
+    mEnvironments(environments),
     mDistToTarget(distToTarget),
     mDistToClosestDecoy(distToClosestDecoy),
-    mNextDecoy(nextDecoy)
+    mNextDecoy(nextDecoy),
+    mScreen(screen),
+    mScreenCutoff(screenCutoff),
+    mScreenedOutCount(screenedOutCount),
+    mOpers(opers),
+    mStats(stats)
 {
     // no-op
 }
@@ -136,9 +441,52 @@ void CalculateDistances::operator()(const tbb::blocked_range<int> &r) const
     Fingerprint *fp;
     double dist, minDist;
 
+    if (mScCalc.IsSparse()) {
+        SparseFingerprint *sparseFp;
+        for (int i = r.begin(); i != r.end(); ++i) {
+            if (mNewMols[i]) {
+                sparseFp = mScCalc.GetSparseFingerprint(mNewMols[i]);
+                mDistToTarget[i] = mScCalc.ConvertToDistance(
+                    mScCalc.GetSimCoef(mTargetSparseFp, sparseFp));
+
+                dist = 0;
+                if (mNextDecoy != -1 && mNextDecoy < mDecoysSparseFp.size()) {
+                    dist = mScCalc.ConvertToDistance(
+                        mScCalc.GetSimCoef(mDecoysSparseFp[mNextDecoy], sparseFp));
+                }
+                mDistToClosestDecoy[i] = dist;
+
+                delete sparseFp;
+            }
+        }
+        return;
+    }
+
+    bool decoyUsed = (mNextDecoy != -1 && mNextDecoy < mDecoysFp.size());
     for (int i = r.begin(); i != r.end(); ++i) {
+        if (mNewMols[i] && mScreen) {
+            fp = mScreen->GetFingerprint(mNewMols[i]);
+            double bound = mScreen->GetDistanceLowerBound(fp, 0);
+            if (decoyUsed) {
+                bound += mScreen->GetDistanceLowerBound(fp, 1);
+            }
+            delete fp;
+
+            if (bound > mScreenCutoff) {
+                // cannot get into the kept range, do not deliver it at all
+                ReleaseMorph(mNewMols[i], (mStats && mOpers) ?
+                    &mStats->Local().opers[mOpers[i]] : NULL);
+                ++mScreenedOutCount;
+                continue;
+            }
+        }
+
         if (mNewMols[i]) {
-            fp = mScCalc.GetFingerprint(mNewMols[i]);
+            if (mEnvironments && mEnvironments[i]) {
+                fp = mScCalc.GetSharedMorganStrategy()->Fold(*(mEnvironments[i]));
+            } else {
+                fp = mScCalc.GetFingerprint(mNewMols[i]);
+            }
             mDistToTarget[i] = mScCalc.ConvertToDistance(
                 mScCalc.GetSimCoef(mTargetFp, fp));
 
@@ -167,6 +515,7 @@ ReturnResults::ReturnResults(
     ChemOperSelector *opers,
     double *weights,
     double *sascore, // added for SAScore
+    boost::uint64_t *hashes,
     double *distToTarget,
     double *distToClosestDecoy,
     void *callerState,
@@ -179,6 +528,7 @@ ReturnResults::ReturnResults(
     mOpers(opers),
     mWeights(weights),
     mSascore(sascore), // added for SAScore
+    mHashes(hashes),
     mDistToTarget(distToTarget),
     mDistToClosestDecoy(distToClosestDecoy),
     mCallerState(callerState),
@@ -196,9 +546,17 @@ void ReturnResults::operator()(const tbb::blocked_range<int> &r) const
     
     for (int i = r.begin(); i != r.end(); ++i) {
         if (mNewMols[i]) {
-            MolpherMolecule result(mSmiles[i], mFormulas[i], mParentSmile,
-                mOpers[i], mDistToTarget[i], mDistToClosestDecoy[i],
-                mWeights[i], mSascore[i]);
+            // the strings are moved out, they are not read after delivery
+            MolpherMolecule result;
+            result.smile.swap(mSmiles[i]);
+            result.formula.swap(mFormulas[i]);
+            result.parentSmile = mParentSmile;
+            result.parentChemOper = mOpers[i];
+            result.distToTarget = mDistToTarget[i];
+            result.distToClosestDecoy = mDistToClosestDecoy[i];
+            result.molecularWeight = mWeights[i];
+            result.sascore = mSascore[i];
+            result.graphHash = mHashes[i];
             
             /* Advance decoy functionality
             // are we close enough ?            
@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chem/morphing/MorphingStatsCollector.hpp"
+
+MorphingStats &MorphingStatsCollector::Local()
+{
+    return mLocal.local();
+}
+
+void MorphingStatsCollector::Withdraw(MorphingStats &stats)
+{
+    tbb::enumerable_thread_specific<MorphingStats>::iterator it;
+    for (it = mLocal.begin(); it != mLocal.end(); ++it) {
+        stats.Add(*it);
+        it->Clear();
+    }
+}
+
+void MorphingStatsCollector::Reset()
+{
+    tbb::enumerable_thread_specific<MorphingStats>::iterator it;
+    for (it = mLocal.begin(); it != mLocal.end(); ++it) {
+        it->Clear();
+    }
+}
+
+boost::uint64_t MorphingStatsCollector::GetAllocNanoseconds()
+{
+    boost::uint64_t nanoseconds = 0;
+    tbb::enumerable_thread_specific<MorphingStats>::iterator it;
+    for (it = mLocal.begin(); it != mLocal.end(); ++it) {
+        for (size_t i = 0; i < it->opers.size(); ++i) {
+            nanoseconds += it->opers[i].allocNanoseconds;
+        }
+    }
+    return nanoseconds;
+}
+
+StageTimer::StageTimer(boost::uint64_t *nanoseconds) :
+    mNanoseconds(nanoseconds)
+{
+    if (mNanoseconds) {
+        mStart = tbb::tick_count::now();
+    }
+}
+
+StageTimer::~StageTimer()
+{
+    Stop();
+}
+
+void StageTimer::Stop()
+{
+    if (mNanoseconds) {
+        *mNanoseconds += static_cast<boost::uint64_t>(
+            (tbb::tick_count::now() - mStart).seconds() * 1e9);
+        mNanoseconds = NULL;
+    }
+}
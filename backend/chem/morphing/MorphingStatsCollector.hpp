@@ -0,0 +1,64 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/tick_count.h>
+
+#include "MorphingStats.h"
+
+/**
+ * Thread-local MorphingStats, so that the counters are updated without
+ * synchronization while morphs are generated and filtered.
+ */
+class MorphingStatsCollector
+{
+public:
+    /// Counters of the calling thread.
+    MorphingStats &Local();
+    /**
+     * Adds the counters of all threads to stats and resets them. Must not
+     * run concurrently with the users of Local.
+     */
+    void Withdraw(MorphingStats &stats);
+    void Reset();
+    /**
+     * Sum of allocNanoseconds over all threads and operators since the
+     * last Withdraw or Reset. Must not run concurrently with Local.
+     */
+    boost::uint64_t GetAllocNanoseconds();
+
+private:
+    tbb::enumerable_thread_specific<MorphingStats> mLocal;
+};
+
+/**
+ * Adds the time until Stop (or the end of the scope) to the counter,
+ * does nothing if the counter is NULL.
+ */
+class StageTimer
+{
+public:
+    explicit StageTimer(boost::uint64_t *nanoseconds);
+    ~StageTimer();
+    void Stop();
+
+private:
+    boost::uint64_t *mNanoseconds;
+    tbb::tick_count mStart;
+};
@@ -0,0 +1,86 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GraphMol/RDKitBase.h>
+
+#include "chem/morphing/RWMolPool.hpp"
+
+RWMolPool::FreeLists RWMolPool::sFree;
+tbb::atomic<unsigned long> RWMolPool::sCreated;
+
+RWMolPool::FreeList::~FreeList()
+{
+    for (size_t i = 0; i < mols.size(); ++i) {
+        delete mols[i];
+    }
+}
+
+RDKit::RWMol *RWMolPool::Acquire()
+{
+#if MORPHING_MOL_POOL == 1
+    std::vector<RDKit::RWMol *> &free = sFree.local().mols;
+    if (!free.empty()) {
+        RDKit::RWMol *mol = free.back();
+        free.pop_back();
+        return mol;
+    }
+#endif
+    ++sCreated;
+    return new RDKit::RWMol();
+}
+
+void RWMolPool::Release(RDKit::RWMol *mol)
+{
+    if (!mol) {
+        return;
+    }
+#if MORPHING_MOL_POOL == 1
+    std::vector<RDKit::RWMol *> &free = sFree.local().mols;
+    if (free.size() < MAX_POOLED) {
+        try {
+            Empty(*mol);
+            free.push_back(mol);
+            return;
+        } catch (const std::exception &exc) {
+            // not reusable, delete it
+        }
+    }
+#endif
+    delete mol;
+}
+
+unsigned long RWMolPool::GetCreatedCount()
+{
+    return sCreated;
+}
+
+void RWMolPool::Empty(RDKit::RWMol &mol)
+{
+    mol.clearConformers();
+    mol.clearComputedProps();
+    // from the end, so that no indices have to be shifted
+    for (unsigned int i = mol.getNumBonds(); i > 0; --i) {
+        RDKit::Bond *bond = mol.getBondWithIdx(i - 1);
+        mol.removeBond(bond->getBeginAtomIdx(), bond->getEndAtomIdx());
+    }
+    for (unsigned int i = mol.getNumAtoms(); i > 0; --i) {
+        mol.removeAtom(i - 1);
+    }
+    if (mol.getRingInfo()->isInitialized()) {
+        mol.getRingInfo()->reset();
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <GraphMol/GraphMol.h>
+
+#include <tbb/atomic.h>
+#include <tbb/enumerable_thread_specific.h>
+
+// build morphs into emptied molecules kept per thread instead of new ones
+#ifndef MORPHING_MOL_POOL
+#define MORPHING_MOL_POOL 1
+#endif
+
+/**
+ * Per thread free lists of emptied RDKit::RWMol. A recycled molecule keeps
+ * the storage of its graph containers and property dictionary, atoms and
+ * bonds are still allocated one by one by RDKit. With MORPHING_MOL_POOL
+ * off Acquire and Release fall back to new and delete, so callers use the
+ * same calls either way.
+ */
+class RWMolPool
+{
+public:
+    /// Empty molecule owned by the caller until Release.
+    static RDKit::RWMol *Acquire();
+    /// Gives the molecule back (or deletes it), NULL is ignored.
+    static void Release(RDKit::RWMol *mol);
+
+    /// Molecules created by Acquire since the start of the process.
+    static unsigned long GetCreatedCount();
+
+protected:
+    static void Empty(RDKit::RWMol &mol);
+
+private:
+    // upper bound of the free list of one thread
+    static const size_t MAX_POOLED = 1024;
+
+    struct FreeList
+    {
+        ~FreeList();
+        std::vector<RDKit::RWMol *> mols;
+    };
+    typedef tbb::enumerable_thread_specific<FreeList> FreeLists;
+
+    static FreeLists sFree;
+    static tbb::atomic<unsigned long> sCreated;
+};
@@ -0,0 +1,262 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GraphMol/SmilesParse/SmilesParse.h>
+#include <GraphMol/SmilesParse/SmilesWrite.h>
+#include <GraphMol/Descriptors/MolDescriptors.h>
+
+#include "fingerprint_selectors.h"
+#include "auxiliary/SynchRand.h"
+#include "chem/ChemicalAuxiliary.h"
+#include "chem/morphingStrategy/MorphingStrategy.h"
+#include "chem/morphing/Morphing.hpp"
+#include "chem/morphing/RWMolPool.hpp"
+#include "chem/morphing/RandomWalk.hpp"
+#include "extensions/SAScore.h"
+
+/*
+ Parses and kekulizes the SMILES like GenerateMorphs does with its
+ candidate, NULL on failure.
+ */
+static RDKit::RWMol *ParseKekulized(const std::string &smile)
+{
+    RDKit::RWMol *mol = NULL;
+    try {
+        mol = RDKit::SmilesToMol(smile);
+        if (mol) {
+            RDKit::MolOps::Kekulize(*mol);
+        }
+    } catch (const std::exception &exc) {
+        delete mol;
+        mol = NULL;
+    }
+    return mol;
+}
+
+RandomWalk::RandomWalk(FingerprintSelector fingerprintSelector,
+    SimCoeffSelector simCoeffSelector,
+    std::vector<ChemOperSelector> &chemOperSelectors,
+    const MolpherMolecule &target
+    ) :
+    mFingerprintSelector(fingerprintSelector),
+    mSimCoeffSelector(simCoeffSelector),
+    mChemOperSelectors(chemOperSelectors),
+    mScCalc(NULL),
+    mTargetFp(NULL),
+    mTargetSparseFp(NULL),
+    mCurrentMol(NULL),
+    mAttemptCount(0)
+{
+    for (size_t i = 0; i < mChemOperSelectors.size(); ++i) {
+        MorphingStrategy *strategy = GetMorphingStrategy(mChemOperSelectors[i]);
+        if (strategy) {
+            mStrategies.push_back(strategy);
+        }
+    }
+    mEdits.resize(mStrategies.size());
+    mTargetMol = ParseKekulized(target.smile);
+}
+
+RandomWalk::~RandomWalk()
+{
+    ClearCurrent();
+    delete mTargetSparseFp;
+    delete mTargetFp;
+    delete mScCalc;
+    delete mTargetMol;
+}
+
+bool RandomWalk::Reset(const MolpherMolecule &origin)
+{
+    if (origin.smile == mCurrentSmile && mCurrentMol) {
+        // candidate lists of the origin are still valid
+        return true;
+    }
+    return SetCurrent(origin.smile);
+}
+
+bool RandomWalk::Step(MolpherMolecule &morph)
+{
+    if (!mCurrentMol) {
+        return false;
+    }
+
+    int attempt = 0;
+    while (attempt < MAX_STEP_ATTEMPTS && !mOpen.empty()) {
+        // operator first, then one of its edits, as GenerateMorphs draws
+        // them without a plan
+        int which = SynchRand::GetRandomNumber(mOpen.size() - 1);
+        int strategy = mOpen[which];
+        std::vector<EditDescriptor> &edits = mEdits[strategy];
+        if (!mListed[strategy]) {
+            edits.clear();
+            try {
+                mData.Prepare(mStrategies[strategy]->GetSelector());
+                mStrategies[strategy]->EnumerateEdits(mData, edits);
+            } catch (const std::exception &exc) {
+                // the operator has no candidates for this molecule
+                edits.clear();
+            }
+            mListed[strategy] = true;
+        }
+        if (edits.empty()) {
+            // nothing left to try with this operator from here
+            mOpen[which] = mOpen.back();
+            mOpen.pop_back();
+            continue;
+        }
+
+        // failed edits are dropped, they would fail again from here
+        int pick = SynchRand::GetRandomNumber(edits.size() - 1);
+        EditDescriptor edit = edits[pick];
+        edits[pick] = edits.back();
+        edits.pop_back();
+        ++attempt;
+        ++mAttemptCount;
+
+        if (TryEdit(mStrategies[strategy], edit, mCandidate) &&
+                SetCurrent(mCandidate.smile)) {
+            morph.Swap(mCandidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long RandomWalk::GetAttemptCount() const
+{
+    return mAttemptCount;
+}
+
+bool RandomWalk::SetCurrent(const std::string &smile)
+{
+    if (!mTargetMol) {
+        return false;
+    }
+    RDKit::RWMol *mol = ParseKekulized(smile);
+    if (!mol) {
+        return false;
+    }
+
+    ClearCurrent();
+    mCurrentMol = mol;
+    mCurrentSmile = smile;
+    mData.Reset(*mCurrentMol, *mTargetMol, mChemOperSelectors);
+    ResetEdits();
+    UpdateTargetFingerprint();
+    return true;
+}
+
+void RandomWalk::UpdateTargetFingerprint()
+{
+    // extended fingerprints depend on the source molecule
+    bool extended = mFingerprintSelector > MAX_STANDARD_FP;
+    if (mScCalc && !extended) {
+        return;
+    }
+
+    delete mTargetSparseFp;
+    delete mTargetFp;
+    delete mScCalc;
+    mScCalc = new SimCoefCalculator(mSimCoeffSelector, mFingerprintSelector,
+        mCurrentMol, mTargetMol);
+    mTargetFp = mScCalc->GetFingerprint(mTargetMol);
+    mTargetSparseFp = NULL;
+    if (mScCalc->IsSparse()) {
+        mTargetSparseFp = mScCalc->GetSparseFingerprint(mTargetMol);
+    }
+}
+
+void RandomWalk::ClearCurrent()
+{
+    delete mCurrentMol;
+    mCurrentMol = NULL;
+    mCurrentSmile.clear();
+    ResetEdits();
+}
+
+void RandomWalk::ResetEdits()
+{
+    mListed.assign(mStrategies.size(), false);
+    mOpen.clear();
+    for (size_t i = 0; i < mStrategies.size(); ++i) {
+        mOpen.push_back(int(i));
+    }
+}
+
+bool RandomWalk::TryEdit(MorphingStrategy *strategy,
+    const EditDescriptor &edit, MolpherMolecule &morph)
+{
+    RDKit::RWMol *mol = NULL;
+    bool success = false;
+    try {
+        MolpherGraph graph(mData.graph);
+        strategy->Apply(mData, edit, graph);
+        if (graph.FindDefect() != MolpherGraph::DEFECT_NONE) {
+            return false;
+        }
+        morph.graphHash = graph.GetCanonicalHash();
+        mol = RWMolPool::Acquire();
+        graph.ToRWMol(mol);
+
+        mol->clearComputedProps();
+        RDKit::MolOps::cleanUp(*mol);
+        mol->updatePropertyCache();
+        RDKit::MolOps::Kekulize(*mol);
+        RDKit::MolOps::adjustHs(*mol);
+
+        morph.smile = RDKit::MolToSmiles(*mol);
+        if (morph.smile == mCurrentSmile) {
+            // the edit gave back the same molecule
+            RWMolPool::Release(mol);
+            return false;
+        }
+        morph.formula = RDKit::Descriptors::calcMolFormula(*mol);
+        morph.molecularWeight = RDKit::Descriptors::calcExactMW(*mol);
+        morph.sascore = SAScore::getInstance()->getScore(*mol);
+        morph.distToTarget = GetDistanceToTarget(*mol);
+        morph.distToClosestDecoy = 0;
+        morph.parentSmile = mCurrentSmile;
+        morph.parentChemOper = strategy->GetSelector();
+        success = true;
+    } catch (const ValueErrorException &exc) {
+        // kekulization failure
+    } catch (const RDKit::MolSanitizeException &exc) {
+        // no-op
+    } catch (const std::exception &exc) {
+        // no-op
+    }
+    RWMolPool::Release(mol);
+    return success;
+}
+
+double RandomWalk::GetDistanceToTarget(RDKit::RWMol &mol)
+{
+    if (mScCalc->IsSparse()) {
+        SparseFingerprint *sparseFp = mScCalc->GetSparseFingerprint(&mol);
+        double dist = mScCalc->ConvertToDistance(
+            mScCalc->GetSimCoef(mTargetSparseFp, sparseFp));
+        delete sparseFp;
+        return dist;
+    }
+
+    Fingerprint *fp = mScCalc->GetFingerprint(&mol);
+    double dist = mScCalc->ConvertToDistance(
+        mScCalc->GetSimCoef(mTargetFp, fp));
+    delete fp;
+    return dist;
+}
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2012 Peter Szepe
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GraphMol/GraphMol.h>
+
+#include "fingerprint_selectors.h"
+#include "simcoeff_selectors.h"
+#include "chemoper_selectors.h"
+#include "MolpherMolecule.h"
+#include "chem/SimCoefCalculator.hpp"
+#include "chem/morphing/MorphingData.h"
+
+class MorphingStrategy;
+
+/**
+ * Random walk over morphs for NeighborhoodGenerator. The current molecule,
+ * its MorphingData and the target fingerprint are kept between the steps,
+ * so a failed edit costs only the edit itself. Like GenerateMorphs, a step
+ * picks an operator uniformly and then one of the edits it offers for the
+ * current molecule (without replacement), until an edit gives a valid morph,
+ * at most MAX_STEP_ATTEMPTS times. The edits of an operator are listed only
+ * when it is picked first and operators without edits left are skipped.
+ * Not thread-safe, use one instance per thread.
+ */
+class RandomWalk
+{
+public:
+    RandomWalk(FingerprintSelector fingerprintSelector,
+        SimCoeffSelector simCoeffSelector,
+        std::vector<ChemOperSelector> &chemOperSelectors,
+        const MolpherMolecule &target);
+    ~RandomWalk();
+
+    /**
+     * Starts over from the molecule, false if its SMILES cannot be
+     * parsed and kekulized.
+     */
+    bool Reset(const MolpherMolecule &origin);
+
+    /**
+     * Moves to a random morph of the current molecule and stores it in
+     * morph with the same data GenerateMorphs delivers (without decoys).
+     * Returns false if no edit succeeded within the cap, the walk then
+     * stays where it is.
+     */
+    bool Step(MolpherMolecule &morph);
+
+    /// Morph attempts since construction, failed ones included.
+    unsigned long GetAttemptCount() const;
+
+    static const int MAX_STEP_ATTEMPTS = 32;
+
+protected:
+    bool SetCurrent(const std::string &smile);
+    void UpdateTargetFingerprint();
+    void ClearCurrent();
+    void ResetEdits();
+    bool TryEdit(MorphingStrategy *strategy, const EditDescriptor &edit,
+        MolpherMolecule &morph);
+    double GetDistanceToTarget(RDKit::RWMol &mol);
+
+private:
+    FingerprintSelector mFingerprintSelector;
+    SimCoeffSelector mSimCoeffSelector;
+    std::vector<ChemOperSelector> mChemOperSelectors;
+    std::vector<MorphingStrategy *> mStrategies;
+
+    RDKit::RWMol *mTargetMol;
+    SimCoefCalculator *mScCalc;
+    Fingerprint *mTargetFp;
+    SparseFingerprint *mTargetSparseFp;
+
+    std::string mCurrentSmile;
+    RDKit::RWMol *mCurrentMol;
+    MorphingData mData;
+    // edits of the current molecule not tried yet, by strategy index, an
+    // entry is valid only once the strategy has been listed
+    std::vector<std::vector<EditDescriptor> > mEdits;
+    std::vector<bool> mListed;
+    // strategies that may still have an edit to try
+    std::vector<int> mOpen;
+
+    // filled by TryEdit, morph of Step is left alone on failure
+    MolpherMolecule mCandidate;
+
+    unsigned long mAttemptCount;
+};
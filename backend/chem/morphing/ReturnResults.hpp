@@ -23,6 +23,8 @@
 
 #include <GraphMol/GraphMol.h>
 
+#include <boost/cstdint.hpp>
+
 #include <tbb/atomic.h>
 #include <tbb/blocked_range.h>
 
@@ -45,6 +47,7 @@ public:
         ChemOperSelector *opers,
         double *weights,
         double *sascores,
+        boost::uint64_t *hashes,
         double *distToTarget,
         double *distToClosestDecoy,
         void *callerState,
@@ -61,6 +64,7 @@ private:
     ChemOperSelector *mOpers;
     double *mWeights;
     double *mSascore;
+    boost::uint64_t *mHashes;
     double *mDistToTarget;
     double *mDistToClosestDecoy;
 
@@ -17,15 +17,51 @@
 
 #pragma once
 
+#include <vector>
+
 #include <GraphMol/GraphMol.h>
 
 #include "global_types.h"
 #include "chemoper_selectors.h"
 #include "chem/morphing/MorphingData.h"
+#include "chem/MolpherGraph.hpp"
 
 class MorphingStrategy
 {
 public:
-    virtual void Morph(MorphingData &data, RDKit::RWMol **nMol) = 0;
+    virtual ~MorphingStrategy() {}
+
+    /**
+     * Applies a randomly chosen edit, *nMol is NULL if there is none.
+     */
+    void Morph(MorphingData &data, RDKit::RWMol **nMol)
+    {
+        EditDescriptor edit;
+        if (!SampleEdit(data, edit)) {
+            *nMol = NULL;
+            return;
+        }
+        MolpherGraph graph(data.graph);
+        Apply(data, edit, graph);
+        *nMol = graph.ToRWMol();
+    }
+
+    /**
+     * Chooses a random edit, false if the operator has none.
+     */
+    virtual bool SampleEdit(MorphingData &data, EditDescriptor &edit) = 0;
+
+    /**
+     * Lists every edit of this operator, data must be prepared for it.
+     */
+    virtual void EnumerateEdits(MorphingData &data,
+        std::vector<EditDescriptor> &edits) = 0;
+
+    /**
+     * Applies the given edit to graph, a copy of data.graph.
+     */
+    virtual void Apply(MorphingData &data, const EditDescriptor &edit,
+        MolpherGraph &graph) = 0;
+
     virtual ChemOperSelector GetSelector() = 0;
 };
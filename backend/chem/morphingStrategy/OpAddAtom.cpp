@@ -17,45 +17,60 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpAddAtom.hpp"
 
-void OpAddAtom::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpAddAtom::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
+    if (data.addAtomCandidates.size() == 0) {
+        return false;
+    }
 
-    RDKit::Atom atom;
-    GetRandomAtom(data.atoms, atom);
+    edit = EditDescriptor(OP_ADD_ATOM);
+    edit.sub = SynchRand::GetRandomNumber(data.atoms.size() - 1);
+    edit.pos = SynchRand::GetRandomNumber(data.addAtomCandidates.size() - 1);
 
-    if (data.addAtomCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+    std::vector<BondIdx> nonSingleBonds;
+    data.graph.GetNonSingleBonds(data.addAtomCandidates[edit.pos], nonSingleBonds);
+    if (!nonSingleBonds.empty() && (SynchRand::GetRandomNumber(0, 1) > 0)) {
+        edit.variant = SynchRand::GetRandomNumber(nonSingleBonds.size() - 1);
     }
+    return true;
+}
 
-    AtomIdx bindingAtomIdx =
-        data.addAtomCandidates[SynchRand::GetRandomNumber(
-        data.addAtomCandidates.size() - 1)];
+void OpAddAtom::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.addAtomCandidates.size(); ++pos) {
+        std::vector<BondIdx> nonSingleBonds;
+        data.graph.GetNonSingleBonds(data.addAtomCandidates[pos], nonSingleBonds);
+        for (int sub = 0; sub < data.atoms.size(); ++sub) {
+            // -1 keeps the bonds of the binding atom untouched
+            for (int variant = -1; variant < (int) nonSingleBonds.size(); ++variant) {
+                edits.push_back(EditDescriptor(OP_ADD_ATOM, pos, sub, variant));
+            }
+        }
+    }
+}
 
-    RDKit::Atom *bindingAtom = newMol->getAtomWithIdx(bindingAtomIdx);
+void OpAddAtom::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    AtomIdx bindingAtomIdx = data.addAtomCandidates[edit.pos];
 
-    AtomIdx newAtomIdx = newMol->addAtom(&atom); // atom is copied
+    AtomIdx newAtomIdx = graph.AddAtom(data.atoms[edit.sub]);
 
-    if (HasNonSingleBond(*bindingAtom) && (SynchRand::GetRandomNumber(0, 1) > 0)) {
-        RDKit::Bond *bond = GetRandomNonSingleBond(*bindingAtom);
-        DecreaseBondOrder(*bond);
+    if (edit.variant >= 0) {
+        std::vector<BondIdx> nonSingleBonds;
+        graph.GetNonSingleBonds(bindingAtomIdx, nonSingleBonds);
+        BondIdx bondIdx = nonSingleBonds[edit.variant];
+        graph.SetBondType(bondIdx, DecreasedBondType(graph.bonds[bondIdx].type));
     }
 
-    newMol->addBond(bindingAtom->getIdx(), newAtomIdx, RDKit::Bond::SINGLE);
+    graph.AddBond(bindingAtomIdx, newAtomIdx, RDKit::Bond::SINGLE);
 }
 
 ChemOperSelector OpAddAtom::GetSelector()
 {
     return OP_ADD_ATOM;
-}
\ No newline at end of file
+}
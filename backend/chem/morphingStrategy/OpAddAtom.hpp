@@ -22,6 +22,8 @@
 class OpAddAtom : public MorphingStrategy
 {
 public:
-    void Morph(MorphingData &data, RDKit::RWMol **nMol);
+    bool SampleEdit(MorphingData &data, EditDescriptor &edit);
+    void EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits);
+    void Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph);
     ChemOperSelector GetSelector();
 };
\ No newline at end of file
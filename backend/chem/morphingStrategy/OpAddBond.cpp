@@ -17,33 +17,38 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpAddBond.hpp"
 
-void OpAddBond::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpAddBond::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
     if (data.addBondCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
 
     int randPos = SynchRand::GetRandomNumber(data.addBondCandidates.size() - 1);
-    AtomIdx idx1 = data.addBondCandidates[randPos].first;
-    AtomIdx idx2 = data.addBondCandidates[randPos].second;
-    RDKit::Bond *bond = newMol->getBondBetweenAtoms(idx1, idx2);
-    if (!bond) {
-        newMol->addBond(idx1, idx2, RDKit::Bond::SINGLE);
+    edit = EditDescriptor(OP_ADD_BOND, randPos);
+    return true;
+}
+
+void OpAddBond::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.addBondCandidates.size(); ++pos) {
+        edits.push_back(EditDescriptor(OP_ADD_BOND, pos));
+    }
+}
+
+void OpAddBond::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    AtomIdx idx1 = data.addBondCandidates[edit.pos].first;
+    AtomIdx idx2 = data.addBondCandidates[edit.pos].second;
+    int bondIdx = graph.FindBond(idx1, idx2);
+    if (bondIdx < 0) {
+        graph.AddBond(idx1, idx2, RDKit::Bond::SINGLE);
     } else {
-        IncreaseBondOrder(*bond);
+        graph.SetBondType(bondIdx, IncreasedBondType(graph.bonds[bondIdx].type));
     }
 }
 
@@ -16,73 +16,64 @@
  */
 
 #include <vector>
-
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
+#include <utility>
 
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpBondContraction.hpp"
 
-void OpBondContraction::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpBondContraction::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
     if (data.bondContractionCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
 
-    int randPos =
-        SynchRand::GetRandomNumber(data.bondContractionCandidates.size() - 1);
-    RDKit::Bond *bond =
-        newMol->getBondWithIdx(data.bondContractionCandidates[randPos]);
-    RDKit::Atom *atomToRemove = bond->getEndAtom();
-    RDKit::Atom *atomToStay = bond->getBeginAtom();
+    int randPos = SynchRand::GetRandomNumber(data.bondContractionCandidates.size() - 1);
+    edit = EditDescriptor(OP_BOND_CONTRACTION, randPos);
+    return true;
+}
 
-    std::vector<RDKit::Bond *> bondsToRemove;
-    RDKit::Bond *bondToChange;
-    RDKit::ROMol::OEDGE_ITER beg, end;
-    boost::tie(beg, end) = newMol->getAtomBonds(atomToRemove);
-    while (beg != end) {
-        bondToChange = (**nMol)[*beg++].get();
-        if (bondToChange->getIdx() == bond->getIdx()) {
+void OpBondContraction::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.bondContractionCandidates.size(); ++pos) {
+        edits.push_back(EditDescriptor(OP_BOND_CONTRACTION, pos));
+    }
+}
+
+void OpBondContraction::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    BondIdx bondIdx = data.bondContractionCandidates[edit.pos];
+    AtomIdx atomToRemove = graph.bonds[bondIdx].end;
+    AtomIdx atomToStay = graph.bonds[bondIdx].begin;
+
+    // bonds are only appended until the removal below, indices stay valid
+    std::vector<BondIdx> atomBonds;
+    graph.GetAtomBonds(atomToRemove, atomBonds);
+
+    std::vector<std::pair<AtomIdx, AtomIdx> > bondsToRemove;
+    for (int i = 0; i < atomBonds.size(); ++i) {
+        if (atomBonds[i] == bondIdx) {
             continue;
         }
-        if (bondToChange->getBeginAtomIdx() == atomToRemove->getIdx()) {
-            if (!newMol->getBondBetweenAtoms(
-                        atomToStay->getIdx(), bondToChange->getEndAtomIdx()) &&
-                    !newMol->getBondBetweenAtoms(
-                        bondToChange->getEndAtomIdx(), atomToStay->getIdx())) {
-                newMol->addBond(atomToStay->getIdx(),
-                    bondToChange->getEndAtomIdx(), bondToChange->getBondType());
+        const MolpherGraph::Bond bondToChange = graph.bonds[atomBonds[i]];
+        if (bondToChange.begin == atomToRemove) {
+            if (graph.FindBond(atomToStay, bondToChange.end) < 0) {
+                graph.AddBond(atomToStay, bondToChange.end, bondToChange.type);
             }
-            bondsToRemove.push_back(bondToChange);
-        }
-        if (bondToChange->getEndAtomIdx() == atomToRemove->getIdx()) {
-            if (!newMol->getBondBetweenAtoms(
-                        bondToChange->getBeginAtomIdx(), atomToStay->getIdx()) &&
-                    !newMol->getBondBetweenAtoms(
-                        atomToStay->getIdx(), bondToChange->getBeginAtomIdx())) {
-                newMol->addBond(bondToChange->getBeginAtomIdx(),
-                    atomToStay->getIdx(), bondToChange->getBondType());
+        } else {
+            if (graph.FindBond(bondToChange.begin, atomToStay) < 0) {
+                graph.AddBond(bondToChange.begin, atomToStay, bondToChange.type);
             }
-            bondsToRemove.push_back(bondToChange);
         }
+        bondsToRemove.push_back(std::make_pair(bondToChange.begin, bondToChange.end));
     }
 
-    AtomIdx beginAtomIdx;
-    AtomIdx endAtomIdx;
     for (int i = 0; i < bondsToRemove.size(); ++i) {
-        beginAtomIdx = bondsToRemove[i]->getBeginAtomIdx();
-        endAtomIdx = bondsToRemove[i]->getEndAtomIdx();
-        newMol->removeBond(beginAtomIdx, endAtomIdx);
+        graph.RemoveBond(bondsToRemove[i].first, bondsToRemove[i].second);
     }
 
-    newMol->removeAtom(atomToRemove);
+    graph.RemoveAtom(atomToRemove);
 }
 
 ChemOperSelector OpBondContraction::GetSelector()
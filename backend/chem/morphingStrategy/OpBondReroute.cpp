@@ -17,26 +17,17 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpBondReroute.hpp"
 
-void OpBondReroute::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpBondReroute::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
     if (data.bondRerouteCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
     int randPos = SynchRand::GetRandomNumber(data.bondRerouteCandidates.size() - 1);
-    RDKit::Bond *bond = newMol->getBondWithIdx(data.bondRerouteCandidates[randPos].bondIdx);
     int randSide = SynchRand::GetRandomNumber(0, 1);
     if (data.bondRerouteCandidates[randPos].candidates[randSide].size() == 0) {
         randSide = 1 - randSide;
@@ -46,18 +37,36 @@ void OpBondReroute::Morph(MorphingData &data, RDKit::RWMol **nMol)
         SynchRand::GetRandomNumber(
             data.bondRerouteCandidates[randPos].candidates[randSide].size() - 1);
 
-    AtomIdx beginAtomIdx =
-        (randSide == 0) ? bond->getBeginAtomIdx() : bond->getEndAtomIdx();
+    edit = EditDescriptor(OP_BOND_REROUTE, randPos, randSide, randPos2);
+    return true;
+}
+
+void OpBondReroute::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.bondRerouteCandidates.size(); ++pos) {
+        for (int side = 0; side < 2; ++side) {
+            int cnt = data.bondRerouteCandidates[pos].candidates[side].size();
+            for (int variant = 0; variant < cnt; ++variant) {
+                edits.push_back(EditDescriptor(OP_BOND_REROUTE, pos, side, variant));
+            }
+        }
+    }
+}
+
+void OpBondReroute::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    const MolpherGraph::Bond bond =
+        graph.bonds[data.bondRerouteCandidates[edit.pos].bondIdx];
+
+    AtomIdx beginAtomIdx = (edit.sub == 0) ? bond.begin : bond.end;
     AtomIdx endAtomIdx =
-        data.bondRerouteCandidates[randPos].candidates[randSide][randPos2];
-    AtomIdx remBeginAtom = bond->getBeginAtomIdx();
-    AtomIdx remEndAtom = bond->getEndAtomIdx();
+        data.bondRerouteCandidates[edit.pos].candidates[edit.sub][edit.variant];
 
-    newMol->addBond(beginAtomIdx, endAtomIdx, bond->getBondType());
-    newMol->removeBond(remBeginAtom, remEndAtom);
+    graph.AddBond(beginAtomIdx, endAtomIdx, bond.type);
+    graph.RemoveBond(bond.begin, bond.end);
 }
 
 ChemOperSelector OpBondReroute::GetSelector()
 {
     return OP_BOND_REROUTE;
-}
\ No newline at end of file
+}
@@ -16,51 +16,55 @@
  */
 
 #include <vector>
-
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
+#include <map>
 
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpInterlayAtom.hpp"
 
-void OpInterlayAtom::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpInterlayAtom::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
-    RDKit::Atom atom;
-    MolpherAtomIdx idx = GetRandomAtom(data.atoms, atom);
+    MolpherAtomIdx idx = SynchRand::GetRandomNumber(data.atoms.size() - 1);
 
-    if (data.interlayAtomCandidates.find(idx) == data.interlayAtomCandidates.end()) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+    std::map<MolpherAtomIdx, std::vector<BondIdx> >::iterator it =
+        data.interlayAtomCandidates.find(idx);
+    if (it == data.interlayAtomCandidates.end()) {
+        return false;
     }
-    if (data.interlayAtomCandidates[idx].size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+    if (it->second.size() == 0) {
+        return false;
     }
 
-    int randPos =
-        SynchRand::GetRandomNumber(data.interlayAtomCandidates[idx].size() - 1);
-    RDKit::Bond *bond =
-        newMol->getBondWithIdx((data.interlayAtomCandidates[idx])[randPos]);
+    int randPos = SynchRand::GetRandomNumber(it->second.size() - 1);
+    edit = EditDescriptor(OP_INTERLAY_ATOM, randPos, idx);
+    return true;
+}
 
-    AtomIdx beg = bond->getBeginAtomIdx();
-    AtomIdx end = bond->getEndAtomIdx();
-    RDKit::Bond::BondType bt = bond->getBondType();
+void OpInterlayAtom::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    std::map<MolpherAtomIdx, std::vector<BondIdx> >::iterator it;
+    for (it = data.interlayAtomCandidates.begin();
+            it != data.interlayAtomCandidates.end(); ++it) {
+        for (int pos = 0; pos < it->second.size(); ++pos) {
+            edits.push_back(EditDescriptor(OP_INTERLAY_ATOM, pos, it->first));
+        }
+    }
+}
+
+void OpInterlayAtom::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    BondIdx bondIdx = data.interlayAtomCandidates.find(edit.sub)->second[edit.pos];
+    const MolpherGraph::Bond bond = graph.bonds[bondIdx];
 
-    AtomIdx newAtomIdx = newMol->addAtom(&atom); // atom is copied
+    AtomIdx newAtomIdx = graph.AddAtom(data.atoms[edit.sub]);
 
-    newMol->removeBond(beg, end);
-    newMol->addBond(beg, newAtomIdx, bt);
-    newMol->addBond(newAtomIdx, end, bt);
+    graph.RemoveBond(bond.begin, bond.end);
+    graph.AddBond(bond.begin, newAtomIdx, bond.type);
+    graph.AddBond(newAtomIdx, bond.end, bond.type);
 }
 
 ChemOperSelector OpInterlayAtom::GetSelector()
 {
     return OP_INTERLAY_ATOM;
-}
\ No newline at end of file
+}
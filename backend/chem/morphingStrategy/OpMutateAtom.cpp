@@ -17,34 +17,39 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpMutateAtom.hpp"
 
-void OpMutateAtom::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpMutateAtom::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
-    int randPos = SynchRand::GetRandomNumber(newMol->getNumAtoms() - 1);
+    int randPos = SynchRand::GetRandomNumber(data.mol->getNumAtoms() - 1);
 
     if(data.mutateAtomCandidates[randPos].size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
 
-    RDKit::Atom atom;
-    GetRandomAtom(data.mutateAtomCandidates[randPos], atom);
+    int sub = SynchRand::GetRandomNumber(data.mutateAtomCandidates[randPos].size() - 1);
+    edit = EditDescriptor(OP_MUTATE_ATOM, randPos, sub);
+    return true;
+}
 
-    newMol->replaceAtom(randPos, &atom); // atom is copied
+void OpMutateAtom::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.mutateAtomCandidates.size(); ++pos) {
+        for (int sub = 0; sub < data.mutateAtomCandidates[pos].size(); ++sub) {
+            edits.push_back(EditDescriptor(OP_MUTATE_ATOM, pos, sub));
+        }
+    }
+}
+
+void OpMutateAtom::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    graph.ReplaceAtom(edit.pos, data.mutateAtomCandidates[edit.pos][edit.sub]);
 }
 
 ChemOperSelector OpMutateAtom::GetSelector()
 {
     return OP_MUTATE_ATOM;
-}
\ No newline at end of file
+}
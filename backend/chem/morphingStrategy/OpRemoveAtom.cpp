@@ -17,33 +17,36 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpRemoveAtom.hpp"
 
-void OpRemoveAtom::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpRemoveAtom::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
     if (data.removeAtomCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
 
-    // remove a random boundary atom
     int randPos = SynchRand::GetRandomNumber(data.removeAtomCandidates.size() - 1);
-    AtomIdx atomIdx = data.removeAtomCandidates[randPos];
+    edit = EditDescriptor(OP_REMOVE_ATOM, randPos);
+    return true;
+}
 
-    newMol->removeAtom(atomIdx);
+void OpRemoveAtom::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.removeAtomCandidates.size(); ++pos) {
+        edits.push_back(EditDescriptor(OP_REMOVE_ATOM, pos));
+    }
+}
+
+void OpRemoveAtom::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    // remove a boundary atom
+    graph.RemoveAtom(data.removeAtomCandidates[edit.pos]);
 }
 
 ChemOperSelector OpRemoveAtom::GetSelector()
 {
     return OP_REMOVE_ATOM;
-}
\ No newline at end of file
+}
@@ -17,37 +17,42 @@
 
 #include <vector>
 
-#include <GraphMol/RDKitBase.h>
-#include <GraphMol/QueryOps.h>
-
 #include "auxiliary/SynchRand.h"
 #include "chem/ChemicalAuxiliary.h"
 
 #include "OpRemoveBond.hpp"
 
-void OpRemoveBond::Morph(MorphingData &data, RDKit::RWMol **nMol)
+bool OpRemoveBond::SampleEdit(MorphingData &data, EditDescriptor &edit)
 {
-    *nMol = new RDKit::RWMol(data.mol);
-    RDKit::RWMol *newMol = *nMol;
-
     if (data.removeBondCandidates.size() == 0) {
-        delete newMol;
-        *nMol = NULL;
-        return;
+        return false;
     }
 
     int randPos = SynchRand::GetRandomNumber(data.removeBondCandidates.size() - 1);
-    RDKit::Bond *bond =
-        newMol->getBondWithIdx(data.removeBondCandidates[randPos]);
+    edit = EditDescriptor(OP_REMOVE_BOND, randPos);
+    return true;
+}
+
+void OpRemoveBond::EnumerateEdits(MorphingData &data, std::vector<EditDescriptor> &edits)
+{
+    for (int pos = 0; pos < data.removeBondCandidates.size(); ++pos) {
+        edits.push_back(EditDescriptor(OP_REMOVE_BOND, pos));
+    }
+}
 
-    if (RDKit::queryIsBondInRing(bond)) {
-        newMol->removeBond(bond->getBeginAtomIdx(), bond->getEndAtomIdx());
+void OpRemoveBond::Apply(MorphingData &data, const EditDescriptor &edit, MolpherGraph &graph)
+{
+    BondIdx bondIdx = data.removeBondCandidates[edit.pos];
+    const MolpherGraph::Bond bond = graph.bonds[bondIdx];
+
+    if (bond.inRing) {
+        graph.RemoveBond(bond.begin, bond.end);
     } else {
-        DecreaseBondOrder(*bond);
+        graph.SetBondType(bondIdx, DecreasedBondType(bond.type));
     }
 }
 
 ChemOperSelector OpRemoveBond::GetSelector()
 {
     return OP_REMOVE_BOND;
-}
\ No newline at end of file
+}
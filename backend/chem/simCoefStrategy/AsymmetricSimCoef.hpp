@@ -27,5 +27,6 @@ class AsymmetricSimCoef : public SimCoefStrategy
 {
 public:
     double GetSimCoef(Fingerprint *fp1, Fingerprint *fp2);
+    double GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2);
     double ConvertToDistance(double coef);
 };
\ No newline at end of file
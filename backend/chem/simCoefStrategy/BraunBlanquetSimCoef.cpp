@@ -1,10 +1,22 @@
 
+#include <algorithm>
+
 #include "BraunBlanquetSimCoef.hpp"
 
 double BraunBlanquetSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return BraunBlanquetSimilarity(*fp1, *fp2);
 }
+double BraunBlanquetSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = std::max(fp1Cnt, fp2Cnt);
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double BraunBlanquetSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
@@ -1,10 +1,22 @@
 
+#include <cmath>
+
 #include "CosineSimCoef.hpp"
 
 double CosineSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return CosineSimilarity(*fp1, *fp2);
 }
+double CosineSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = sqrt(fp1Cnt * fp2Cnt);
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double CosineSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
@@ -5,6 +5,16 @@ double DiceSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return DiceSimilarity(*fp1, *fp2);
 }
+double DiceSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = fp1Cnt + fp2Cnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return (2 * commonCnt) / denominator;
+}
 double DiceSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
@@ -5,6 +5,16 @@ double McConnaugheySimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return McConnaugheySimilarity(*fp1, *fp2);
 }
+double McConnaugheySimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = fp1Cnt * fp2Cnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return (commonCnt * (fp1Cnt + fp2Cnt) - fp1Cnt * fp2Cnt) / denominator;
+}
 double McConnaugheySimCoef::ConvertToDistance(double coef)
 {
     return 1 - (coef + 1) / 2;
@@ -5,6 +5,16 @@ double OnBitSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return OnBitSimilarity(*fp1, *fp2);
 }
+double OnBitSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = fp1Cnt + fp2Cnt - commonCnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double OnBitSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
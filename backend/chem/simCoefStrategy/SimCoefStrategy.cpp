@@ -0,0 +1,39 @@
+
+#include <algorithm>
+
+#include "SimCoefStrategy.h"
+
+void SimCoefStrategy::SparseOverlap(const SparseFingerprint &fp1,
+    const SparseFingerprint &fp2,
+    double &fp1Cnt, double &fp2Cnt, double &commonCnt)
+{
+    boost::uint32_t cnt1 = 0, cnt2 = 0, common = 0;
+
+    SparseFingerprint::const_iterator it1 = fp1.begin();
+    SparseFingerprint::const_iterator it2 = fp2.begin();
+    while (it1 != fp1.end() && it2 != fp2.end()) {
+        if (it1->first < it2->first) {
+            cnt1 += it1->second;
+            ++it1;
+        } else if (it2->first < it1->first) {
+            cnt2 += it2->second;
+            ++it2;
+        } else {
+            cnt1 += it1->second;
+            cnt2 += it2->second;
+            common += std::min(it1->second, it2->second);
+            ++it1;
+            ++it2;
+        }
+    }
+    for (; it1 != fp1.end(); ++it1) {
+        cnt1 += it1->second;
+    }
+    for (; it2 != fp2.end(); ++it2) {
+        cnt2 += it2->second;
+    }
+
+    fp1Cnt = cnt1;
+    fp2Cnt = cnt2;
+    commonCnt = common;
+}
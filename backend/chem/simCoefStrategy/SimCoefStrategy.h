@@ -31,10 +31,29 @@
     fp1_n: number of bits in vector 1
     fp1_o: number of on bits in vector 1
     (fp1&fp2)_o: number of on bits in the intersection of vectors 1 and 2
+
+    For sparse count fingerprints, the number of on bits is replaced by
+    the sum of counts and the intersection by the sum of minimal counts
+    of the common keys. As there is no fixed width, fp1_n is taken
+    as the sum of maximal counts of all keys, i.e. (fp1|fp2)_o.
  */
 class SimCoefStrategy
 {
 public:
+    virtual ~SimCoefStrategy() {}
     virtual double GetSimCoef(Fingerprint *fp1, Fingerprint *fp2) = 0;
+    virtual double GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2) = 0;
     virtual double ConvertToDistance(double coef) = 0;
+
+protected:
+    /**
+        Merge intersection of two key-sorted sparse fingerprints.
+
+        @param fp1Cnt [out] fp1_o
+        @param fp2Cnt [out] fp2_o
+        @param commonCnt [out] (fp1&fp2)_o
+     */
+    static void SparseOverlap(const SparseFingerprint &fp1,
+        const SparseFingerprint &fp2,
+        double &fp1Cnt, double &fp2Cnt, double &commonCnt);
 };
@@ -5,6 +5,16 @@ double SokalSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return SokalSimilarity(*fp1, *fp2);
 }
+double SokalSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = 2 * fp1Cnt + 2 * fp2Cnt - 3 * commonCnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double SokalSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
@@ -5,6 +5,16 @@ double TanimotoSimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return TanimotoSimilarity(*fp1, *fp2);
 }
+double TanimotoSimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = fp1Cnt + fp2Cnt - commonCnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double TanimotoSimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
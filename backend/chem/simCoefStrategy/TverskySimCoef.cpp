@@ -27,6 +27,16 @@ double TverskySimCoef::GetSimCoef(Fingerprint *fp1, Fingerprint *fp2)
 {
     return TverskySimilarity(*fp1, *fp2, mA, mB);
 }
+double TverskySimCoef::GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2)
+{
+    double fp1Cnt, fp2Cnt, commonCnt;
+    SparseOverlap(*fp1, *fp2, fp1Cnt, fp2Cnt, commonCnt);
+    double denominator = mA * fp1Cnt + mB * fp2Cnt + (1 - mA - mB) * commonCnt;
+    if (denominator == 0.0) {
+        return 0.0;
+    }
+    return commonCnt / denominator;
+}
 double TverskySimCoef::ConvertToDistance(double coef)
 {
     return 1 - coef;
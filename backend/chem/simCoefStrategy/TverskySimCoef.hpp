@@ -38,6 +38,7 @@ public:
     TverskySimCoef(double a, double b);
 
     double GetSimCoef(Fingerprint *fp1, Fingerprint *fp2);
+    double GetSimCoef(SparseFingerprint *fp1, SparseFingerprint *fp2);
     double ConvertToDistance(double coef);
 
 private:
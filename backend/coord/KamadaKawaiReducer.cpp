@@ -19,6 +19,8 @@
 #include <sstream>
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
+#include <utility>
 
 #include <GraphMol/GraphMol.h>
 #include <GraphMol/SmilesParse/SmilesParse.h>
@@ -30,7 +32,45 @@
 #include "auxiliary/SynchRand.h"
 #include "KamadaKawaiReducer.h"
 
-KamadaKawaiReducer::KamadaKawaiReducer()
+/**
+ * Adds the gradient of the spring between a molecule and another one at
+ * (-dx, -dy) from it to (dEdx, dEdy), sign is -1 to remove it.
+ */
+void inline AddSpringGradient(double stiffnessFactor, double separationFactor,
+    double distance, double dx, double dy, double sign,
+    double &dEdx, double &dEdy)
+{
+    double euclidDistance = sqrt(dx * dx + dy * dy);
+    if (euclidDistance > 0 && distance > 0) {
+        double stiffness = sign * stiffnessFactor / (distance * distance);
+        dEdx += stiffness * (dx - (separationFactor * distance * dx) / euclidDistance);
+        dEdy += stiffness * (dy - (separationFactor * distance * dy) / euclidDistance);
+    }
+}
+
+/**
+ * Largest difference of updated and recalculated gradients relative to the
+ * largest recalculated one.
+ */
+static double GradientDrift(
+    const std::vector<double> &updatedX, const std::vector<double> &updatedY,
+    const std::vector<double> &gradX, const std::vector<double> &gradY)
+{
+    double drift = 0;
+    double largest = 0;
+    for (size_t i = 0; i < gradX.size(); ++i) {
+        double dx = updatedX[i] - gradX[i];
+        double dy = updatedY[i] - gradY[i];
+        drift = std::max(drift, sqrt(dx * dx + dy * dy));
+        largest = std::max(largest,
+            sqrt(gradX[i] * gradX[i] + gradY[i] * gradY[i]));
+    }
+    return largest > 0 ? drift / largest : drift;
+}
+
+KamadaKawaiReducer::KamadaKawaiReducer(bool incremental) :
+    mIncremental(incremental),
+    mGradientDrift(0)
 {
 }
 
@@ -38,6 +78,11 @@ KamadaKawaiReducer::~KamadaKawaiReducer()
 {
 }
 
+double KamadaKawaiReducer::GetGradientDrift() const
+{
+    return mGradientDrift;
+}
+
 bool KamadaKawaiReducer::Cancelled(tbb::task_group_context &ctx)
 {
     return ctx.is_group_execution_cancelled();
@@ -103,186 +148,143 @@ void KamadaKawaiReducer::CalculateFingerprints::operator()(
 }
 
 KamadaKawaiReducer::CalculateDistances::CalculateDistances(
-    SimCoefCalculator &calc, MolPtrVector &mols,
-    std::vector<Fingerprint *> &fingerprints, double **dist
+    SimCoefCalculator &calc, std::vector<Fingerprint *> &fingerprints,
+    TriangularMatrix &dist
     ) :
     mCalc(calc),
-    mMols(mols),
     mFingerprints(fingerprints),
     mDist(dist)
 {
-    assert(mDist);
+    assert(mDist.GetSize() == mFingerprints.size());
 }
 
 void KamadaKawaiReducer::CalculateDistances::operator()(
-    const tbb::blocked_range2d<size_t> &r) const
+    const tbb::blocked_range<size_t> &r) const
 {
-    for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
-        for (size_t j = r.cols().begin(); j != r.cols().end(); ++j) {
+    for (size_t i = r.begin(); i != r.end(); ++i) {
+        if (i == 0) {
+            continue; // empty row
+        }
+        float *row = mDist.GetRow(i);
+        for (size_t j = 0; j < i; ++j) {
             double dist = 1.0;
             if (mFingerprints[i] && mFingerprints[j]) {
                 double coeff = mCalc.GetSimCoef(mFingerprints[i], mFingerprints[j]);
-                bool connected = true;
-                    //(mMols[i]->parentSmile == mMols[j]->smile) ||
-                    //(mMols[j]->parentSmile == mMols[i]->smile);
-                if (connected) {
-                    dist = mCalc.ConvertToDistance(coeff);
-                } else {
-                    dist = 2 * mCalc.ConvertToDistance(coeff);
-                }
+                dist = mCalc.ConvertToDistance(coeff);
             }
-            mDist[i][j] = dist * 100;
+            row[j] = dist * 100;
         }
     }
 }
 
-KamadaKawaiReducer::IterateFloydWarshall::IterateFloydWarshall(
-    size_t iter, double **last, double **current
+KamadaKawaiReducer::CalculateGradients::CalculateGradients(
+    double stiffnessFactor, double separationFactor,
+    MolPtrVector &mols, const TriangularMatrix &dist,
+    const std::vector<size_t> &molIdxs,
+    std::vector<double> &gradX, std::vector<double> &gradY
     ) :
-    mIter(iter),
-    mLast(last),
-    mCurrent(current)
-{
-    assert(mLast);
-    assert(mCurrent);
-}
-
-void KamadaKawaiReducer::IterateFloydWarshall::operator()(
-    const tbb::blocked_range2d<size_t> &r) const
-{
-    for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
-        for (size_t j = r.cols().begin(); j != r.cols().end(); ++j) {
-            double oldDist = mLast[i][j];
-            double newDist = mLast[i][mIter] + mLast[mIter][j];
-            mCurrent[i][j] = newDist < oldDist ? newDist : oldDist;
-        }
-    }
-}
-
-KamadaKawaiReducer::CalculateStiffness::CalculateStiffness(
-    double stiffnessFactor, double **dist, double **stiff
-    ) :
-    mFactor(stiffnessFactor),
+    mStiffness(stiffnessFactor),
+    mFactor(separationFactor),
+    mMols(mols),
     mDist(dist),
-    mStiff(stiff)
+    mMolIdxs(molIdxs),
+    mGradX(gradX),
+    mGradY(gradY)
 {
-    assert(mDist);
-    assert(mStiff);
+    assert(mDist.GetSize() == mMols.size());
+    assert(mGradX.size() == mMols.size());
+    assert(mGradY.size() == mMols.size());
 }
 
-void KamadaKawaiReducer::CalculateStiffness::operator()(
-    const tbb::blocked_range2d<size_t> &r) const
+void KamadaKawaiReducer::CalculateGradients::operator()(
+    const tbb::blocked_range<size_t> &r) const
 {
-    for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
-        for (size_t j = r.cols().begin(); j != r.cols().end(); ++j) {
-            double d = mDist[i][j];
-            if (d > 0) {
-                mStiff[i][j] = mFactor / (d * d);
-            } else {
-                mStiff[i][j] = 0;
-            }
+    for (size_t k = r.begin(); k != r.end(); ++k) {
+        size_t i = mMolIdxs[k];
+        double dEdx = 0; // dE/dx
+        double dEdy = 0; // dE/dy
+
+        for (size_t j = 0; j < mMols.size(); ++j) {
+            AddSpringGradient(mStiffness, mFactor, mDist.Get(i, j),
+                mMols[i]->posX - mMols[j]->posX,
+                mMols[i]->posY - mMols[j]->posY, 1, dEdx, dEdy);
         }
+
+        mGradX[i] = dEdx;
+        mGradY[i] = dEdy;
     }
 }
 
-KamadaKawaiReducer::FindMaxGradient::FindMaxGradient(
-    double separationFactor, MolPtrVector &mols, double **dist, double **stiff
+KamadaKawaiReducer::UpdateGradients::UpdateGradients(
+    double stiffnessFactor, double separationFactor,
+    MolPtrVector &mols, const TriangularMatrix &dist,
+    const std::vector<size_t> &movedIdxs,
+    const std::vector<double> &oldX, const std::vector<double> &oldY,
+    std::vector<double> &gradX, std::vector<double> &gradY
     ) :
+    mStiffness(stiffnessFactor),
     mFactor(separationFactor),
-    mMaxGradient(0),
-    mMaxGradientIdx(0),
     mMols(mols),
     mDist(dist),
-    mStiff(stiff)
-{
-    assert(mDist);
-    assert(mStiff);
-}
-
-KamadaKawaiReducer::FindMaxGradient::FindMaxGradient(
-    FindMaxGradient &toSplit, tbb::split
-    ) :
-    mFactor(toSplit.mFactor),
-    mMaxGradient(0),
-    mMaxGradientIdx(0),
-    mMols(toSplit.mMols),
-    mDist(toSplit.mDist),
-    mStiff(toSplit.mStiff)
+    mMovedIdxs(movedIdxs),
+    mOldX(oldX),
+    mOldY(oldY),
+    mGradX(gradX),
+    mGradY(gradY)
 {
+    assert(mMovedIdxs.size() == mOldX.size());
+    assert(mMovedIdxs.size() == mOldY.size());
 }
 
-void KamadaKawaiReducer::FindMaxGradient::operator()(
-    const tbb::blocked_range<size_t> &r)
+void KamadaKawaiReducer::UpdateGradients::operator()(
+    const tbb::blocked_range<size_t> &r) const
 {
+    // Only the springs to the moved molecules changed. Gradients of the
+    // moved molecules themselves are not valid after this.
     for (size_t i = r.begin(); i != r.end(); ++i) {
-        double dEdx = 0; // dE/dx
-        double dEdy = 0; // dE/dy
-
-        for (int j = 0; j < mMols.size(); ++j) {
-            double dx = mMols[i]->posX - mMols[j]->posX;
-            double dy = mMols[i]->posY - mMols[j]->posY;
-            double euclidDistance = sqrt(dx * dx + dy * dy);
-
-            if (euclidDistance > 0) {
-                double stiffness = mStiff[i][j];
-                double distance = mDist[i][j];
-
-                dEdx += stiffness * (dx - (mFactor * distance * dx) / euclidDistance);
-                dEdy += stiffness * (dy - (mFactor * distance * dy) / euclidDistance);
-            }
+        double dEdx = mGradX[i];
+        double dEdy = mGradY[i];
+
+        for (size_t k = 0; k < mMovedIdxs.size(); ++k) {
+            size_t m = mMovedIdxs[k];
+            double distance = mDist.Get(i, m);
+            AddSpringGradient(mStiffness, mFactor, distance,
+                mMols[i]->posX - mOldX[k], mMols[i]->posY - mOldY[k], -1,
+                dEdx, dEdy);
+            AddSpringGradient(mStiffness, mFactor, distance,
+                mMols[i]->posX - mMols[m]->posX,
+                mMols[i]->posY - mMols[m]->posY, 1, dEdx, dEdy);
         }
 
-        double currentGradient = sqrt(dEdx * dEdx + dEdy * dEdy);
-        if (currentGradient > mMaxGradient) {
-            mMaxGradient = currentGradient;
-            mMaxGradientIdx = i;
-        }
+        mGradX[i] = dEdx;
+        mGradY[i] = dEdy;
     }
 }
 
-void KamadaKawaiReducer::FindMaxGradient::join(FindMaxGradient &toJoin)
-{
-    if (toJoin.mMaxGradient > mMaxGradient) {
-        mMaxGradient = toJoin.mMaxGradient;
-        mMaxGradientIdx = toJoin.mMaxGradientIdx;
-    }
-}
-
-double KamadaKawaiReducer::FindMaxGradient::GetMaxGradient()
-{
-    return mMaxGradient;
-}
-
-size_t KamadaKawaiReducer::FindMaxGradient::GetMaxGradientIdx()
-{
-    return mMaxGradientIdx;
-}
-
 KamadaKawaiReducer::IterateNewtonRaphson::IterateNewtonRaphson(
-    double separationFactor, size_t molIdx,
-    MolPtrVector &mols, double **dist, double **stiff
+    double stiffnessFactor, double separationFactor, size_t molIdx,
+    MolPtrVector &mols, const TriangularMatrix &dist
     ) :
+    mStiffness(stiffnessFactor),
     mFactor(separationFactor),
     mMolIdx(molIdx),
     mMols(mols),
     mDist(dist),
-    mStiff(stiff),
     dEdxdx(0), dEdxdy(0),
     dEdydx(0), dEdydy(0),
     dEdx(0), dEdy(0)
 {
-    assert(mDist);
-    assert(mStiff);
+    assert(mDist.GetSize() == mMols.size());
 }
 
 KamadaKawaiReducer::IterateNewtonRaphson::IterateNewtonRaphson(
     IterateNewtonRaphson &toSplit, tbb::split
     ) :
+    mStiffness(toSplit.mStiffness),
     mFactor(toSplit.mFactor),
     mMolIdx(toSplit.mMolIdx),
     mMols(toSplit.mMols),
     mDist(toSplit.mDist),
-    mStiff(toSplit.mStiff),
     dEdxdx(0), dEdxdy(0),
     dEdydx(0), dEdydy(0),
     dEdx(0), dEdy(0)
@@ -298,19 +300,21 @@ void KamadaKawaiReducer::IterateNewtonRaphson::operator()(
         double dy = mMols[mMolIdx]->posY - mMols[i]->posY;
         double euclidDistance = sqrt(dx * dx + dy * dy);
         double cubedDistance = euclidDistance * euclidDistance * euclidDistance;
-
-        if (cubedDistance > 0) {
-            dEdxdx += mStiff[mMolIdx][i] *
-                (1 - (mFactor * mDist[mMolIdx][i] * dy * dy) / cubedDistance);
-            dEdxdy += mStiff[mMolIdx][i] *
-                (mFactor * mDist[mMolIdx][i] * dx * dy) / cubedDistance;
+        double distance = mDist.Get(mMolIdx, i);
+
+        if (cubedDistance > 0 && distance > 0) {
+            double stiffness = mStiffness / (distance * distance);
+            dEdxdx += stiffness *
+                (1 - (mFactor * distance * dy * dy) / cubedDistance);
+            dEdxdy += stiffness *
+                (mFactor * distance * dx * dy) / cubedDistance;
             dEdydx = dEdxdy;
-            dEdydy += mStiff[mMolIdx][i] *
-                (1 - (mFactor * mDist[mMolIdx][i] * dx * dx) / cubedDistance);
-            dEdx += mStiff[mMolIdx][i] *
-                (dx - (mFactor * mDist[mMolIdx][i] * dx) / euclidDistance);
-            dEdy += mStiff[mMolIdx][i] *
-                (dy - (mFactor * mDist[mMolIdx][i] * dy) / euclidDistance);
+            dEdydy += stiffness *
+                (1 - (mFactor * distance * dx * dx) / cubedDistance);
+            dEdx += stiffness *
+                (dx - (mFactor * distance * dx) / euclidDistance);
+            dEdy += stiffness *
+                (dy - (mFactor * distance * dy) / euclidDistance);
         }
     }
 }
@@ -344,6 +348,38 @@ void KamadaKawaiReducer::IterateNewtonRaphson::UpdateCoordinates(
     }
 }
 
+double KamadaKawaiReducer::SelectMolecules(const std::vector<double> &gradX,
+    const std::vector<double> &gradY, size_t count,
+    std::vector<size_t> &selected)
+{
+    // squared gradients, the largest go first
+    std::vector<std::pair<double, size_t> > gradients(gradX.size());
+    for (size_t i = 0; i < gradX.size(); ++i) {
+        gradients[i] = std::make_pair(
+            -(gradX[i] * gradX[i] + gradY[i] * gradY[i]), i);
+    }
+    count = std::min(count, gradients.size());
+    std::partial_sort(gradients.begin(), gradients.begin() + count,
+        gradients.end());
+
+    selected.clear();
+    for (size_t i = 0; i < count; ++i) {
+        selected.push_back(gradients[i].second);
+    }
+    return count > 0 ? sqrt(-gradients[0].first) : 0;
+}
+
+void KamadaKawaiReducer::CalculateDistanceMatrix(SimCoefCalculator &calc,
+    std::vector<Fingerprint *> &fingerprints, TriangularMatrix &dist,
+    tbb::task_group_context &tbbCtx)
+{
+    dist.Resize(fingerprints.size());
+    CalculateDistances calculateDistances(calc, fingerprints, dist);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, fingerprints.size()),
+        calculateDistances, tbb::auto_partitioner(), tbbCtx);
+}
+
 void KamadaKawaiReducer::Reduce(
         MolPtrVector &mols,
         FingerprintSelector fingerprintSelector,
@@ -358,14 +394,6 @@ void KamadaKawaiReducer::Reduce(
     MeasureStage measureStage;
     SimCoefCalculator calc(simCoeffSelector, fingerprintSelector);
 
-    RandomizeCoordinates randomizeCoordinates;
-    if (!Cancelled(tbbCtx)) {
-        tbb::parallel_for(
-            tbb::blocked_range<MolPtrVector::iterator>(mols.begin(), mols.end()),
-            randomizeCoordinates, tbb::auto_partitioner(), tbbCtx);
-        measureStage.ReportAndReset("RandomizeCoordinates");
-    }
-
     std::vector<Fingerprint *> fingerprints;
     fingerprints.resize(mols.size(), NULL);
     CalculateFingerprints calculateFingerprints(calc, mols, fingerprints);
@@ -376,78 +404,116 @@ void KamadaKawaiReducer::Reduce(
         measureStage.ReportAndReset("CalculateFingerprints");
     }
 
-    double **dist;
-    dist = new double *[mols.size()];
-    for (size_t i = 0; i < mols.size(); ++i) {
-        dist[i] = new double[mols.size()];
-    }
-    CalculateDistances calculateDistances(calc, mols, fingerprints, dist);
+    TriangularMatrix dist;
     if (!Cancelled(tbbCtx)) {
-        tbb::parallel_for(
-            tbb::blocked_range2d<size_t>(0, mols.size(), 0, mols.size()),
-            calculateDistances, tbb::auto_partitioner(), tbbCtx);
+        CalculateDistanceMatrix(calc, fingerprints, dist, tbbCtx);
         measureStage.ReportAndReset("CalculateDistances");
     }
     for (size_t i = 0; i < mols.size(); ++i) {
         delete fingerprints[i];
     }
     fingerprints.clear();
-
-    double **temp;
-    temp = new double *[mols.size()];
-    for (size_t i = 0; i < mols.size(); ++i) {
-        temp[i] = new double[mols.size()];
+    if (Cancelled(tbbCtx)) {
+        return;
     }
-    // Find all-pairs shortest paths.
-    for (size_t k = 0; k < mols.size(); ++k) {
 
-        if (!Cancelled(tbbCtx)) {
-            IterateFloydWarshall iterateFloydWarshall(k, dist, temp);
-            tbb::parallel_for(
-                tbb::blocked_range2d<size_t>(0, mols.size(), 0, mols.size()),
-                iterateFloydWarshall, tbb::auto_partitioner(), tbbCtx);
-            double **swap = temp;
-            temp = dist;
-            dist = swap;
-        }
+    Layout(mols, dist, tbbCtx);
+}
 
-        if (Cancelled(tbbCtx)) {
-            break;
-        }
-    }
-    for (size_t i = 0; i < mols.size(); ++i) {
-        delete[] temp[i];
-    }
-    delete[] temp;
+void KamadaKawaiReducer::Layout(MolPtrVector &mols,
+    const TriangularMatrix &dist, tbb::task_group_context &tbbCtx)
+{
+    MeasureStage measureStage;
+
+    RandomizeCoordinates randomizeCoordinates;
     if (!Cancelled(tbbCtx)) {
-        measureStage.ReportAndReset("FloydWarshall");
+        tbb::parallel_for(
+            tbb::blocked_range<MolPtrVector::iterator>(mols.begin(), mols.end()),
+            randomizeCoordinates, tbb::auto_partitioner(), tbbCtx);
+        measureStage.ReportAndReset("RandomizeCoordinates");
     }
 
-    double **stiff;
-    stiff = new double *[mols.size()];
+    // Gradient of every molecule, after a step only the springs to the
+    // moved molecules are updated (O(n) per moved molecule), all of them
+    // are recalculated every n moves and before the layout is accepted.
+    // The updated ones are then compared with the recalculated ones.
+    std::vector<double> gradX(mols.size(), 0);
+    std::vector<double> gradY(mols.size(), 0);
+    std::vector<double> updatedX;
+    std::vector<double> updatedY;
+    bool updated = false;
+    mGradientDrift = 0;
+    std::vector<size_t> allIdxs(mols.size());
     for (size_t i = 0; i < mols.size(); ++i) {
-        stiff[i] = new double[mols.size()];
-    }
-    CalculateStiffness calculateStiffness(KAMADAKAWAIREDUCER_STIFFNESS, dist, stiff);
-    if (!Cancelled(tbbCtx)) {
-        tbb::parallel_for(
-            tbb::blocked_range2d<size_t>(0, mols.size(), 0, mols.size()),
-            calculateStiffness, tbb::auto_partitioner(), tbbCtx);
-        measureStage.ReportAndReset("CalculateStiffness");
+        allIdxs[i] = i;
     }
+    std::vector<size_t> movedIdxs;
+    std::vector<double> oldX;
+    std::vector<double> oldY;
 
-    double currentGradient = DBL_MAX;
-    size_t currentMolIdx = 0;
     size_t outCycles = 0;
-    do {
+    size_t refreshCycles = 0;
+    bool refreshed = false;
+    while (!Cancelled(tbbCtx)) {
+
+        size_t refreshPeriod = mIncremental ? mols.size() : 1;
+        if (!refreshed && (refreshCycles == 0 || refreshCycles >= refreshPeriod)) {
+            if (updated) {
+                updatedX = gradX;
+                updatedY = gradY;
+            }
+            CalculateGradients calculateGradients(KAMADAKAWAIREDUCER_STIFFNESS,
+                KAMADAKAWAIREDUCER_SEPARATION, mols, dist, allIdxs, gradX, gradY);
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, allIdxs.size()),
+                calculateGradients, tbb::auto_partitioner(), tbbCtx);
+            if (updated && !Cancelled(tbbCtx)) {
+                mGradientDrift = std::max(mGradientDrift,
+                    GradientDrift(updatedX, updatedY, gradX, gradY));
+            }
+            refreshCycles = 0;
+            refreshed = true;
+            updated = false;
+        }
+
+        // Determine molecules for next round.
+        double maxGradient = SelectMolecules(
+            gradX, gradY, KAMADAKAWAIREDUCER_BATCHSIZE, movedIdxs);
+        if (maxGradient <= KAMADAKAWAIREDUCER_GLOBALEPSILON) {
+            if (refreshed) {
+                break;
+            }
+            // confirm with exact gradients
+            refreshCycles = 0;
+            continue;
+        }
+        refreshed = false;
+
+        oldX.resize(movedIdxs.size());
+        oldY.resize(movedIdxs.size());
+        for (size_t k = 0; k < movedIdxs.size(); ++k) {
+            size_t currentMolIdx = movedIdxs[k];
+            oldX[k] = mols[currentMolIdx]->posX;
+            oldY[k] = mols[currentMolIdx]->posY;
+            if (k > 0) {
+                // the molecules before it in the batch have moved, so its
+                // stored gradient is stale
+                CalculateGradients calculateGradient(
+                    KAMADAKAWAIREDUCER_STIFFNESS, KAMADAKAWAIREDUCER_SEPARATION,
+                    mols, dist, movedIdxs, gradX, gradY);
+                calculateGradient(tbb::blocked_range<size_t>(k, k + 1));
+            }
+            double currentGradient = sqrt(
+                gradX[currentMolIdx] * gradX[currentMolIdx] +
+                gradY[currentMolIdx] * gradY[currentMolIdx]);
 
-        if (currentGradient != DBL_MAX) {
             // Find zero of nonlinear system of equations.
             size_t inCycles = 0;
             while (currentGradient > KAMADAKAWAIREDUCER_LOCALEPSILON) {
 
                 IterateNewtonRaphson iterateNewtonRaphson(
-                    KAMADAKAWAIREDUCER_SEPARATION, currentMolIdx, mols, dist, stiff);
+                    KAMADAKAWAIREDUCER_STIFFNESS, KAMADAKAWAIREDUCER_SEPARATION,
+                    currentMolIdx, mols, dist);
                 if (!Cancelled(tbbCtx)) {
                     tbb::parallel_reduce(
                         tbb::blocked_range<size_t>(0, mols.size()),
@@ -473,33 +539,26 @@ void KamadaKawaiReducer::Reduce(
         //    measureStage.ReportAndReset("IterateNewtonRaphson");
         //}
 
-        // Determine molecule for next round.
-        FindMaxGradient findMaxGradient(
-            KAMADAKAWAIREDUCER_SEPARATION, mols, dist, stiff);
-        if (!Cancelled(tbbCtx)) {
-            tbb::parallel_reduce(
-                tbb::blocked_range<size_t>(0, mols.size()),
-                findMaxGradient, tbb::auto_partitioner(), tbbCtx);
-            //measureStage.ReportAndReset("FindMaxGradient");
-        }
-        currentGradient = findMaxGradient.GetMaxGradient();
-        currentMolIdx = findMaxGradient.GetMaxGradientIdx();
+        UpdateGradients updateGradients(KAMADAKAWAIREDUCER_STIFFNESS,
+            KAMADAKAWAIREDUCER_SEPARATION, mols, dist, movedIdxs, oldX, oldY,
+            gradX, gradY);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, mols.size()),
+            updateGradients, tbb::auto_partitioner(), tbbCtx);
+        CalculateGradients calculateGradients(KAMADAKAWAIREDUCER_STIFFNESS,
+            KAMADAKAWAIREDUCER_SEPARATION, mols, dist, movedIdxs, gradX, gradY);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, movedIdxs.size()),
+            calculateGradients, tbb::auto_partitioner(), tbbCtx);
+        updated = true;
 
-        if (Cancelled(tbbCtx) ||
-                (++outCycles > mols.size() * KAMADAKAWAIREDUCER_GLOBALITERRATIO)) {
+        refreshCycles += movedIdxs.size();
+        outCycles += movedIdxs.size();
+        if (outCycles > mols.size() * KAMADAKAWAIREDUCER_GLOBALITERRATIO) {
             break;
         }
-    } while (currentGradient > KAMADAKAWAIREDUCER_GLOBALEPSILON);
+    }
     if (!Cancelled(tbbCtx)) {
         measureStage.ReportAndReset("CalculateCoordinates");
     }
-
-    for (size_t i = 0; i < mols.size(); ++i) {
-        delete[] stiff[i];
-    }
-    delete[] stiff;
-    for (size_t i = 0; i < mols.size(); ++i) {
-        delete[] dist[i];
-    }
-    delete[] dist;
 }
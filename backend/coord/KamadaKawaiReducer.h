@@ -26,13 +26,13 @@
 
 #include <tbb/task.h>
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_reduce.h>
 
 #include "global_types.h"
 #include "fingerprint_selectors.h"
 #include "simcoeff_selectors.h"
 #include "DimensionReducer.h"
+#include "TriangularMatrix.h"
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
 #include "chem/SimCoefCalculator.hpp"
 
@@ -64,10 +64,21 @@
 #define KAMADAKAWAIREDUCER_MAXLOCALITER 100
 #endif
 
+// molecules moved per step, their gradients are updated together
+#ifndef KAMADAKAWAIREDUCER_BATCHSIZE
+#define KAMADAKAWAIREDUCER_BATCHSIZE 1
+#endif
+
 class KamadaKawaiReducer : public DimensionReducer
 {
 public:
-    KamadaKawaiReducer();
+    /**
+     * Base ctor.
+     * @param bool incremental If false, the gradients of all molecules are
+     * recalculated after every step instead of updating them by the springs
+     * to the moved molecules. Kept as a reference for molpher-bench.
+     */
+    KamadaKawaiReducer(bool incremental = true);
     virtual ~KamadaKawaiReducer();
 
     virtual void Reduce(
@@ -76,6 +87,32 @@ public:
         SimCoeffSelector simCoeffSelector,
         tbb::task_group_context &tbbCtx);
 
+    /**
+     * Distances of all pairs of fingerprints, scaled for the layout. The
+     * graph of molecules is complete, so the direct distances are used as
+     * the graph distances (no shortest paths are searched).
+     */
+    static void CalculateDistanceMatrix(SimCoefCalculator &calc,
+        std::vector<Fingerprint *> &fingerprints, TriangularMatrix &dist,
+        tbb::task_group_context &tbbCtx);
+
+    /**
+     * Second half of Reduce: places the molecules at random and moves them
+     * until their euclidean distances match dist (see
+     * CalculateDistanceMatrix). Memory is the O(n^2) dist itself, time is
+     * O(n) per moved molecule.
+     */
+    void Layout(MolPtrVector &mols, const TriangularMatrix &dist,
+        tbb::task_group_context &tbbCtx);
+
+    /**
+     * Largest difference between the updated and the recalculated gradient
+     * of a molecule seen by the last Layout, relative to the largest
+     * recalculated gradient. The gradients are compared whenever all of
+     * them are recalculated.
+     */
+    double GetGradientDrift() const;
+
 protected:
     class RandomizeCoordinates
     {
@@ -100,66 +137,62 @@ protected:
     class CalculateDistances
     {
     public:
-        CalculateDistances(SimCoefCalculator &calc, MolPtrVector &mols,
-            std::vector<Fingerprint *> &fingerprints, double **dist);
-        void operator()(const tbb::blocked_range2d<size_t> &r) const;
+        CalculateDistances(SimCoefCalculator &calc,
+            std::vector<Fingerprint *> &fingerprints, TriangularMatrix &dist);
+        void operator()(const tbb::blocked_range<size_t> &r) const;
 
     private:
         SimCoefCalculator &mCalc;
-        MolPtrVector &mMols;
         std::vector<Fingerprint *> &mFingerprints;
-        double **mDist;
+        TriangularMatrix &mDist;
     };
 
-    class IterateFloydWarshall
+    class CalculateGradients
     {
     public:
-        IterateFloydWarshall(size_t iter, double **last, double **current);
-        void operator()(const tbb::blocked_range2d<size_t> &r) const;
-
-    private:
-        size_t mIter;
-        double **mLast;
-        double **mCurrent;
-    };
-
-    class CalculateStiffness
-    {
-    public:
-        CalculateStiffness(double stiffnessFactor, double **dist, double **stiff);
-        void operator()(const tbb::blocked_range2d<size_t> &r) const;
+        CalculateGradients(double stiffnessFactor, double separationFactor,
+            MolPtrVector &mols, const TriangularMatrix &dist,
+            const std::vector<size_t> &molIdxs,
+            std::vector<double> &gradX, std::vector<double> &gradY);
+        void operator()(const tbb::blocked_range<size_t> &r) const;
 
     private:
+        double mStiffness;
         double mFactor;
-        double **mDist;
-        double **mStiff;
+        MolPtrVector &mMols;
+        const TriangularMatrix &mDist;
+        const std::vector<size_t> &mMolIdxs;
+        std::vector<double> &mGradX;
+        std::vector<double> &mGradY;
     };
 
-    class FindMaxGradient
+    class UpdateGradients
     {
     public:
-        FindMaxGradient(double separationFactor,
-            MolPtrVector &mols, double **dist, double **stiff);
-        FindMaxGradient(FindMaxGradient &toSplit, tbb::split);
-        void operator()(const tbb::blocked_range<size_t> &r);
-        void join(FindMaxGradient &toJoin);
-        double GetMaxGradient();
-        size_t GetMaxGradientIdx();
+        UpdateGradients(double stiffnessFactor, double separationFactor,
+            MolPtrVector &mols, const TriangularMatrix &dist,
+            const std::vector<size_t> &movedIdxs,
+            const std::vector<double> &oldX, const std::vector<double> &oldY,
+            std::vector<double> &gradX, std::vector<double> &gradY);
+        void operator()(const tbb::blocked_range<size_t> &r) const;
 
     private:
+        double mStiffness;
         double mFactor;
-        double mMaxGradient;
-        size_t mMaxGradientIdx;
         MolPtrVector &mMols;
-        double **mDist;
-        double **mStiff;
+        const TriangularMatrix &mDist;
+        const std::vector<size_t> &mMovedIdxs;
+        const std::vector<double> &mOldX;
+        const std::vector<double> &mOldY;
+        std::vector<double> &mGradX;
+        std::vector<double> &mGradY;
     };
 
     class IterateNewtonRaphson
     {
     public:
-        IterateNewtonRaphson(double separationFactor, size_t molIdx,
-            MolPtrVector &mols, double **dist, double **stiff);
+        IterateNewtonRaphson(double stiffnessFactor, double separationFactor,
+            size_t molIdx, MolPtrVector &mols, const TriangularMatrix &dist);
         IterateNewtonRaphson(IterateNewtonRaphson &toSplit, tbb::split);
         void operator()(const tbb::blocked_range<size_t> &r);
         void join(IterateNewtonRaphson &toJoin);
@@ -167,11 +200,11 @@ protected:
         void UpdateCoordinates(double &x, double &y);
 
     private:
+        double mStiffness;
         double mFactor;
         size_t mMolIdx;
         MolPtrVector &mMols;
-        double **mDist;
-        double **mStiff;
+        const TriangularMatrix &mDist;
 
         double dEdxdx; // dE/dxdx
         double dEdxdy; // dE/dxdy
@@ -191,5 +224,12 @@ protected:
         clock_t mTimestamp;
     };
 
+    double SelectMolecules(const std::vector<double> &gradX,
+        const std::vector<double> &gradY, size_t count,
+        std::vector<size_t> &selected);
+
     bool Cancelled(tbb::task_group_context &ctx);
+
+    bool mIncremental;
+    double mGradientDrift;
 };
@@ -25,6 +25,8 @@
 #include <math.h>
 #include <limits>
 #include <fstream>
+#include <bitset>
+#include <climits>
 #include <sstream>
 
 #include <GraphMol/GraphMol.h>
@@ -33,6 +35,8 @@
 #include <tbb/partitioner.h>
 #include <tbb/parallel_for.h>
 
+#include <boost/dynamic_bitset.hpp>
+
 #include "inout.h"
 #include "auxiliary/SynchRand.h"
 
@@ -40,6 +44,11 @@
 
 //#define LOG_PCA_DATA
 
+/**
+ * Word of the fingerprint bit storage (ExplicitBitVect::dp_bits).
+ */
+typedef boost::dynamic_bitset<>::block_type BitBlock;
+
 /**
  * Return false if given value is nan of inf.
  */
@@ -150,6 +159,36 @@ double inline MultiplyScalar(const double* left, const double* right, size_t dat
     return result;
 }
 
+/**
+ * Number of set bits in a fingerprint word.
+ */
+size_t inline PopCount(BitBlock word) {
+#ifdef __GNUC__
+    return __builtin_popcountl(word);
+#else
+    return std::bitset<sizeof(BitBlock) * CHAR_BIT>(word).count();
+#endif
+}
+
+/**
+ * Number of set bits in [begin, end) of the bit array stored in words.
+ */
+size_t inline CountBits(const BitBlock* blocks, size_t begin, size_t end) {
+    static const size_t bitsPerBlock = sizeof(BitBlock) * CHAR_BIT;
+    size_t count = 0;
+    while (begin < end) {
+        size_t offset = begin % bitsPerBlock;
+        size_t length = std::min(bitsPerBlock - offset, end - begin);
+        BitBlock word = blocks[begin / bitsPerBlock] >> offset;
+        if (length < bitsPerBlock) {
+            word &= (((BitBlock) 1) << length) - 1;
+        }
+        count += PopCount(word);
+        begin += length;
+    }
+    return count;
+}
+
 /**
  * Normalize given vector.
  * @param[in,out] double* Vector to normalize.
@@ -203,7 +242,117 @@ void inline Orthogonalized(
     }
 }
 
-PcaReducer::PcaReducer() {
+/**
+ * Makes vectors orthonormal by modified Gram-Schmidt. A vector
+ * dependent on the previous ones is replaced by a unit vector
+ * that is not.
+ * @param[in,out] double* vectors Vectors stored one after another.
+ * @param[in] size_t count Number of vectors, at most dataDimension.
+ * @param[in] size_t dataDimension Vectors size.
+ */
+void inline Orthonormalize(double* vectors, size_t count, size_t dataDimension) {
+    size_t nextUnit = 0;
+    for (size_t k = 0; k < count; ++k) {
+        double* vector = vectors + (k * dataDimension);
+        while (true) {
+            for (size_t j = 0; j < k; ++j) {
+                Orthogonalized(vectors + (j * dataDimension), vector, vector,
+                    dataDimension);
+            }
+            if (MultiplyScalar(vector, vector, dataDimension) > 1e-20) {
+                break;
+            }
+            assert(nextUnit < dataDimension);
+            std::fill(vector, vector + dataDimension, 0.0);
+            vector[nextUnit++] = 1;
+        }
+        Normalize(vector, dataDimension);
+    }
+}
+
+/**
+ * Eigen values and vectors of small symmetric matrix by cyclic Jacobi
+ * rotations, sorted by eigen value from the largest.
+ * @param[in] std::vector<double> matrix Square matrix stored as rows.
+ * @param[in] size_t dataDimension Size of matrix.
+ * @param[out] std::vector<double>& values Eigen values.
+ * @param[out] std::vector<double>& vectors Eigen vectors as columns.
+ */
+void inline JacobiEigen(std::vector<double> matrix, size_t dataDimension,
+        std::vector<double>& values, std::vector<double>& vectors) {
+    size_t n = dataDimension;
+    std::vector<double> rotated(n * n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        rotated[i * n + i] = 1;
+    }
+
+    for (int sweep = 0; sweep < 50; ++sweep) {
+        double offDiagonal = 0;
+        for (size_t p = 0; p < n; ++p) {
+            for (size_t q = p + 1; q < n; ++q) {
+                offDiagonal += matrix[p * n + q] * matrix[p * n + q];
+            }
+        }
+        if (offDiagonal < 1e-30) {
+            break;
+        }
+        for (size_t p = 0; p < n; ++p) {
+            for (size_t q = p + 1; q < n; ++q) {
+                double apq = matrix[p * n + q];
+                if (std::fabs(apq) < 1e-300) {
+                    continue;
+                }
+                double theta = (matrix[q * n + q] - matrix[p * n + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1.0 : -1.0) /
+                    (std::fabs(theta) + std::sqrt(theta * theta + 1));
+                double c = 1 / std::sqrt(t * t + 1);
+                double s = t * c;
+                for (size_t k = 0; k < n; ++k) {
+                    double akp = matrix[k * n + p];
+                    double akq = matrix[k * n + q];
+                    matrix[k * n + p] = c * akp - s * akq;
+                    matrix[k * n + q] = s * akp + c * akq;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    double apk = matrix[p * n + k];
+                    double aqk = matrix[q * n + k];
+                    matrix[p * n + k] = c * apk - s * aqk;
+                    matrix[q * n + k] = s * apk + c * aqk;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    double vkp = rotated[k * n + p];
+                    double vkq = rotated[k * n + q];
+                    rotated[k * n + p] = c * vkp - s * vkq;
+                    rotated[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    // selection sort of columns by eigen value
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            if (matrix[order[j] * n + order[j]] > matrix[order[i] * n + order[i]]) {
+                std::swap(order[i], order[j]);
+            }
+        }
+    }
+    values.resize(n);
+    vectors.resize(n * n);
+    for (size_t i = 0; i < n; ++i) {
+        values[i] = matrix[order[i] * n + order[i]];
+        for (size_t k = 0; k < n; ++k) {
+            vectors[k * n + i] = rotated[k * n + order[i]];
+        }
+    }
+}
+
+PcaReducer::PcaReducer(PcaState* state)
+    : mState(state) {
 }
 
 PcaReducer::~PcaReducer() {
@@ -220,6 +369,10 @@ void PcaReducer::Reduce(
     if (mols.size() == 0 || mols.size() == 1) {
         return;
     }
+    if (mState) {
+        ReduceIncremental(mols, fingerprintSelector, simCoeffSelector, tbbCtx);
+        return;
+    }
 #ifdef LOG_PCA_DATA    
 int fileNumber = FileNumber("m", ".txt");
 #endif
@@ -315,58 +468,31 @@ measureStage.ReportAndReset("LogOutput");
 
     // compute covariance matrix, we can use the fact that it is symetric (paralel)
     double *covarianceMatrix = new double[coordinatesDimension * coordinatesDimension];
-    CalculateCovarianceMatrix calCovMatrix(
-        coordinates, covarianceMatrix, coordinatesDimension, objectsCount);
     if (!Cancelled(tbbCtx)) {
-        tbb::parallel_for(
-            tbb::blocked_range2d<size_t, size_t>(0, coordinatesDimension, 0, coordinatesDimension),
-            calCovMatrix, tbb::auto_partitioner(), tbbCtx);
+        CalculateCovariance(coordinates, objectsCount, coordinatesDimension,
+            covarianceMatrix, tbbCtx);
         measureStage.ReportAndReset("CalculateCovarianceMatrix");
     }    
 
     // now we need 2 most significant eigen vectors
     double* eigenFirst = new double[coordinatesDimension];
     double* eigenSecond = new double[coordinatesDimension];
-    double* tempVector = new double[coordinatesDimension];
-    // set vector to ones
-    for (int i = 0; i < coordinatesDimension; ++i) {
-        eigenFirst[i] = eigenSecond[i] = 1;
-    }
     
     // calculate eigens ..     
     if (!Cancelled(tbbCtx)) {
-        int iter = 0;
-        // start with first eigen vector
-        do {
-            ++iter;
-                     
-            // multiply vector with matrix and store result into tempVector
-            Multiply(eigenFirst, tempVector, covarianceMatrix, coordinatesDimension);
-            // move data from tempVector into eigenFirst
-            std::swap(eigenFirst, tempVector);
-            // normalize before caltulating error
-            Normalize(eigenFirst, coordinatesDimension); 
-            Normalize(tempVector, coordinatesDimension); 
-        } 
-        while ( CalculateError(eigenFirst, tempVector, coordinatesDimension) > MaxError() );
-        measureStage.ReportAndReset("CalculateFirstEigenVector");    
-        // eigenFirst is already normalized
-    }     
-    
-    if (!Cancelled(tbbCtx)) {
-        // now we need second eigen vector, eigen vectors are ortogonal    
-        do {
-            // multiply vector with matrix and store result into tempVector
-            Multiply(eigenSecond, tempVector, covarianceMatrix, coordinatesDimension);
-            // make eigenSecond ortogonal to eigenFirst
-            Orthogonalized(eigenFirst, tempVector, eigenSecond, coordinatesDimension);
-            // normalize before caltulating error
-            Normalize(eigenSecond, coordinatesDimension); 
-            Normalize(tempVector, coordinatesDimension);             
-        } 
-        while ( CalculateError(eigenSecond, tempVector, coordinatesDimension) > MaxError() );
-        measureStage.ReportAndReset("CalculateSecondEigenVector");
-        // eigenSecond is already normalized
+        EigenSolution solution;
+        FindEigenVectors(covarianceMatrix, coordinatesDimension,
+            eigenFirst, eigenSecond, solution, tbbCtx);
+#if PCAREDUCER_REPORTING == 1
+        std::ostringstream stream;
+        stream << "PcaReducer: eigen vectors after " << solution.iterations <<
+            " iterations, residuals " << solution.residuals[0] << ", " <<
+            solution.residuals[1] << " (eigen values " <<
+            solution.values[0] << ", " << solution.values[1] << ").";
+        SynchCout(stream.str());
+#endif
+        measureStage.ReportAndReset("CalculateEigenVectors");
+        // both are normalized
     }
 #ifdef LOG_PCA_DATA     
 {
@@ -434,8 +560,379 @@ measureStage.ReportAndReset("LogOutput");
     eigenFirst = 0;
     delete[] eigenSecond;
     eigenSecond = 0;
-    delete[] tempVector;
-    tempVector = 0;    
+}
+
+const double PcaReducer::EIGEN_TOLERANCE = 0.00001;
+
+void PcaReducer::FindEigenVectors(const double* matrix, size_t dimension,
+    double* eigenFirst, double* eigenSecond, EigenSolution& solution,
+    tbb::task_group_context& tbbCtx, std::vector<double>* startBasis)
+{
+    size_t blockSize = std::min(dimension, (size_t) EIGEN_BLOCK_SIZE);
+    // vectors are stored one after another
+    std::vector<double> basis(blockSize * dimension);
+    std::vector<double> product(blockSize * dimension);
+    std::vector<double> projection(blockSize * blockSize);
+    std::vector<double> ritzValues;
+    std::vector<double> ritzVectors;
+
+    if (startBasis && startBasis->size() == basis.size()) {
+        basis = *startBasis;
+    } else {
+        // deterministic start, so that the same input gives the same layout
+        unsigned int seed = 12345;
+        for (size_t i = 0; i < basis.size(); ++i) {
+            seed = seed * 1103515245 + 12345;
+            basis[i] = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+        }
+    }
+    Orthonormalize(&basis[0], blockSize, dimension);
+
+    solution.values[0] = solution.values[1] = 0;
+    solution.residuals[0] = solution.residuals[1] = 0;
+    solution.iterations = 0;
+    while (solution.iterations < MAX_EIGEN_ITERATIONS &&
+            !tbbCtx.is_group_execution_cancelled()) {
+        ++solution.iterations;
+
+        // product = matrix * basis (parallel)
+        MultiplyBlock multiplyBlock(matrix, &basis[0], &product[0],
+            dimension, blockSize);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, dimension),
+            multiplyBlock, tbb::auto_partitioner(), tbbCtx);
+
+        // Rayleigh-Ritz: eigens of basis^T * matrix * basis
+        for (size_t i = 0; i < blockSize; ++i) {
+            for (size_t j = 0; j < blockSize; ++j) {
+                projection[i * blockSize + j] = MultiplyScalar(
+                    &basis[i * dimension], &product[j * dimension], dimension);
+            }
+        }
+        JacobiEigen(projection, blockSize, ritzValues, ritzVectors);
+
+        // Ritz vectors into eigens, residual from product = matrix * basis
+        double* eigens[2] = { eigenFirst, eigenSecond };
+        for (size_t k = 0; k < 2; ++k) {
+            size_t column = std::min(k, blockSize - 1);
+            double residual = 0;
+            for (size_t i = 0; i < dimension; ++i) {
+                double vector = 0;
+                double image = 0;
+                for (size_t j = 0; j < blockSize; ++j) {
+                    double weight = ritzVectors[j * blockSize + column];
+                    vector += basis[j * dimension + i] * weight;
+                    image += product[j * dimension + i] * weight;
+                }
+                eigens[k][i] = vector;
+                residual += std::pow(image - ritzValues[column] * vector, 2);
+            }
+            solution.values[k] = ritzValues[column];
+            solution.residuals[k] = std::sqrt(residual);
+        }
+
+        double limit = EIGEN_TOLERANCE * std::max(solution.values[0], DBL_MIN);
+        if (solution.residuals[0] <= limit && solution.residuals[1] <= limit) {
+            break;
+        }
+
+        // next basis spans matrix * basis, rotated to the Ritz vectors
+        for (size_t i = 0; i < dimension; ++i) {
+            for (size_t k = 0; k < blockSize; ++k) {
+                double value = 0;
+                for (size_t j = 0; j < blockSize; ++j) {
+                    value += product[j * dimension + i] *
+                        ritzVectors[j * blockSize + k];
+                }
+                basis[k * dimension + i] = value;
+            }
+        }
+        Orthonormalize(&basis[0], blockSize, dimension);
+    }
+
+    if (startBasis) {
+        startBasis->swap(basis);
+    }
+}
+
+void PcaReducer::CalculateCovariance(const double* coordinates,
+    size_t objectsCount, size_t dimension, double* covariance,
+    tbb::task_group_context& tbbCtx)
+{
+    // the matrix is symetric, SumProducts fills only the lower triangle
+    SumProducts sumProducts(coordinates, dimension);
+    tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, objectsCount),
+        sumProducts, tbb::auto_partitioner(), tbbCtx);
+    for (size_t r = 0; r < dimension; ++r) {
+        for (size_t c = 0; c <= r; ++c) {
+            covariance[r + (c * dimension)] =
+                covariance[c + (r * dimension)] =
+                    sumProducts.mProducts[r * dimension + c] /
+                        (objectsCount - 1);
+        }
+    }
+}
+
+void PcaReducer::PowerIteration(const double* matrix, size_t dimension,
+    double* eigenFirst, double* eigenSecond, EigenSolution& solution)
+{
+    std::vector<double> temp(dimension);
+    double* tempVector = &temp[0];
+    // set vector to ones
+    for (size_t i = 0; i < dimension; ++i) {
+        eigenFirst[i] = eigenSecond[i] = 1;
+    }
+
+    solution.iterations = 0;
+    int iter = 0;
+    // start with first eigen vector
+    do {
+        ++iter;
+        // multiply vector with matrix and store result into tempVector
+        Multiply(eigenFirst, tempVector, matrix, dimension);
+        // move data from tempVector into eigenFirst
+        std::swap(eigenFirst, tempVector);
+        // normalize before caltulating error
+        Normalize(eigenFirst, dimension);
+        Normalize(tempVector, dimension);
+    }
+    while (CalculateError(eigenFirst, tempVector, dimension) > MaxError() &&
+        iter < MAX_EIGEN_ITERATIONS);
+    if (iter % 2 == 1) {
+        // the last result is in the buffer of temp
+        std::copy(eigenFirst, eigenFirst + dimension, tempVector);
+        std::swap(eigenFirst, tempVector);
+    }
+    solution.iterations += iter;
+
+    iter = 0;
+    // now we need second eigen vector, eigen vectors are ortogonal
+    do {
+        ++iter;
+        // multiply vector with matrix and store result into tempVector
+        Multiply(eigenSecond, tempVector, matrix, dimension);
+        // make eigenSecond ortogonal to eigenFirst
+        Orthogonalized(eigenFirst, tempVector, eigenSecond, dimension);
+        // normalize before caltulating error
+        Normalize(eigenSecond, dimension);
+        Normalize(tempVector, dimension);
+    }
+    while (CalculateError(eigenSecond, tempVector, dimension) > MaxError() &&
+        iter < MAX_EIGEN_ITERATIONS);
+    solution.iterations += iter;
+
+    double* eigens[2] = { eigenFirst, eigenSecond };
+    for (int k = 0; k < 2; ++k) {
+        Multiply(eigens[k], tempVector, matrix, dimension);
+        solution.values[k] = MultiplyScalar(eigens[k], tempVector, dimension);
+        double residual = 0;
+        for (size_t i = 0; i < dimension; ++i) {
+            residual += std::pow(
+                tempVector[i] - solution.values[k] * eigens[k][i], 2);
+        }
+        solution.residuals[k] = std::sqrt(residual);
+    }
+}
+
+void PcaReducer::ReduceIncremental(
+        MolPtrVector &mols,
+        FingerprintSelector fingerprintSelector,
+        SimCoeffSelector simCoeffSelector,
+        tbb::task_group_context &tbbCtx) {
+
+    MeasureStage measureStage;
+    PcaState &state = *mState;
+    if (state.fingerprintSelector != fingerprintSelector) {
+        state.clear();
+        state.fingerprintSelector = fingerprintSelector;
+    }
+    ++state.generation;
+
+    // find entries of mols, new molecules get an empty one
+    std::vector<PcaState::Entry *> molEntries(mols.size(), NULL);
+    MolPtrVector added;
+    std::vector<PcaState::Entry *> addedEntries;
+    for (size_t i = 0; i < mols.size(); ++i) {
+        std::pair<PcaState::EntryMap::iterator, bool> inserted =
+            state.entries.insert(
+                std::make_pair(mols[i]->smile, PcaState::Entry()));
+        PcaState::Entry &entry = inserted.first->second;
+        if (inserted.second) {
+            added.push_back(mols[i]);
+            addedEntries.push_back(&entry);
+        }
+        entry.generation = state.generation;
+        molEntries[i] = &entry;
+    }
+
+    // entries of molecules that are gone
+    std::vector<PcaState::EntryMap::iterator> removed;
+    std::vector<double> removedCoordinates;
+    PcaState::EntryMap::iterator itEntry;
+    for (itEntry = state.entries.begin(); itEntry != state.entries.end();
+            ++itEntry) {
+        if (itEntry->second.generation != state.generation) {
+            removed.push_back(itEntry);
+            if (itEntry->second.valid) {
+                removedCoordinates.insert(removedCoordinates.end(),
+                    itEntry->second.coordinates.begin(),
+                    itEntry->second.coordinates.end());
+            }
+        }
+    }
+    measureStage.ReportAndReset("FindChanges");
+
+    // coordinates of added molecules
+    std::vector<double> addedCoordinates;
+    if (!added.empty() && !Cancelled(tbbCtx)) {
+        SimCoefCalculator calc(simCoeffSelector, fingerprintSelector);
+        std::vector<Fingerprint *> fingerprints(added.size(), NULL);
+        CalculateFingerprints calculateFingerprints(calc, added, fingerprints);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, added.size()),
+            calculateFingerprints, tbb::auto_partitioner(), tbbCtx);
+
+        std::vector<Fingerprint *> validFingerprints;
+        std::vector<PcaState::Entry *> validEntries;
+        for (size_t i = 0; i < added.size(); ++i) {
+            if (fingerprints[i]) {
+                validFingerprints.push_back(fingerprints[i]);
+                validEntries.push_back(addedEntries[i]);
+            }
+        }
+        if (!validFingerprints.empty() && state.dimension == 0) {
+            state.dimension = validFingerprints[0]->getNumBits() / 32;
+            state.sum.assign(state.dimension, 0.0);
+            state.products.assign(state.dimension * state.dimension, 0.0);
+        }
+
+        size_t dimension = state.dimension;
+        addedCoordinates.resize(validFingerprints.size() * dimension);
+        if (!addedCoordinates.empty() && !Cancelled(tbbCtx)) {
+            CalculateCoordinatesSum calculateCoordinatesSum(
+                validFingerprints, &addedCoordinates[0], dimension);
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, validFingerprints.size()),
+                calculateCoordinatesSum, tbb::auto_partitioner(), tbbCtx);
+        }
+        for (size_t i = 0; i < validEntries.size(); ++i) {
+            PcaState::Entry &entry = *validEntries[i];
+            entry.coordinates.assign(
+                addedCoordinates.begin() + (i * dimension),
+                addedCoordinates.begin() + ((i + 1) * dimension));
+            entry.valid = true;
+        }
+
+        for (size_t i = 0; i < fingerprints.size(); ++i) {
+            delete fingerprints[i];
+        }
+        measureStage.ReportAndReset("CalculateAddedCoordinates");
+    }
+
+    // update sums by added and removed molecules (parallel over objects),
+    // bit counts and their products are exact in double
+    size_t dimension = state.dimension;
+    if (dimension > 0 && !Cancelled(tbbCtx)) {
+        size_t addedCount = addedCoordinates.size() / dimension;
+        size_t removedCount = removedCoordinates.size() / dimension;
+        if (addedCount > 0) {
+            SumProducts addProducts(&addedCoordinates[0], dimension);
+            tbb::parallel_reduce(tbb::blocked_range<size_t>(0, addedCount),
+                addProducts, tbb::auto_partitioner(), tbbCtx);
+            for (size_t i = 0; i < state.products.size(); ++i) {
+                state.products[i] += addProducts.mProducts[i];
+            }
+        }
+        if (removedCount > 0) {
+            SumProducts subtractProducts(&removedCoordinates[0], dimension);
+            tbb::parallel_reduce(tbb::blocked_range<size_t>(0, removedCount),
+                subtractProducts, tbb::auto_partitioner(), tbbCtx);
+            for (size_t i = 0; i < state.products.size(); ++i) {
+                state.products[i] -= subtractProducts.mProducts[i];
+            }
+        }
+
+        for (size_t i = 0; i < addedCoordinates.size(); ++i) {
+            state.sum[i % dimension] += addedCoordinates[i];
+        }
+        for (size_t i = 0; i < removedCoordinates.size(); ++i) {
+            state.sum[i % dimension] -= removedCoordinates[i];
+        }
+        state.count += addedCount;
+        state.count -= removedCount;
+        measureStage.ReportAndReset("UpdateStatistics");
+    }
+    for (size_t i = 0; i < removed.size(); ++i) {
+        state.entries.erase(removed[i]);
+    }
+
+    if (Cancelled(tbbCtx)) {
+        // sums may miss some of the changes
+        state.clear();
+        return;
+    }
+    if (state.count < 2) {
+        return;
+    }
+
+    // covariance from the sums: (products - n * mean * mean^T) / (n - 1)
+    double count = (double) state.count;
+    std::vector<double> mean(dimension);
+    for (size_t j = 0; j < dimension; ++j) {
+        mean[j] = state.sum[j] / count;
+    }
+    std::vector<double> covarianceMatrix(dimension * dimension);
+    for (size_t r = 0; r < dimension; ++r) {
+        for (size_t c = 0; c <= r; ++c) {
+            double value = (state.products[r * dimension + c] -
+                count * mean[r] * mean[c]) / (count - 1);
+            covarianceMatrix[r * dimension + c] =
+                covarianceMatrix[c * dimension + r] = value;
+        }
+    }
+    measureStage.ReportAndReset("CalculateCovarianceMatrix");
+
+    // start from the eigen vectors of the last reduction
+    std::vector<double> eigenFirst(dimension);
+    std::vector<double> eigenSecond(dimension);
+    EigenSolution solution;
+    FindEigenVectors(&covarianceMatrix[0], dimension,
+        &eigenFirst[0], &eigenSecond[0], solution, tbbCtx, &state.basis);
+    if (Cancelled(tbbCtx)) {
+        return;
+    }
+#if PCAREDUCER_REPORTING == 1
+    std::ostringstream stream;
+    stream << "PcaReducer: " << added.size() << " added, " <<
+        removed.size() << " removed, eigen vectors after " <<
+        solution.iterations << " iterations, residuals " <<
+        solution.residuals[0] << ", " << solution.residuals[1] << ".";
+    SynchCout(stream.str());
+#endif
+    measureStage.ReportAndReset("CalculateEigenVectors");
+
+    // keep the orientation of the axes, so that the layout does not flip
+    if (state.eigenFirst.size() == dimension) {
+        if (MultiplyScalar(&eigenFirst[0], &state.eigenFirst[0], dimension) < 0) {
+            for (size_t j = 0; j < dimension; ++j) {
+                eigenFirst[j] = -eigenFirst[j];
+            }
+        }
+        if (MultiplyScalar(&eigenSecond[0], &state.eigenSecond[0], dimension) < 0) {
+            for (size_t j = 0; j < dimension; ++j) {
+                eigenSecond[j] = -eigenSecond[j];
+            }
+        }
+    }
+    state.eigenFirst = eigenFirst;
+    state.eigenSecond = eigenSecond;
+
+    ProjectEntries projectEntries(molEntries, &mean[0],
+        &eigenFirst[0], &eigenSecond[0], mols, dimension);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, mols.size()),
+        projectEntries, tbb::auto_partitioner(), tbbCtx);
+    measureStage.ReportAndReset("CalculateCoordinates");
 }
 
 bool PcaReducer::Cancelled(tbb::task_group_context &ctx)
@@ -494,34 +991,29 @@ PcaReducer::CalculateCoordinatesSum::CalculateCoordinatesSum(
 void PcaReducer::CalculateCoordinatesSum::operator()(
         const tbb::blocked_range<size_t> &param) const 
 {
+    // fingerprint words, reused for all fingerprints in the range
+    std::vector<BitBlock> blocks;
     for (size_t f = param.begin(); f != param.end(); ++f) 
     {
        // we calculate coordinates for i-th FP
        Fingerprint* fp = mFingerprints[f];        
+       blocks.resize(fp->dp_bits->num_blocks());
+       boost::to_block_range(*fp->dp_bits, blocks.begin());
        // calculate size of single interpret unit
        // also we want round result up 
-       int unitSizeMax = (int)
+       size_t unitSizeMax = (size_t)
          ( ( (double)fp->getNumBits() / mOutDimension) + 0.5 );
        // check that unit size is greater than zero
        assert(unitSizeMax > 0);        
-       // for each unit in FP
-       size_t coordStart = f * mOutDimension; // save start position for coordinates
-       size_t coordMax = (f + 1) * mOutDimension;
-       // used to determine size of interpret unit
-       size_t unitSize = 0;
-       // bite position
-       int bitePos = 0;
-       int biteMax = fp->getNumBits();
-       for (size_t c = coordStart; c < coordMax; ++c) 
+       // each unit is a bit range, count its bits by whole words
+       size_t bitePos = 0;
+       size_t biteMax = fp->getNumBits();
+       double *coordinates = mCoordinates + (f * mOutDimension);
+       for (size_t c = 0; c < mOutDimension; ++c) 
        {
-           mCoordinates[c] = 0;
-           for (size_t i = 0; i < unitSizeMax && bitePos < biteMax; ++i) 
-           {
-               // store bite value
-               mCoordinates[c] += (*fp->dp_bits)[bitePos];
-               // increase bite
-               ++bitePos;
-           }
+           size_t unitEnd = std::min(bitePos + unitSizeMax, biteMax);
+           coordinates[c] = CountBits(&blocks[0], bitePos, unitEnd);
+           bitePos = unitEnd;
        }       
     }
 }
@@ -543,36 +1035,84 @@ void PcaReducer::CenterCoordinates::operator()(
     }
 }
 
-PcaReducer::CalculateCovarianceMatrix::CalculateCovarianceMatrix(
-        const double *coordinates, double *matrix, size_t dimension, size_t objectCount)
-        : mCoordinates(coordinates), mMatrix(matrix), mDimension(dimension), 
-          mObjectCount(objectCount)
+PcaReducer::SumProducts::SumProducts(
+        const double *coordinates, size_t dimension)
+        : mProducts(dimension * dimension, 0.0), mCoordinates(coordinates),
+          mDimension(dimension)
 { }
 
-void PcaReducer::CalculateCovarianceMatrix::operator()(
-        const tbb::blocked_range2d<size_t, size_t> &param) const
+PcaReducer::SumProducts::SumProducts(SumProducts &toSplit, tbb::split)
+        : mProducts(toSplit.mDimension * toSplit.mDimension, 0.0),
+          mCoordinates(toSplit.mCoordinates), mDimension(toSplit.mDimension)
+{ }
+
+void PcaReducer::SumProducts::operator()(
+        const tbb::blocked_range<size_t> &param)
 {
-//    int coordinatesSize = mObjectCount * mDimension;
-    for (size_t r = param.rows().begin(); r != param.rows().end(); ++r) {
-        for (size_t c = param.cols().begin(); c != param.cols().end(); ++c) {
-            // we should caldulate for i,j 
-            // use symetricity, calculate only for i >= j
-            if (r < c) break;
-            // otherwise start computing ...
-            double result = 0;
-            // i jump on begin of data
-            size_t pos = 0;
-            for (size_t i = 0; i < mObjectCount; ++i, pos += mDimension) {
-                // i + r and i + c point to r,c-th value of i-th object
-                result += mCoordinates[pos + r] * mCoordinates[pos + c];
+    double *products = &mProducts[0];
+    for (size_t i = param.begin(); i != param.end(); ++i) {
+        const double *object = mCoordinates + (i * mDimension);
+        // add object * object^T into the lower triangle, row by row, so the
+        // inner loop runs over contiguous memory
+        for (size_t r = 0; r < mDimension; ++r) {
+            const double value = object[r];
+            double *row = products + (r * mDimension);
+            for (size_t c = 0; c <= r; ++c) {
+                row[c] += value * object[c];
             }
-            // divide result with mObjectCount
-            result /= (mObjectCount - 1);
-            // use matrix symetricity and store result
-            mMatrix[r + (c * mDimension)] = 
-                    mMatrix[c + (r * mDimension)] = 
-                        result;
-        }   
+        }
+    }
+}
+
+void PcaReducer::SumProducts::join(const SumProducts &toJoin)
+{
+    for (size_t i = 0; i < mProducts.size(); ++i) {
+        mProducts[i] += toJoin.mProducts[i];
+    }
+}
+
+PcaReducer::MultiplyBlock::MultiplyBlock(const double *matrix,
+        const double *block, double *result, size_t dimension, size_t blockSize)
+        : mMatrix(matrix), mBlock(block), mResult(result),
+          mDimension(dimension), mBlockSize(blockSize)
+{ }
+
+void PcaReducer::MultiplyBlock::operator()(
+        const tbb::blocked_range<size_t> &param) const
+{
+    for (size_t r = param.begin(); r != param.end(); ++r) {
+        const double *row = mMatrix + (r * mDimension);
+        for (size_t v = 0; v < mBlockSize; ++v) {
+            mResult[r + (v * mDimension)] =
+                MultiplyScalar(row, mBlock + (v * mDimension), mDimension);
+        }
+    }
+}
+
+PcaReducer::ProjectEntries::ProjectEntries(
+        const std::vector<PcaState::Entry*> &entries, const double *mean,
+        const double *eigenFirst, const double *eigenSecond,
+        MolPtrVector &mols, size_t dimension)
+        : mEntries(entries), mMean(mean), mEigenFirst(eigenFirst),
+          mEigenSecond(eigenSecond), mMols(mols), mDimension(dimension)
+{ }
+
+void PcaReducer::ProjectEntries::operator()(
+        const tbb::blocked_range<size_t> &param) const
+{
+    for (size_t f = param.begin(); f != param.end(); ++f) {
+        mMols[f]->posX = 0;
+        mMols[f]->posY = 0;
+        if (!mEntries[f]->valid) {
+            continue; // no fingerprint, leave it in the mean
+        }
+        const std::vector<unsigned short> &coordinates =
+            mEntries[f]->coordinates;
+        for (size_t i = 0; i < mDimension; ++i) {
+            double centered = coordinates[i] - mMean[i];
+            mMols[f]->posX += centered * mEigenFirst[i];
+            mMols[f]->posY += centered * mEigenSecond[i];
+        }
     }
 }
 
@@ -23,7 +23,6 @@
 
 #include <tbb/task.h>
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_reduce.h>
 
 #include <GraphMol/RDKitBase.h>
@@ -33,6 +32,7 @@
 #include "fingerprint_selectors.h"
 #include "simcoeff_selectors.h"
 #include "DimensionReducer.h"
+#include "PcaState.h"
 #include "chem/simCoefStrategy/SimCoefStrategy.h"
 #include "chem/SimCoefCalculator.hpp"
 
@@ -43,15 +43,95 @@
 class PcaReducer : public DimensionReducer
 {
 public:
-    PcaReducer();
+    /**
+     * Base ctor.
+     * @param PcaState* state Statistics of the previous reductions of the
+     * job, updated by Reduce. NULL if every reduction starts from scratch.
+     */
+    PcaReducer(PcaState* state = NULL);
     ~PcaReducer();
     virtual void Reduce(
         MolPtrVector& mols,
         FingerprintSelector fingerprintSelector,
         SimCoeffSelector simCoeffSelector,
         tbb::task_group_context& tbbCtx);
+    /**
+     * Outcome of the search for the two largest eigen vectors.
+     */
+    struct EigenSolution
+    {
+        /**
+         * Eigen values of the first and second vector.
+         */
+        double values[2];
+        /**
+         * Residuals |Mv - value * v| of the first and second vector.
+         */
+        double residuals[2];
+        /**
+         * Number of iterations used.
+         */
+        int iterations;
+    };
+    /**
+     * Finds two largest eigen vectors of symmetric positive semidefinite
+     * matrix by block subspace iteration with Rayleigh-Ritz projection.
+     * A block of EIGEN_BLOCK_SIZE vectors converges with the ratio of
+     * the (EIGEN_BLOCK_SIZE + 1)-th and the second eigen value, so close
+     * first two eigen values do not slow it down. Stops when both
+     * residuals are below EIGEN_TOLERANCE relative to the first eigen
+     * value, or after MAX_EIGEN_ITERATIONS.
+     * @param[in] const double* matrix Square matrix stored as rows.
+     * @param[in] size_t dimension Size of matrix.
+     * @param[out] double* eigenFirst Largest eigen vector (normalized).
+     * @param[out] double* eigenSecond Second largest eigen vector (normalized).
+     * @param[out] EigenSolution& solution Eigen values and residuals.
+     * @param[in] tbb::task_group_context& tbbCtx Context for cancellation.
+     * @param[in,out] std::vector<double>* basis If it holds a block of the
+     * right size, the iteration starts from it. The final block is stored
+     * into it.
+     */
+    static void FindEigenVectors(const double* matrix, size_t dimension,
+        double* eigenFirst, double* eigenSecond, EigenSolution& solution,
+        tbb::task_group_context& tbbCtx, std::vector<double>* basis = NULL);
+    /**
+     * Power iteration used by Reduce before FindEigenVectors, kept
+     * as a reference for molpher-bench. Limited by MAX_EIGEN_ITERATIONS
+     * per vector.
+     */
+    static void PowerIteration(const double* matrix, size_t dimension,
+        double* eigenFirst, double* eigenSecond, EigenSolution& solution);
+    /**
+     * Covariance matrix of centered coordinates, as computed by Reduce
+     * before FindEigenVectors.
+     * @param[in] const double* coordinates Centered coordinates stored as rows.
+     * @param[in] size_t objectsCount Number of rows, at least 2.
+     * @param[in] size_t dimension Size of one row.
+     * @param[out] double* covariance Square matrix of dimension.
+     * @param[in] tbb::task_group_context& tbbCtx Context for cancellation.
+     */
+    static void CalculateCovariance(const double* coordinates,
+        size_t objectsCount, size_t dimension, double* covariance,
+        tbb::task_group_context& tbbCtx);
+
+    static const int EIGEN_BLOCK_SIZE = 8;
+    static const int MAX_EIGEN_ITERATIONS = 300;
+    static const double EIGEN_TOLERANCE;
 protected:   
     bool Cancelled(tbb::task_group_context &ctx);    
+    /**
+     * Reduce with mState, only molecules added or removed since the last
+     * reduction are processed before the eigen vectors.
+     */
+    void ReduceIncremental(
+        MolPtrVector& mols,
+        FingerprintSelector fingerprintSelector,
+        SimCoeffSelector simCoeffSelector,
+        tbb::task_group_context& tbbCtx);
+    /**
+     * Statistics of the previous reductions or NULL.
+     */
+    PcaState* mState;
 protected:
     /**
      * Class is used in cooperation with tbb. Class compute
@@ -175,43 +255,139 @@ protected:
         size_t mDimension;
     };
     /**
-     * Class calculate a covarinace matrix for given coordinates.
-     * Class is desing to be used with tbb.
+     * Sums outer products of object coordinates (X^T * X), only the lower
+     * triangle. Objects are split among tasks, each task adds whole rows
+     * into its own matrix with a contiguous inner loop, so the coordinates
+     * are read once. Class is desing to be used with tbb::parallel_reduce.
      */
-    class CalculateCovarianceMatrix
+    class SumProducts
     {
     public:
         /**
          * Base ctor.
          * @param const double* coordinates Array with coordinates of objects.
-         * @param double* matrix Covariance matrix.
          * @param size_t dimension Object dimension (coordinates per object)
-         * @param size_t objectCount Number of objects.
          */
-        CalculateCovarianceMatrix(
-                const double* coordinates, double* matrix, 
-                size_t dimension, size_t objectCount);
+        SumProducts(const double* coordinates, size_t dimension);
         /**
-         * Operator for tbb.
-         */         
-        void operator()(const tbb::blocked_range2d<size_t, size_t>& param) const;
+         * Splitting ctor for tbb.
+         */
+        SumProducts(SumProducts& toSplit, tbb::split);
+        /**
+         * Operator for tbb, range over objects.
+         */
+        void operator()(const tbb::blocked_range<size_t>& param);
+        /**
+         * Join for tbb.
+         */
+        void join(const SumProducts& toJoin);
+        /**
+         * Sums of products, dimension x dimension stored as rows.
+         */
+        std::vector<double> mProducts;
     private:
         /**
          * Coordinates storage.
          */
         const double* mCoordinates;
         /**
-         * Covariance matrix.
+         * Data dimension.
+         */
+        size_t mDimension;
+    };
+    /**
+     * Multiply square matrix with a block of vectors, vectors of the
+     * block and the result are stored one after another. Class is
+     * desinged to be used with tbb, ranges are rows of the matrix.
+     */
+    class MultiplyBlock
+    {
+    public:
+        /**
+         * Base ctor.
+         * @param const double* matrix Square matrix stored as rows.
+         * @param const double* block Vectors to multiply.
+         * @param double* result Product, must not overlap block.
+         * @param size_t dimension Size of matrix.
+         * @param size_t blockSize Number of vectors.
          */
-        double* mMatrix;
+        MultiplyBlock(const double* matrix, const double* block,
+                double* result, size_t dimension, size_t blockSize);
         /**
-         * Data dimension.
+         * Operator for tbb.
+         */
+        void operator()(const tbb::blocked_range<size_t>& param) const;
+    private:
+        /**
+         * Matrix storage.
+         */
+        const double* mMatrix;
+        /**
+         * Vectors storage.
+         */
+        const double* mBlock;
+        /**
+         * Result storage.
+         */
+        double* mResult;
+        /**
+         * Size of matrix.
          */
         size_t mDimension;
         /**
-         * Data count.
+         * Number of vectors.
+         */
+        size_t mBlockSize;
+    };
+    /**
+     * Transform coordinates kept in PcaState with given vectors and store
+     * result into molecule storage. Class is desinged to be used with tbb.
+     */
+    class ProjectEntries
+    {
+    public:
+        /**
+         * Base ctor.
+         * @param const std::vector<PcaState::Entry*>& entries Entries of mols.
+         * @param const double* mean Mean of coordinates.
+         * @param const double* eigenFirst Largets eigen vector.
+         * @param const double* eigenSecond Second largest eigen vector.
+         * @param mols MolPtrVector& Acces to molecule storage.
+         * @param dimension  Data dimension (coordinates per object)
+         */
+        ProjectEntries(const std::vector<PcaState::Entry*>& entries,
+                const double* mean,
+                const double* eigenFirst, const double* eigenSecond,
+                MolPtrVector& mols, size_t dimension);
+        /**
+         * Operator for tbb.
+         */
+        void operator()(const tbb::blocked_range<size_t>& param) const;
+    private:
+        /**
+         * Entries of molecules.
+         */
+        const std::vector<PcaState::Entry*>& mEntries;
+        /**
+         * Mean of coordinates.
+         */
+        const double* mMean;
+        /**
+         * First eigen vector.
+         */
+        const double* mEigenFirst;
+        /**
+         * Second eigen vector.
+         */
+        const double* mEigenSecond;
+        /**
+         * Molecule storage.
+         */
+        MolPtrVector& mMols;
+        /**
+         * Coordinates dimension.
          */
-        size_t mObjectCount;
+        size_t mDimension;
     };
     /**
      * Transform coordinates with given vectors(eigenVectors) and
@@ -0,0 +1,90 @@
+/*
+ Copyright (c) 2012 Petr Škoda
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "fingerprint_selectors.h"
+
+/**
+ * Sufficient statistics of the PCA kept between the reductions of one job
+ * (see PcaReducer). The covariance is rebuilt from the sums, which only
+ * change by the molecules added or removed since the last reduction, and
+ * the eigen vectors start from the last ones.
+ */
+struct PcaState
+{
+    PcaState()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        fingerprintSelector = DEFAULT_FP;
+        dimension = 0;
+        generation = 0;
+        entries.clear();
+        count = 0;
+        sum.clear();
+        products.clear();
+        basis.clear();
+        eigenFirst.clear();
+        eigenSecond.clear();
+    }
+
+    /**
+     * Coordinates of a molecule (see PcaReducer::CalculateCoordinatesSum),
+     * they are bit counts of fingerprint parts.
+     */
+    struct Entry
+    {
+        Entry() :
+            generation(0),
+            valid(false)
+        {
+        }
+
+        std::vector<unsigned short> coordinates;
+        // last reduction that contained the molecule
+        unsigned int generation;
+        // false if the fingerprint could not be computed
+        bool valid;
+    };
+    typedef std::map<std::string, Entry> EntryMap;
+
+    // the statistics hold for these, they are rebuilt if they change
+    FingerprintSelector fingerprintSelector;
+    size_t dimension;
+
+    unsigned int generation;
+    EntryMap entries;
+    // number of valid entries
+    size_t count;
+    // sum of coordinates of valid entries
+    std::vector<double> sum;
+    // sum of outer products of the coordinates, dimension x dimension
+    std::vector<double> products;
+    // eigen vector block of the last reduction (see FindEigenVectors)
+    std::vector<double> basis;
+    // for orientation of the new eigen vectors
+    std::vector<double> eigenFirst;
+    std::vector<double> eigenSecond;
+};
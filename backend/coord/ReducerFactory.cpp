@@ -20,15 +20,16 @@
 #include "KamadaKawaiReducer.h"
 #include "PcaReducer.h"
 
-DimensionReducer *ReducerFactory::Create(DimRedSelector selector)
+DimensionReducer *ReducerFactory::Create(DimRedSelector selector,
+    PcaState *pcaState)
 {
     switch (selector) {
     case DR_KAMADAKAWAI:
         return new KamadaKawaiReducer();
     case DR_PCA:
-        return new PcaReducer();
+        return new PcaReducer(pcaState);
     default: // use PCA as default
-        return new PcaReducer();
+        return new PcaReducer(pcaState);
     }
 }
 
@@ -19,10 +19,15 @@
 
 #include "dimred_selectors.h"
 #include "DimensionReducer.h"
+#include "PcaState.h"
 
 class ReducerFactory
 {
 public:
-    static DimensionReducer *Create(DimRedSelector selector);
+    /**
+     * pcaState makes PCA incremental across reductions, see PcaReducer.
+     */
+    static DimensionReducer *Create(DimRedSelector selector,
+        PcaState *pcaState = NULL);
     static void Recycle(DimensionReducer *reducer);
 };
@@ -0,0 +1,89 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * Symmetric matrix with a zero diagonal (distances between molecules),
+ * only the part below the diagonal is kept, row by row in one array.
+ * Row i holds the elements (i, 0) .. (i, i - 1).
+ */
+class TriangularMatrix
+{
+public:
+    TriangularMatrix() :
+        mSize(0)
+    {
+    }
+
+    void Resize(size_t size)
+    {
+        mSize = size;
+        mData.assign(size > 1 ? (size * (size - 1)) / 2 : 0, 0.0f);
+    }
+
+    void Clear()
+    {
+        mSize = 0;
+        std::vector<float>().swap(mData);
+    }
+
+    size_t GetSize() const
+    {
+        return mSize;
+    }
+
+    size_t GetByteSize() const
+    {
+        return mData.size() * sizeof(float);
+    }
+
+    float Get(size_t i, size_t j) const
+    {
+        return (i == j) ? 0.0f : mData[Index(i, j)];
+    }
+
+    void Set(size_t i, size_t j, float value)
+    {
+        mData[Index(i, j)] = value;
+    }
+
+    float *GetRow(size_t i)
+    {
+        return &mData[(i * (i - 1)) / 2];
+    }
+
+    const float *GetRow(size_t i) const
+    {
+        return &mData[(i * (i - 1)) / 2];
+    }
+
+private:
+    static size_t Index(size_t i, size_t j)
+    {
+        if (i < j) {
+            std::swap(i, j);
+        }
+        return (i * (i - 1)) / 2 + j;
+    }
+
+    size_t mSize;
+    std::vector<float> mData;
+};
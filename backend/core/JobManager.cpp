@@ -459,6 +459,21 @@ bool JobManager::GetJobHistory(JobId jobId, IterIdx iterIdx, IterationSnapshot &
         GenerateFilename(mStorageDir, jobId, iterIdx), snp);
 }
 
+bool JobManager::GetMorphingStats(
+    JobId jobId, bool lastIteration, MorphingStats &stats)
+{
+    Lock lock(mJobManagerGuard);
+
+    JobGroup::JobMap::iterator it = mJobs.mJobMap.find(jobId);
+    if (it == mJobs.mJobMap.end()) {
+        return false;
+    }
+
+    stats = lastIteration ?
+        it->second.iterMorphingStats : it->second.jobMorphingStats;
+    return true;
+}
+
 bool JobManager::SetFingerprintSelector(
     JobId jobId, FingerprintSelector selector, std::string &password)
 {
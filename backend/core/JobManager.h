@@ -71,6 +71,7 @@ public:
     void ChangeJobOrder(JobId jobId, int queuePosDiff, std::string &password);
     bool ValidateJobPassword(JobId jobId, std::string &password);
     bool GetJobHistory(JobId jobId, IterIdx iterIdx, IterationSnapshot &snp);
+    bool GetMorphingStats(JobId jobId, bool lastIteration, MorphingStats &stats);
     bool SetFingerprintSelector(JobId jobId, FingerprintSelector selector, std::string &password);
     bool SetSimCoeffSelector(JobId jobId, SimCoeffSelector selector, std::string &password);
     bool SetDimRedSelector(JobId jobId, DimRedSelector selector, std::string &password);
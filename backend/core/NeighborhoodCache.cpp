@@ -0,0 +1,80 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+#include "NeighborhoodCache.h"
+
+NeighborhoodCache::NeighborhoodCache() :
+    mUseCounter(0)
+{
+}
+
+NeighborhoodCache::Entry &NeighborhoodCache::Acquire(
+    const NeighborhoodTask &task)
+{
+    std::string key = GetKey(task);
+    EntryMap::iterator it = mEntries.find(key);
+    if (it == mEntries.end()) {
+        if (mEntries.size() >= MAX_ENTRIES) {
+            EntryMap::iterator oldest = mEntries.begin();
+            for (EntryMap::iterator e = mEntries.begin();
+                    e != mEntries.end(); ++e) {
+                if (e->second.lastUse < oldest->second.lastUse) {
+                    oldest = e;
+                }
+            }
+            mEntries.erase(oldest);
+        }
+        it = mEntries.insert(std::make_pair(key, Entry())).first;
+    }
+    it->second.lastUse = ++mUseCounter;
+    return it->second;
+}
+
+size_t NeighborhoodCache::Entry::GetNeighborCount(
+    unsigned int attemptCount) const
+{
+    unsigned int prevAttempts = 0;
+    size_t prevNeighbors = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].first > attemptCount) {
+            // walks of a chunk are equal, so its neighbors are as well
+            return prevNeighbors + (chunks[i].second - prevNeighbors) *
+                (attemptCount - prevAttempts) /
+                (chunks[i].first - prevAttempts);
+        }
+        prevAttempts = chunks[i].first;
+        prevNeighbors = chunks[i].second;
+    }
+    return neighborhood.size();
+}
+
+std::string NeighborhoodCache::GetKey(const NeighborhoodTask &task)
+{
+    std::ostringstream key;
+    key << std::setprecision(std::numeric_limits<double>::digits10 + 2);
+    key << task.origin.smile << '|' << task.fingerprintSelector << '|' <<
+        task.simCoeffSelector << '|';
+    for (size_t i = 0; i < task.chemOperSelectors.size(); ++i) {
+        key << task.chemOperSelectors[i] << ',';
+    }
+    key << '|' << task.maxDepth << '|' << task.maxDistance;
+    return key.str();
+}
@@ -0,0 +1,83 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "NeighborhoodTask.h"
+
+/**
+ * Neighborhoods computed for recent tasks, before dimension reduction.
+ * Entries are keyed by the origin and the parameters that affect which
+ * neighbors are generated (selectors, depth and distance), the number of
+ * attempts is not part of the key so that a larger request can continue
+ * where a smaller one stopped, while a smaller request gets only the
+ * neighbors its number of attempts accounts for. Least recently used
+ * entries are dropped above MAX_ENTRIES. Used only by the neighborhood
+ * generator thread.
+ */
+class NeighborhoodCache
+{
+public:
+    struct Entry
+    {
+        Entry() :
+            attemptCount(0),
+            lastUse(0)
+        {
+        }
+
+        /**
+         * Number of leading neighbors a request of attemptCount walks
+         * gets. Neighbors of the chunk of walks the count ends in are
+         * taken in proportion to the attempts of the chunk it covers.
+         */
+        size_t GetNeighborCount(unsigned int attemptCount) const;
+
+        // walk attempts the entry covers
+        unsigned int attemptCount;
+        // unique morphs of the origin the walks start with
+        std::vector<MolpherMolecule> firstStep;
+        // in the order the chunks of walks found them
+        std::vector<MolpherMolecule> neighborhood;
+        // walk attempts done and size of neighborhood after each chunk
+        std::vector<std::pair<unsigned int, size_t> > chunks;
+        unsigned long lastUse;
+    };
+
+    NeighborhoodCache();
+
+    /**
+     * Entry of the task, an empty one is created if there is none.
+     * The reference is valid until the next call.
+     */
+    Entry &Acquire(const NeighborhoodTask &task);
+
+    static std::string GetKey(const NeighborhoodTask &task);
+
+    static const size_t MAX_ENTRIES = 16;
+
+private:
+    typedef std::map<std::string, Entry> EntryMap;
+
+    EntryMap mEntries;
+    unsigned long mUseCounter;
+};
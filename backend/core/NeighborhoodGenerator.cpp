@@ -15,11 +15,11 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cassert>
 #include <string>
 #include <sstream>
 #include <ctime>
 #include <vector>
+#include <algorithm>
 
 #include <tbb/task_scheduler_init.h>
 #include <tbb/tbb_exception.h>
@@ -30,6 +30,7 @@
 #include "auxiliary/SynchRand.h"
 #include "coord/ReducerFactory.h"
 #include "chem/morphing/Morphing.hpp"
+#include "chem/morphing/RandomWalk.hpp"
 #include "NeighborhoodTaskQueue.h"
 #include "NeighborhoodGenerator.h"
 
@@ -51,42 +52,45 @@ bool NeighborhoodGenerator::Cancelled()
     return mTbbCtx->is_group_execution_cancelled();
 }
 
-void NeighborhoodCollector(MolpherMolecule *morph, void *functor)
+void FirstStepCollector(MolpherMolecule *morph, void *functor)
 {
-    NeighborhoodGenerator::CollectMorph *collect =
-        (NeighborhoodGenerator::CollectMorph *) functor;
+    NeighborhoodGenerator::CollectFirstStep *collect =
+        (NeighborhoodGenerator::CollectFirstStep *) functor;
     (*collect)(*morph);
 }
 
-NeighborhoodGenerator::CollectMorph::CollectMorph() :
-    mMorphSet(false)
-{
-}
-
-void NeighborhoodGenerator::CollectMorph::operator()(const MolpherMolecule &morph)
+NeighborhoodGenerator::CollectFirstStep::CollectFirstStep(
+    MoleculeVector &firstStep
+    ) :
+    mFirstStep(firstStep)
 {
-    assert(mMorphSet == false);
-    mMorph = morph;
-    mMorphSet = true;
+    // the morphs already there come from an earlier batch
+    for (size_t i = 0; i < mFirstStep.size(); ++i) {
+        mDuplicateChecker.insert(
+            SmileSet::value_type(mFirstStep[i].smile, true));
+    }
 }
 
-bool NeighborhoodGenerator::CollectMorph::WithdrawMorph(MolpherMolecule &morph)
+void NeighborhoodGenerator::CollectFirstStep::operator()(MolpherMolecule &morph)
 {
-    if (mMorphSet) {
-        mMorphSet = false;
-        morph = mMorph;
-        return true;
-    } else {
-        return false;
+    // GenerateMorphs leaves some graph hash collisions to the SMILES check
+    SmileSet::accessor dummy;
+    if (mDuplicateChecker.insert(dummy, morph.smile)) {
+        mFirstStep.grow_by(1)->Swap(morph);
     }
 }
 
 NeighborhoodGenerator::GenerateNeighborhood::GenerateNeighborhood(
-    NeighborhoodTask &task, MoleculeVector &neighborhood,
-    tbb::task_group_context *tbbCtx
+    NeighborhoodTask &task, MoleculeVector &firstStep,
+    MoleculeVector &neighborhood, SmileSet &duplicateChecker,
+    size_t firstAttempt, size_t firstStart, tbb::task_group_context *tbbCtx
     ) :
     mTask(task),
+    mFirstStep(firstStep),
+    mFirstAttempt(firstAttempt),
+    mFirstStart(firstStart),
     mNeighborhood(neighborhood),
+    mDuplicateChecker(duplicateChecker),
     mTbbCtx(tbbCtx)
 {
 }
@@ -94,8 +98,6 @@ NeighborhoodGenerator::GenerateNeighborhood::GenerateNeighborhood(
 void NeighborhoodGenerator::GenerateNeighborhood::operator()(
     const tbb::blocked_range<size_t> &r) const
 {
-    CollectMorph collectMorph;
-    MolpherMolecule generator;
     MolpherMolecule neighbor;
 
     std::vector<ChemOperSelector> chemOperSelectors;
@@ -104,37 +106,80 @@ void NeighborhoodGenerator::GenerateNeighborhood::operator()(
         chemOperSelectors[i] = (ChemOperSelector) mTask.chemOperSelectors[i];
     }
 
-    std::vector<MolpherMolecule> emptyDecoys;
+    // distances are measured from the origin, it is the walk target
+    RandomWalk walk(
+        (FingerprintSelector) mTask.fingerprintSelector,
+        (SimCoeffSelector) mTask.simCoeffSelector,
+        chemOperSelectors,
+        mTask.origin);
 
     for (size_t attempt = r.begin(); attempt != r.end(); ++attempt) {
+        if (mFirstStep.empty() || mTbbCtx->is_group_execution_cancelled()) {
+            break;
+        }
 
+        // attempts spread over the first step before any morph repeats
+        const MolpherMolecule &start = mFirstStep[
+            (mFirstStart + attempt - mFirstAttempt) % mFirstStep.size()];
         int depth = SynchRand::GetRandomNumber(1, mTask.maxDepth);
-        generator = mTask.origin;
-
-        for (int d = 0; d < depth; ++d) {
-            while (!collectMorph.WithdrawMorph(neighbor)) {
-                GenerateMorphs(
-                    generator,
-                    1,
-                    (FingerprintSelector) mTask.fingerprintSelector,
-                    (SimCoeffSelector) mTask.simCoeffSelector,
-                    chemOperSelectors,
-                    mTask.origin,
-                    emptyDecoys,
-                    *mTbbCtx,
-                    &collectMorph,
-                    NeighborhoodCollector);
+
+        // a walk that gets stuck ends early instead of retrying forever
+        int steps = 1;
+        if (depth > 1 && walk.Reset(start)) {
+            while (steps < depth && walk.Step(neighbor)) {
+                ++steps;
             }
-            generator = neighbor;
+        }
+        if (steps == 1) {
+            neighbor = start;
         }
 
         bool withinNeighborhood = (neighbor.distToTarget <= mTask.maxDistance);
         if (withinNeighborhood) {
-            mNeighborhood.push_back(neighbor);
+            SmileSet::accessor dummy;
+            if (mDuplicateChecker.insert(dummy, neighbor.smile)) {
+                dummy.release();
+                mNeighborhood.grow_by(1)->Swap(neighbor);
+            }
         }
     }
 }
 
+void NeighborhoodGenerator::ReduceNeighborhood(NeighborhoodTask &task,
+    MoleculeVector &neighborhood, NeighborhoodTaskResult &result,
+    PcaState *pcaState)
+{
+    result.taskTimestamp = task.taskTimestamp;
+    result.origin = task.origin;
+    result.reducedNeighborhood.assign(neighborhood.begin(), neighborhood.end());
+    result.reducedContext = task.context;
+
+    DimensionReducer::MolPtrVector molsToReduce;
+    molsToReduce.reserve(result.reducedNeighborhood.size() +
+        result.reducedContext.size() + 1);
+    std::vector<MolpherMolecule>::iterator itNeighborhood;
+    for (itNeighborhood = result.reducedNeighborhood.begin();
+            itNeighborhood != result.reducedNeighborhood.end();
+            itNeighborhood++) {
+        molsToReduce.push_back(&(*itNeighborhood));
+    }
+    std::vector<MolpherMolecule>::iterator itContext;
+    for (itContext = result.reducedContext.begin();
+            itContext != result.reducedContext.end(); itContext++) {
+        molsToReduce.push_back(&(*itContext));
+    }
+    if (!result.origin.smile.empty()) {
+        molsToReduce.push_back(&result.origin);
+    }
+
+    DimensionReducer *reducer =
+        ReducerFactory::Create((DimRedSelector) task.dimRedSelector, pcaState);
+    reducer->Reduce(molsToReduce,
+        (FingerprintSelector) task.fingerprintSelector,
+        (SimCoeffSelector) task.simCoeffSelector, *mTbbCtx);
+    ReducerFactory::Recycle(reducer);
+}
+
 void NeighborhoodGenerator::operator()()
 {
     SynchCout(std::string("NeighborhoodGenerator thread started."));
@@ -161,21 +206,107 @@ void NeighborhoodGenerator::operator()()
              scatter attempts over cluster
             */
 
+            MoleculeVector firstStep;
             MoleculeVector neighborhood;
-            GenerateNeighborhood generateNeighborhood(task, neighborhood, mTbbCtx);
+            // shared by the partial and the complete reductions
+            PcaState pcaState;
+            SmileSet duplicateChecker;
+            duplicateChecker.insert(
+                SmileSet::value_type(task.origin.smile, true));
             if (!Cancelled() && !task.origin.smile.empty()) {
 
                 clock_t start = std::clock();
-                tbb::parallel_for(
-                    tbb::blocked_range<size_t>(0, task.attemptCount),
-                    generateNeighborhood, tbb::auto_partitioner(), *mTbbCtx);
+
+                // continue from the attempts done for the same parameters,
+                // a request that is not larger gets as many of the cached
+                // neighbors as its attempts account for
+                NeighborhoodCache::Entry &cached = mCache.Acquire(task);
+                unsigned int cachedAttempts = cached.attemptCount;
+                size_t served = cached.GetNeighborCount(task.attemptCount);
+                firstStep.assign(
+                    cached.firstStep.begin(), cached.firstStep.end());
+                neighborhood.assign(cached.neighborhood.begin(),
+                    cached.neighborhood.begin() + served);
+                for (size_t i = 0; i < served; ++i) {
+                    duplicateChecker.insert(SmileSet::value_type(
+                        cached.neighborhood[i].smile, true));
+                }
+
+                if (task.attemptCount > cachedAttempts) {
+                    // all walks start from the origin, so their first steps
+                    // are one batch of morphs of it
+                    std::vector<ChemOperSelector> chemOperSelectors;
+                    for (size_t i = 0; i < task.chemOperSelectors.size(); ++i) {
+                        chemOperSelectors.push_back(
+                            (ChemOperSelector) task.chemOperSelectors[i]);
+                    }
+                    std::vector<MolpherMolecule> emptyDecoys;
+                    size_t cachedFirstStep = firstStep.size();
+                    CollectFirstStep collectFirstStep(firstStep);
+                    GenerateMorphs(
+                        task.origin,
+                        task.attemptCount - cachedAttempts,
+                        (FingerprintSelector) task.fingerprintSelector,
+                        (SimCoeffSelector) task.simCoeffSelector,
+                        chemOperSelectors,
+                        task.origin,
+                        emptyDecoys,
+                        *mTbbCtx,
+                        &collectFirstStep,
+                        FirstStepCollector);
+                    GenerateNeighborhood generateNeighborhood(task, firstStep,
+                        neighborhood, duplicateChecker, cachedAttempts,
+                        cachedFirstStep, mTbbCtx);
+
+                    // walks run in chunks, so that partial results can be
+                    // published before the task completes; only PCA can
+                    // continue from the previous reduction
+                    bool partial = (NEIGHBORHOODGENERATOR_PARTIAL_RESULT > 0) &&
+                        (task.dimRedSelector != DR_KAMADAKAWAI);
+                    size_t chunk = task.attemptCount;
+                    if (partial) {
+                        chunk = NEIGHBORHOODGENERATOR_PARTIAL_RESULT;
+                    }
+                    std::vector<std::pair<unsigned int, size_t> > chunks;
+                    size_t end = cachedAttempts;
+                    while (end < task.attemptCount && !Cancelled()) {
+                        size_t begin = end;
+                        end = std::min(begin + chunk, (size_t) task.attemptCount);
+                        tbb::parallel_for(
+                            tbb::blocked_range<size_t>(begin, end),
+                            generateNeighborhood, tbb::auto_partitioner(),
+                            *mTbbCtx);
+                        chunks.push_back(std::make_pair(
+                            (unsigned int) end, neighborhood.size()));
+
+                        if (partial && (end < task.attemptCount) && !Cancelled()) {
+                            NeighborhoodTaskResult partialResult;
+                            ReduceNeighborhood(task, neighborhood,
+                                partialResult, &pcaState);
+                            partialResult.partial = true;
+                            mQueue->PublishPartialTaskResult(partialResult);
+                        }
+                    }
+
+                    if (!Cancelled()) {
+                        cached.attemptCount = task.attemptCount;
+                        cached.firstStep.assign(
+                            firstStep.begin(), firstStep.end());
+                        cached.neighborhood.assign(
+                            neighborhood.begin(), neighborhood.end());
+                        cached.chunks.insert(cached.chunks.end(),
+                            chunks.begin(), chunks.end());
+                    }
+                }
                 clock_t finish = std::clock();
 
 #if NEIGHBORHOODGENERATOR_REPORTING == 1
                 std::ostringstream stream;
                 stream << boost::posix_time::to_iso_string(task.taskTimestamp) <<
                     ": " << "GenerateNeighborhood consumed " <<
-                    finish - start << " msec.";
+                    finish - start << " msec (" <<
+                    std::min(cachedAttempts, task.attemptCount) <<
+                    " attempts cached).";
                 SynchCout(stream.str());
 #endif
             }
@@ -185,42 +316,10 @@ void NeighborhoodGenerator::operator()()
              gather neighborhood over cluster
             */
 
-            if (!Cancelled()) {
-                result.taskTimestamp = task.taskTimestamp;
-                result.origin = task.origin;
-                result.reducedNeighborhood.insert(
-                    result.reducedNeighborhood.end(),
-                    neighborhood.begin(), neighborhood.end());
-                result.reducedContext = task.context;
-            }
-
             if (!Cancelled()) {
                 clock_t start = std::clock();
 
-                DimensionReducer::MolPtrVector molsToReduce;
-                molsToReduce.reserve(result.reducedNeighborhood.size() +
-                    result.reducedContext.size() + 1);
-                std::vector<MolpherMolecule>::iterator itNeighborhood;
-                for (itNeighborhood = result.reducedNeighborhood.begin();
-                        itNeighborhood != result.reducedNeighborhood.end();
-                        itNeighborhood++) {
-                    molsToReduce.push_back(&(*itNeighborhood));
-                }
-                std::vector<MolpherMolecule>::iterator itContext;
-                for (itContext = result.reducedContext.begin();
-                        itContext != result.reducedContext.end(); itContext++) {
-                    molsToReduce.push_back(&(*itContext));
-                }
-                if (!result.origin.smile.empty()) {
-                    molsToReduce.push_back(&result.origin);
-                }
-
-                DimensionReducer *reducer =
-                    ReducerFactory::Create((DimRedSelector) task.dimRedSelector);
-                reducer->Reduce(molsToReduce,
-                    (FingerprintSelector) task.fingerprintSelector,
-                    (SimCoeffSelector) task.simCoeffSelector, *mTbbCtx);
-                ReducerFactory::Recycle(reducer);
+                ReduceNeighborhood(task, neighborhood, result, &pcaState);
 
                 clock_t finish = std::clock();
 
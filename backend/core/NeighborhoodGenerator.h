@@ -20,13 +20,24 @@
 #include <tbb/task.h>
 #include <tbb/blocked_range.h>
 #include <tbb/concurrent_vector.h>
+#include <tbb/concurrent_hash_map.h>
 
 #include "NeighborhoodTask.h"
+#include "NeighborhoodCache.h"
+#include "coord/PcaState.h"
 
 #ifndef NEIGHBORHOODGENERATOR_REPORTING
 #define NEIGHBORHOODGENERATOR_REPORTING 1
 #endif
 
+// publish a partial result after every this many walk attempts, the
+// reductions of a task continue one PCA so that each one only adds the new
+// neighbors; 0 (or a reducer other than PCA) publishes only the complete
+// result
+#ifndef NEIGHBORHOODGENERATOR_PARTIAL_RESULT
+#define NEIGHBORHOODGENERATOR_PARTIAL_RESULT 500
+#endif
+
 class NeighborhoodTaskQueue;
 
 class NeighborhoodGenerator
@@ -40,38 +51,62 @@ public:
 
 protected:
     typedef tbb::concurrent_vector<MolpherMolecule> MoleculeVector;
+    typedef tbb::concurrent_hash_map<std::string, bool /*dummy*/> SmileSet;
 
-    friend void NeighborhoodCollector(MolpherMolecule *morph, void *functor);
+    friend void FirstStepCollector(MolpherMolecule *morph, void *functor);
 
-    class CollectMorph
+    class CollectFirstStep
     {
     public:
-        CollectMorph();
-        void operator()(const MolpherMolecule &morph);
-        bool WithdrawMorph(MolpherMolecule &morph);
+        CollectFirstStep(MoleculeVector &firstStep);
+        void operator()(MolpherMolecule &morph);
 
     private:
-        bool mMorphSet;
-        MolpherMolecule mMorph;
+        SmileSet mDuplicateChecker;
+        MoleculeVector &mFirstStep;
     };
 
     class GenerateNeighborhood
     {
     public:
+        /**
+         * Walk attempts from firstAttempt on start from the first step
+         * morphs from firstStart on, so that the morphs added for them
+         * are walked before the earlier ones are revisited.
+         */
         GenerateNeighborhood(NeighborhoodTask &task,
-            MoleculeVector &neighborhood, tbb::task_group_context *tbbCtx);
+            MoleculeVector &firstStep, MoleculeVector &neighborhood,
+            SmileSet &duplicateChecker, size_t firstAttempt,
+            size_t firstStart, tbb::task_group_context *tbbCtx);
         void operator()(const tbb::blocked_range<size_t> &r) const;
 
     private:
         NeighborhoodTask &mTask;
+        // unique morphs of the origin all walks start with
+        MoleculeVector &mFirstStep;
+        size_t mFirstAttempt;
+        size_t mFirstStart;
         MoleculeVector &mNeighborhood;
+        // neighbors already in mNeighborhood and the origin
+        SmileSet &mDuplicateChecker;
         tbb::task_group_context *mTbbCtx;
     };
 
+    /**
+     * Fills result with the neighborhood, the task origin and context
+     * and computes their coordinates. pcaState carries the PCA over from
+     * the previous reduction of the task, it may be NULL.
+     */
+    void ReduceNeighborhood(NeighborhoodTask &task,
+        MoleculeVector &neighborhood, NeighborhoodTaskResult &result,
+        PcaState *pcaState);
+
     bool Cancelled();
 
 private:
     tbb::task_group_context *mTbbCtx;
     NeighborhoodTaskQueue *mQueue;
     int mThreadCnt;
+
+    NeighborhoodCache mCache;
 };
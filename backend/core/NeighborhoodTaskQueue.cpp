@@ -16,6 +16,8 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "inout.h"
 #include "BackendCommunicator.h"
 #include "NeighborhoodTaskQueue.h"
@@ -26,7 +28,8 @@ NeighborhoodTaskQueue::NeighborhoodTaskQueue(
     mHalted(false),
     mNeighborhoodGeneratorStopper(neighborhoodGeneratorStopper),
     mCommunicator(0),
-    mCurrentTaskTimestamp(boost::date_time::min_date_time)
+    mCurrentTaskTimestamp(boost::date_time::min_date_time),
+    mCurrentTaskSkipped(false)
 {
     SynchCout(std::string("NeighborhoodTaskQueue initialized."));
 }
@@ -61,12 +64,56 @@ bool NeighborhoodTaskQueue::Pop(NeighborhoodTask &task)
             mTaskReadyCondition.wait(lock); // Yields lock until signalled.
         }
     }
-    task = mTaskQueue.front(); // Copy the task.
+
+    // The most recent request goes first, the user is looking at it,
+    // unless an older one has been passed over too many times already.
+    std::deque<QueuedTask>::iterator newest = mTaskQueue.begin();
+    std::deque<QueuedTask>::iterator oldestAged = mTaskQueue.end();
+    std::deque<QueuedTask>::iterator it;
+    for (it = mTaskQueue.begin(); it != mTaskQueue.end(); ++it) {
+        if (it->task.taskTimestamp > newest->task.taskTimestamp) {
+            newest = it;
+        }
+        if (it->passes >= NEIGHBORHOODTASKQUEUE_MAX_PASSES &&
+                (oldestAged == mTaskQueue.end() ||
+                it->task.taskTimestamp < oldestAged->task.taskTimestamp)) {
+            oldestAged = it;
+        }
+    }
+    std::deque<QueuedTask>::iterator chosen =
+        (oldestAged != mTaskQueue.end()) ? oldestAged : newest;
+
+    task = chosen->task; // Copy the task.
     mCurrentTaskTimestamp = task.taskTimestamp; // Remember the current task's timestamp
-    mTaskQueue.pop_front();
+    mCurrentTaskSkipped = false;
+    mCurrentWaiting.swap(chosen->waiting);
+    mTaskQueue.erase(chosen);
+    for (it = mTaskQueue.begin(); it != mTaskQueue.end(); ++it) {
+        if (it->task.taskTimestamp < task.taskTimestamp) {
+            ++it->passes;
+        }
+    }
     return true;
 }
 
+void NeighborhoodTaskQueue::PublishPartialTaskResult(NeighborhoodTaskResult &res)
+{
+    Lock lock(mNeighborhoodTaskQueueGuard);
+
+    // Nothing from a task that is being skipped.
+    if ((res.taskTimestamp == mCurrentTaskTimestamp) &&
+            !mNeighborhoodGeneratorStopper->is_group_execution_cancelled()) {
+        if (!mCurrentTaskSkipped) {
+            PublishTaskResult(res);
+        }
+        for (size_t i = 0; i < mCurrentWaiting.size(); ++i) {
+            res.taskTimestamp = mCurrentWaiting[i];
+            PublishTaskResult(res);
+        }
+        res.taskTimestamp = mCurrentTaskTimestamp;
+    }
+}
+
 void NeighborhoodTaskQueue::CommitTaskResult(NeighborhoodTaskResult &res)
 {
     Lock lock(mNeighborhoodTaskQueueGuard);
@@ -75,15 +122,39 @@ void NeighborhoodTaskQueue::CommitTaskResult(NeighborhoodTaskResult &res)
     if (mNeighborhoodGeneratorStopper->is_group_execution_cancelled()) {
         mNeighborhoodGeneratorStopper->reset();
     } else {
-        PublishTaskResult(res);
+        if (!mCurrentTaskSkipped) {
+            PublishTaskResult(res);
+        }
+        // Equal requests the task superseded get the same result.
+        for (size_t i = 0; i < mCurrentWaiting.size(); ++i) {
+            res.taskTimestamp = mCurrentWaiting[i];
+            PublishTaskResult(res);
+        }
     }
+    mCurrentTaskSkipped = false;
+    mCurrentWaiting.clear();
 }
 
 void NeighborhoodTaskQueue::Push(NeighborhoodTask &task)
 {
     Lock lock(mNeighborhoodTaskQueueGuard);
     if (task.IsValid()) { // Prevents backend crash (should be ensured by frontend).
-        mTaskQueue.push_back(task);
+        QueuedTask queued(task);
+        if (!task.origin.smile.empty()) {
+            // A queued equal request is superseded by this one, its result
+            // goes to both.
+            std::deque<QueuedTask>::iterator it;
+            for (it = mTaskQueue.begin(); it != mTaskQueue.end(); ++it) {
+                if (IsSameRequest(it->task, task)) {
+                    queued.waiting.swap(it->waiting);
+                    queued.waiting.push_back(it->task.taskTimestamp);
+                    queued.passes = it->passes;
+                    mTaskQueue.erase(it);
+                    break;
+                }
+            }
+        }
+        mTaskQueue.push_back(queued);
     }
     lock.unlock(); // Unlock to prevent deadlock when signalling the condition.
     mTaskReadyCondition.notify_all();
@@ -94,13 +165,31 @@ void NeighborhoodTaskQueue::SkipNeighborhoodTask(boost::posix_time::ptime timest
     Lock lock(mNeighborhoodTaskQueueGuard);
     if (timestamp == mCurrentTaskTimestamp) {
         // If the timestamp matches the current task, stop the current task
-        mNeighborhoodGeneratorStopper->cancel_group_execution();
+        // unless superseded requests still wait for it
+        if (mCurrentWaiting.empty()) {
+            mNeighborhoodGeneratorStopper->cancel_group_execution();
+        } else {
+            mCurrentTaskSkipped = true;
+        }
+    } else if (RemoveTimestamp(mCurrentWaiting, timestamp)) {
+        if (mCurrentTaskSkipped && mCurrentWaiting.empty()) {
+            mNeighborhoodGeneratorStopper->cancel_group_execution();
+        }
     } else {
         // Else search through the queue and remove the appropriate task
-        std::deque<NeighborhoodTask>::iterator it = mTaskQueue.begin();
-        while (it != mTaskQueue.end()) {
-            if ((*it).taskTimestamp == timestamp) {
-                mTaskQueue.erase(it);
+        std::deque<QueuedTask>::iterator it;
+        for (it = mTaskQueue.begin(); it != mTaskQueue.end(); ++it) {
+            if (RemoveTimestamp(it->waiting, timestamp)) {
+                break;
+            }
+            if (it->task.taskTimestamp == timestamp) {
+                if (it->waiting.empty()) {
+                    mTaskQueue.erase(it);
+                } else {
+                    // a superseded request takes its place
+                    it->task.taskTimestamp = it->waiting.back();
+                    it->waiting.pop_back();
+                }
                 break;
             }
         }
@@ -114,3 +203,37 @@ void NeighborhoodTaskQueue::PublishTaskResult(NeighborhoodTaskResult &res)
         mCommunicator->PublishNeighborhoodTaskResult(res);
     }
 }
+
+bool NeighborhoodTaskQueue::IsSameRequest(const NeighborhoodTask &a,
+    const NeighborhoodTask &b)
+{
+    if (a.origin.smile != b.origin.smile ||
+            a.fingerprintSelector != b.fingerprintSelector ||
+            a.simCoeffSelector != b.simCoeffSelector ||
+            a.dimRedSelector != b.dimRedSelector ||
+            a.chemOperSelectors != b.chemOperSelectors ||
+            a.attemptCount != b.attemptCount ||
+            a.maxDepth != b.maxDepth ||
+            a.maxDistance != b.maxDistance ||
+            a.context.size() != b.context.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.context.size(); ++i) {
+        if (a.context[i].smile != b.context[i].smile) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NeighborhoodTaskQueue::RemoveTimestamp(TimestampVector &timestamps,
+    boost::posix_time::ptime timestamp)
+{
+    TimestampVector::iterator it =
+        std::find(timestamps.begin(), timestamps.end(), timestamp);
+    if (it == timestamps.end()) {
+        return false;
+    }
+    timestamps.erase(it);
+    return true;
+}
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <deque>
+#include <vector>
 
 #include <tbb/task.h>
 
@@ -28,6 +29,12 @@
 
 #include "NeighborhoodTask.h"
 
+// a queued task is taken before newer ones once this many newer tasks
+// were taken first, so that old requests are served eventually
+#ifndef NEIGHBORHOODTASKQUEUE_MAX_PASSES
+#define NEIGHBORHOODTASKQUEUE_MAX_PASSES 4
+#endif
+
 class BackendCommunicator;
 
 class NeighborhoodTaskQueue
@@ -41,6 +48,7 @@ public:
 
     // Functions called by neighborhood generator top-level thread.
     bool Pop(NeighborhoodTask &task);
+    void PublishPartialTaskResult(NeighborhoodTaskResult &res);
     void CommitTaskResult(NeighborhoodTaskResult &res);
 
     // Functions called by communicator thread.
@@ -48,8 +56,29 @@ public:
     void SkipNeighborhoodTask(boost::posix_time::ptime timestamp);
 
 protected:
+    typedef std::vector<boost::posix_time::ptime> TimestampVector;
+
+    struct QueuedTask
+    {
+        QueuedTask(const NeighborhoodTask &task) :
+            task(task),
+            passes(0)
+        {
+        }
+
+        NeighborhoodTask task;
+        // newer tasks taken before this one
+        unsigned int passes;
+        // timestamps of equal tasks it superseded, answered by its result
+        TimestampVector waiting;
+    };
+
     // Functions called only internally. Assumes proper synchronization by caller.
     void PublishTaskResult(NeighborhoodTaskResult &res);
+    static bool IsSameRequest(const NeighborhoodTask &a,
+        const NeighborhoodTask &b);
+    static bool RemoveTimestamp(TimestampVector &timestamps,
+        boost::posix_time::ptime timestamp);
 
 private:
     typedef boost::mutex Guard;
@@ -62,5 +91,8 @@ private:
     Guard mNeighborhoodTaskQueueGuard; // Serializes thread access to most of the methods.
 
     boost::posix_time::ptime mCurrentTaskTimestamp;
-    std::deque<NeighborhoodTask> mTaskQueue;
+    // the current task is computed only for the waiting timestamps
+    bool mCurrentTaskSkipped;
+    TimestampVector mCurrentWaiting;
+    std::deque<QueuedTask> mTaskQueue;
 };
@@ -20,6 +20,8 @@
 #include <cfloat>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 #include <tbb/task_scheduler_init.h>
 #include <tbb/tbb_exception.h>
@@ -57,7 +59,7 @@ bool PathFinder::Cancelled()
     return mTbbCtx->is_group_execution_cancelled();
 }
 
-PathFinder::FindLeaves::FindLeaves(MoleculeVector &leaves) :
+PathFinder::FindLeaves::FindLeaves(LeafVector &leaves) :
     mLeaves(leaves)
 {
 }
@@ -72,7 +74,7 @@ void PathFinder::FindLeaves::operator()(
         }
         bool isLeaf = it->second.descendants.empty();
         if (isLeaf) {
-            mLeaves.push_back(it->second);
+            mLeaves.push_back(&it->second);
         }
     }
 }
@@ -81,14 +83,16 @@ PathFinder::CollectMorphs::CollectMorphs(MoleculeVector &morphs) :
     mMorphs(morphs)
 {
     mCollectAttemptCount = 0;
+    mUniqueCount = 0;
 }
 
-void PathFinder::CollectMorphs::operator()(const MolpherMolecule &morph)
+void PathFinder::CollectMorphs::operator()(MolpherMolecule &morph)
 {
     ++mCollectAttemptCount; // atomic
     SmileSet::const_accessor dummy;
     if (mDuplicateChecker.insert(dummy, morph.smile)) {
-        mMorphs.push_back(morph);
+        ++mUniqueCount; // atomic
+        mMorphs.grow_by(1)->Swap(morph);
     } else {
         // ignore duplicate
     }
@@ -101,6 +105,13 @@ unsigned int PathFinder::CollectMorphs::WithdrawCollectAttemptCount()
     return ret;
 }
 
+unsigned int PathFinder::CollectMorphs::WithdrawUniqueCount()
+{
+    unsigned int ret = mUniqueCount;
+    mUniqueCount = 0;
+    return ret;
+}
+
 void MorphCollector(MolpherMolecule *morph, void *functor)
 {
     PathFinder::CollectMorphs *collect =
@@ -161,6 +172,12 @@ bool PathFinder::CompareMorphs::operator()(
     }*/
 }
 
+static ChemOperStats &OperStats(
+    PathFinderContext &ctx, const MolpherMolecule &morph)
+{
+    return ctx.morphingCollector.Local().opers[morph.parentChemOper];
+}
+
 PathFinder::FilterMorphs::FilterMorphs(PathFinderContext &ctx,
     size_t globalMorphCount, MoleculeVector &morphs, std::vector<bool> &survivors
     ) :
@@ -178,13 +195,9 @@ void PathFinder::FilterMorphs::operator()(const tbb::blocked_range<size_t> &r) c
 
     for (size_t idx = r.begin(); idx != r.end(); ++idx) {
 
-        double acceptProbability = 1.0;
         bool isTarget = (mMorphs[idx].smile == mCtx.target.smile);
-        if (idx >= mCtx.params.cntCandidatesToKeep && !isTarget) {
-            acceptProbability =
-                0.25 - (idx - mCtx.params.cntCandidatesToKeep) /
-                ((mGlobalMorphCount - mCtx.params.cntCandidatesToKeep) * 4.0);
-        }
+        double acceptProbability = AcceptProbability(
+            mCtx.params, idx, mGlobalMorphCount, isTarget);
 
         bool mightSurvive =
             SynchRand::GetRandomNumber(0, 99) < (int) (acceptProbability * 100);
@@ -260,6 +273,23 @@ void PathFinder::FilterMorphs::operator()(const tbb::blocked_range<size_t> &r) c
             isDead = (badWeight || badSascore || alreadyInTree ||
                 alreadyTriedByParent || tooManyProducedMorphs || badSubstructure);
             mSurvivors[idx] = !isDead;
+
+            if (isDead) {
+                ChemOperStats &stats = OperStats(mCtx, mMorphs[idx]);
+                if (badWeight) {
+                    ++stats.filteredWeight;
+                } else if (badSascore) {
+                    ++stats.filteredSascore;
+                } else if (alreadyInTree) {
+                    ++stats.filteredInTree;
+                } else if (alreadyTriedByParent) {
+                    ++stats.filteredTriedByParent;
+                } else if (tooManyProducedMorphs) {
+                    ++stats.filteredTooManyDerivations;
+                }
+            }
+        } else {
+            ++OperStats(mCtx, mMorphs[idx]).filteredRandom;
         }
     }
     // release data
@@ -268,6 +298,26 @@ void PathFinder::FilterMorphs::operator()(const tbb::blocked_range<size_t> &r) c
     }
 }
 
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+static void AddLeafSurvivor(PathFinderContext &ctx, const std::string &parent)
+{
+    PathFinderContext::LeafStatMap::accessor ac;
+    ctx.leafStats.insert(ac, parent);
+    ac->second.survivors += 1.0;
+}
+#endif
+
+static void InsertCandidateGraph(
+    PathFinderContext &ctx, const MolpherMolecule &morph)
+{
+    if (morph.graphHash != 0) {
+        GraphHashMap::accessor ac;
+        if (ctx.candidateGraphs.insert(ac, morph.graphHash)) {
+            ac->second = morph.smile;
+        }
+    }
+}
+
 PathFinder::AcceptMorphs::AcceptMorphs(
     MoleculeVector &morphs, std::vector<bool> &survivors,
     PathFinderContext &ctx, SmileSet &modifiedParents
@@ -310,9 +360,15 @@ void PathFinder::AcceptMorphs::operator()(
             if (mSurvivorCount < mCtx.params.cntCandidatesToKeepMax) {
                 PathFinderContext::CandidateMap::accessor ac;
 
-                mCtx.candidates.insert(ac, mMorphs[idx].smile);
-                ac->second = mMorphs[idx];
-                ac.release();
+                InsertCandidateGraph(mCtx, mMorphs[idx]);
+#if PATHFINDER_OPERATOR_BANDIT == 1
+                mCtx.operBandit.AddSurvivor(
+                    (ChemOperSelector) mMorphs[idx].parentChemOper);
+#endif
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+                AddLeafSurvivor(mCtx, mMorphs[idx].parentSmile);
+#endif
+                ++OperStats(mCtx, mMorphs[idx]).accepted;
 
                 if (mCtx.candidates.find(ac, mMorphs[idx].parentSmile)) {
                     ac->second.descendants.insert(mMorphs[idx].smile);
@@ -322,6 +378,13 @@ void PathFinder::AcceptMorphs::operator()(
                 } else {
                     assert(false);
                 }
+                ac.release();
+
+                // morphs are not read after acceptance, move it to the tree
+                mCtx.candidates.insert(ac, mMorphs[idx].smile);
+                ac->second.Swap(mMorphs[idx]);
+            } else {
+                ++OperStats(mCtx, mMorphs[idx]).filteredKeepLimit;
             }
 
             ++mSurvivorCount;
@@ -465,6 +528,16 @@ void PathFinder::PruneTree::EraseSubTree(const std::string &root) const
             toErase.push_back(*it);
         }
 
+        if (ac->second.graphHash != 0) {
+            GraphHashMap::accessor gac;
+            if (mCtx.candidateGraphs.find(gac, ac->second.graphHash) &&
+                    gac->second == current) {
+                mCtx.candidateGraphs.erase(gac);
+            }
+        }
+
+        mCtx.leafStats.erase(current);
+
         mCtx.prunedDuringThisIter.push_back(current);
         mCtx.candidates.erase(ac);
     }
@@ -521,9 +594,14 @@ void acceptMorph(
         PathFinder::SmileSet &modifiedParents)
 {    
     PathFinderContext::CandidateMap::accessor ac;
-    ctx.candidates.insert(ac, morphs[idx].smile);
-    ac->second = morphs[idx];
-    ac.release();
+    InsertCandidateGraph(ctx, morphs[idx]);
+#if PATHFINDER_OPERATOR_BANDIT == 1
+    ctx.operBandit.AddSurvivor((ChemOperSelector) morphs[idx].parentChemOper);
+#endif
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+    AddLeafSurvivor(ctx, morphs[idx].parentSmile);
+#endif
+    ++OperStats(ctx, morphs[idx]).accepted;
 
     if (ctx.candidates.find(ac, morphs[idx].parentSmile)) {
         ac->second.descendants.insert(morphs[idx].smile);
@@ -532,7 +610,11 @@ void acceptMorph(
         modifiedParents.insert(dummy, ac->second.smile);
     } else {
         assert(false);
-    }    
+    }
+    ac.release();
+
+    ctx.candidates.insert(ac, morphs[idx].smile);
+    ac->second.Swap(morphs[idx]);
 }
 
 /**
@@ -622,6 +704,170 @@ void acceptMorphs(PathFinder::MoleculeVector &morphs,
     */
 }
 
+/**
+ * Probability that FilterMorphs tests the morph at the given rank at all,
+ * the first cntCandidatesToKeep morphs are always tested.
+ */
+double PathFinder::AcceptProbability(const MolpherParam &params,
+    size_t idx, size_t globalMorphCount, bool isTarget)
+{
+    if (idx < params.cntCandidatesToKeep || isTarget) {
+        return 1.0;
+    }
+    return 0.25 - (idx - params.cntCandidatesToKeep) /
+        ((globalMorphCount - params.cntCandidatesToKeep) * 4.0);
+}
+
+/**
+ * False if FilterMorphs would certainly drop the morph, the tests that
+ * do not depend on its rank.
+ */
+bool PathFinder::MightSurvive(
+    PathFinderContext &ctx, const MolpherMolecule &morph)
+{
+    if ((morph.molecularWeight < ctx.params.minAcceptableMolecularWeight) ||
+            (morph.molecularWeight > ctx.params.maxAcceptableMolecularWeight)) {
+        return false;
+    }
+    if (ctx.params.useSyntetizedFeasibility && morph.sascore > 6.0) {
+        return false;
+    }
+    PathFinderContext::CandidateMap::const_accessor ac;
+    if (ctx.candidates.find(ac, morph.smile)) {
+        return false;
+    }
+    ac.release();
+    if (ctx.candidates.find(ac, morph.parentSmile) &&
+            (ac->second.historicDescendants.find(morph.smile) !=
+            ac->second.historicDescendants.end())) {
+        return false;
+    }
+    PathFinderContext::MorphDerivationMap::const_accessor derivations;
+    if (ctx.morphDerivations.find(derivations, morph.smile) &&
+            (derivations->second > ctx.params.cntMaxMorphs)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the rating (see CompareMorphs) above which no morph can be kept,
+ * or a negative value if it cannot be told yet. Only morphs that might
+ * survive FilterMorphs count, and PATHFINDER_SCREENING_MARGIN of them per
+ * kept slot past cntCandidatesToKeep, because those are only accepted
+ * with a probability (see AcceptProbability).
+ */
+double PathFinder::KeptRangeCutoff(
+    PathFinderContext &ctx, MoleculeVector &morphs)
+{
+    size_t keepCount = ctx.params.cntCandidatesToKeep +
+        PATHFINDER_SCREENING_MARGIN * (ctx.params.cntCandidatesToKeepMax -
+        ctx.params.cntCandidatesToKeep);
+    if (ctx.params.cntCandidatesToKeepMax == 0 || morphs.size() < keepCount) {
+        return -1.0;
+    }
+
+    std::vector<double> ratings;
+    ratings.reserve(morphs.size());
+    for (MoleculeVector::iterator it = morphs.begin();
+            it != morphs.end(); ++it) {
+        if (MightSurvive(ctx, *it)) {
+            ratings.push_back(it->distToTarget + it->distToClosestDecoy);
+        }
+    }
+    if (ratings.size() < keepCount) {
+        return -1.0;
+    }
+    std::nth_element(ratings.begin(), ratings.begin() + (keepCount - 1),
+        ratings.end());
+    return ratings[keepCount - 1];
+}
+
+static unsigned int FixedMorphBudget(
+    const PathFinderContext &ctx, const MolpherMolecule &leaf)
+{
+    if (leaf.distToTarget < ctx.params.distToTargetDepthSwitch) {
+        return ctx.params.cntMorphsInDepth;
+    }
+    return ctx.params.cntMorphs;
+}
+
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+// weight of the history at each new expansion of the leaf
+static const double LEAF_STAT_DECAY = 0.5;
+// an accepted morph counts as this many new morphs
+static const double SURVIVOR_WEIGHT = 4.0;
+// bounds of the budget relative to the fixed one
+static const double MIN_BUDGET_FACTOR = 0.25;
+static const double MAX_BUDGET_FACTOR = 2.0;
+
+static double LeafYield(PathFinderContext &ctx, const std::string &smile)
+{
+    // leaves never expanded get the prior of one new morph in two attempts
+    PathFinderContext::LeafStatMap::const_accessor ac;
+    if (!ctx.leafStats.find(ac, smile)) {
+        return 0.5;
+    }
+    return (ac->second.uniqueMorphs + SURVIVOR_WEIGHT * ac->second.survivors
+        + 1.0) / (ac->second.attempts + 2.0);
+}
+
+/**
+ * Scales the fixed budget of each leaf by its yield relative to the
+ * average one. The sum of the budgets never exceeds the sum of the fixed
+ * ones, which keeps the iteration time predictable.
+ */
+static void AdaptiveMorphBudgets(PathFinderContext &ctx,
+    PathFinder::LeafVector &leaves, std::vector<unsigned int> &budgets)
+{
+    std::vector<double> yields(leaves.size());
+    double cap = 0.0;
+    double weightedYield = 0.0;
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        double fixed = FixedMorphBudget(ctx, *leaves[i]);
+        yields[i] = LeafYield(ctx, leaves[i]->smile);
+        cap += fixed;
+        weightedYield += fixed * yields[i];
+    }
+    double meanYield = (cap > 0.0) ? weightedYield / cap : 0.0;
+
+    std::vector<double> wanted(leaves.size());
+    double wantedSum = 0.0;
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        double factor = (meanYield > 0.0) ? yields[i] / meanYield : 1.0;
+        factor = std::max(MIN_BUDGET_FACTOR, std::min(MAX_BUDGET_FACTOR, factor));
+        wanted[i] = FixedMorphBudget(ctx, *leaves[i]) * factor;
+        wantedSum += wanted[i];
+    }
+    double scale = (wantedSum > cap) ? cap / wantedSum : 1.0;
+
+    budgets.resize(leaves.size());
+    double remaining = cap;
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        budgets[i] = static_cast<unsigned int>(wanted[i] * scale);
+        remaining -= budgets[i];
+    }
+    // every leaf gets at least one attempt while the cap allows it
+    for (size_t i = 0; i < leaves.size() && remaining >= 1.0; ++i) {
+        if (budgets[i] == 0) {
+            budgets[i] = 1;
+            remaining -= 1.0;
+        }
+    }
+}
+
+static void AddLeafExpansion(PathFinderContext &ctx, const std::string &smile,
+    unsigned int attempts, unsigned int uniqueMorphs)
+{
+    PathFinderContext::LeafStatMap::accessor ac;
+    ctx.leafStats.insert(ac, smile);
+    ac->second.attempts = LEAF_STAT_DECAY * ac->second.attempts + attempts;
+    ac->second.uniqueMorphs =
+        LEAF_STAT_DECAY * ac->second.uniqueMorphs + uniqueMorphs;
+    ac->second.survivors = LEAF_STAT_DECAY * ac->second.survivors;
+}
+#endif
+
 void PathFinder::operator()()
 {
     SynchCout(std::string("PathFinder thread started."));
@@ -664,12 +910,13 @@ void PathFinder::operator()()
                 mJobManager->GetParams(mCtx.params);
                 mJobManager->GetDecoys(mCtx.decoys);
                 mCtx.prunedDuringThisIter.clear();
+                mCtx.morphingCollector.Reset();
             }
 
             AccumulateTime molpherStopwatch(mCtx);
             AccumulateTime stageStopwatch(mCtx);
 
-            MoleculeVector leaves;
+            LeafVector leaves;
             FindLeaves findLeaves(leaves);
             if (!Cancelled()) {
                 tbb::parallel_for(
@@ -695,17 +942,35 @@ void PathFinder::operator()()
 
             MoleculeVector morphs;
             CollectMorphs collectMorphs(morphs);
-            for (MoleculeVector::iterator it = leaves.begin(); it != leaves.end(); it++) {
-                MolpherMolecule &candidate = (*it);
-                unsigned int morphAttempts = mCtx.params.cntMorphs;
-                if (candidate.distToTarget < mCtx.params.distToTargetDepthSwitch) {
-                    morphAttempts = mCtx.params.cntMorphsInDepth;
+            unsigned int screenedOutCount = 0;
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+            std::vector<unsigned int> budgets;
+            AdaptiveMorphBudgets(mCtx, leaves, budgets);
+#endif
+            for (LeafVector::iterator it = leaves.begin(); it != leaves.end(); it++) {
+                MolpherMolecule &candidate = **it;
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+                unsigned int morphAttempts = budgets[it - leaves.begin()];
+                if (morphAttempts == 0) {
+                    continue;
                 }
+#else
+                unsigned int morphAttempts = FixedMorphBudget(mCtx, candidate);
+#endif
                 
                 if (!Cancelled()) {
                     morphs.reserve(morphs.size() + morphAttempts);
-                                        
-                    GenerateMorphs(
+
+                    double screenCutoff = -1.0;
+#if PATHFINDER_TWO_TIER_SCREENING == 1
+                    screenCutoff = KeptRangeCutoff(mCtx, morphs);
+#endif
+                    ChemOperBandit *bandit = NULL;
+#if PATHFINDER_OPERATOR_BANDIT == 1
+                    bandit = &mCtx.operBandit;
+#endif
+
+                    unsigned int screened = GenerateMorphs(
                         candidate,
                         morphAttempts,
                         mCtx.fingerprintSelector,
@@ -715,15 +980,26 @@ void PathFinder::operator()()
                         mCtx.decoys,
                         *mTbbCtx,
                         &collectMorphs,
-                        MorphCollector);
+                        MorphCollector,
+                        screenCutoff,
+                        &mCtx.candidateGraphs,
+                        bandit,
+                        &mCtx.morphingCollector);
+                    screenedOutCount += screened;
                     PathFinderContext::MorphDerivationMap::accessor ac;
                     
+                    // screened morphs were produced as well, they were
+                    // just not delivered
                     if (mCtx.morphDerivations.find(ac, candidate.smile)) {
-                        ac->second += collectMorphs.WithdrawCollectAttemptCount();
+                        ac->second += collectMorphs.WithdrawCollectAttemptCount() + screened;
                     } else {
                         mCtx.morphDerivations.insert(ac, candidate.smile);
-                        ac->second = collectMorphs.WithdrawCollectAttemptCount();
+                        ac->second = collectMorphs.WithdrawCollectAttemptCount() + screened;
                     }
+#if PATHFINDER_ADAPTIVE_BUDGET == 1
+                    AddLeafExpansion(mCtx, candidate.smile, morphAttempts,
+                        collectMorphs.WithdrawUniqueCount());
+#endif
                 }
 
                 if (Cancelled()) {
@@ -734,6 +1010,22 @@ void PathFinder::operator()()
 
             if (!Cancelled()) {
                 stageStopwatch.ReportElapsedMiliseconds("GenerateMorphs", true);
+#if PATHFINDER_REPORTING == 1
+                // CPU time of all threads, included in GenerateMorphs
+                std::ostringstream allocStream;
+                allocStream << mCtx.jobId << "/" << mCtx.iterIdx + 1 <<
+                    ": MorphAllocation consumed " <<
+                    mCtx.morphingCollector.GetAllocNanoseconds() / 1000000 <<
+                    " msec.";
+                SynchCout(allocStream.str());
+#endif
+#if PATHFINDER_TWO_TIER_SCREENING == 1 && PATHFINDER_REPORTING == 1
+                std::ostringstream stream;
+                stream << mCtx.jobId << "/" << mCtx.iterIdx + 1 <<
+                    ": Screening skipped " << screenedOutCount <<
+                    " full distance computations.";
+                SynchCout(stream.str());
+#endif
             }
 
             CompareMorphs compareMorphs;
@@ -783,7 +1075,10 @@ void PathFinder::operator()()
 
             std::vector<bool> survivors;
             survivors.resize(morphs.size(), false);
-            FilterMorphs filterMorphs(mCtx, morphs.size(), morphs, survivors);
+            // screened morphs rank past all the others, they still count
+            // for the acceptance probability of the others
+            FilterMorphs filterMorphs(
+                mCtx, morphs.size() + screenedOutCount, morphs, survivors);
             if (!Cancelled()) {
                 if (mCtx.params.useSyntetizedFeasibility) {
                     SynchCout("\tUsing syntetize feasibility");
@@ -807,6 +1102,9 @@ void PathFinder::operator()()
             SmileSet modifiedParents;
             acceptMorphs(morphs, survivors, mCtx, modifiedParents, mCtx.decoys.size());
             stageStopwatch.ReportElapsedMiliseconds("AcceptMorphs", true);
+#if PATHFINDER_OPERATOR_BANDIT == 1
+            mCtx.operBandit.EndIteration();
+#endif
             
             UpdateTree updateTree(mCtx);
             if (!Cancelled()) {
@@ -860,8 +1158,9 @@ void PathFinder::operator()()
                 molsToReduce.push_back(&mCtx.source);
                 molsToReduce.push_back(&mCtx.target);
 
+                // the tree changes little between iterations
                 DimensionReducer *reducer =
-                    ReducerFactory::Create(mCtx.dimRedSelector);
+                    ReducerFactory::Create(mCtx.dimRedSelector, &mCtx.pcaState);
                 reducer->Reduce(molsToReduce,
                     mCtx.fingerprintSelector, mCtx.simCoeffSelector, *mTbbCtx);
                 ReducerFactory::Recycle(reducer);
@@ -870,6 +1169,10 @@ void PathFinder::operator()()
             }
 
             if (!Cancelled()) {
+                mCtx.iterMorphingStats.Clear();
+                mCtx.morphingCollector.Withdraw(mCtx.iterMorphingStats);
+                mCtx.jobMorphingStats.Add(mCtx.iterMorphingStats);
+
                 mCtx.iterIdx += 1;
                 mCtx.elapsedSeconds += molpherStopwatch.GetElapsedSeconds();
 
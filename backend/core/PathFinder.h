@@ -38,6 +38,31 @@
 #define PATHFINDER_REPORTING 1
 #endif
 
+// drop morphs that cannot get into the kept range before their full
+// distance is computed (see FoldedScreen)
+#ifndef PATHFINDER_TWO_TIER_SCREENING
+#define PATHFINDER_TWO_TIER_SCREENING 0
+#endif
+
+// the screening cutoff is the rating of the morph that has this many
+// survivable morphs before it per kept slot past cntCandidatesToKeep, morphs
+// past cntCandidatesToKeep are accepted with a probability of at most 1/4
+#ifndef PATHFINDER_SCREENING_MARGIN
+#define PATHFINDER_SCREENING_MARGIN 16
+#endif
+
+// draw chemical operators by their yield of accepted morphs per CPU time
+// instead of uniformly (see ChemOperBandit)
+#ifndef PATHFINDER_OPERATOR_BANDIT
+#define PATHFINDER_OPERATOR_BANDIT 0
+#endif
+
+// move morph attempts toward leaves whose recent expansions yielded new
+// morphs, the total stays within the fixed per-leaf budgets
+#ifndef PATHFINDER_ADAPTIVE_BUDGET
+#define PATHFINDER_ADAPTIVE_BUDGET 0
+#endif
+
 class JobManager;
 
 class PathFinder
@@ -52,18 +77,20 @@ public:
 // protected:
 public:
     typedef tbb::concurrent_vector<MolpherMolecule> MoleculeVector;
+    // leaves stay in mCtx.candidates, nothing is erased while they are used
+    typedef tbb::concurrent_vector<MolpherMolecule *> LeafVector;
     typedef tbb::concurrent_vector<std::string> SmileVector;
     typedef tbb::concurrent_hash_map<std::string, bool /*dummy*/> SmileSet;
 
     class FindLeaves
     {
     public:
-        FindLeaves(MoleculeVector &leaves);
+        FindLeaves(LeafVector &leaves);
         void operator()(
             const PathFinderContext::CandidateMap::range_type &candidates) const;
 
     private:
-        MoleculeVector &mLeaves;
+        LeafVector &mLeaves;
     };
 
     friend void MorphCollector(MolpherMolecule *morph, void *functor);
@@ -72,13 +99,15 @@ public:
     {
     public:
         CollectMorphs(MoleculeVector &morphs);
-        void operator()(const MolpherMolecule &morph);
+        void operator()(MolpherMolecule &morph);
         unsigned int WithdrawCollectAttemptCount();
+        unsigned int WithdrawUniqueCount();
 
     private:
         SmileSet mDuplicateChecker;
         MoleculeVector &mMorphs;
         tbb::atomic<unsigned int> mCollectAttemptCount;
+        tbb::atomic<unsigned int> mUniqueCount;
     };
 
     class CompareMorphs
@@ -159,6 +188,13 @@ public:
         clock_t mTimestamp;
     };
 
+    static double AcceptProbability(const MolpherParam &params,
+        size_t idx, size_t globalMorphCount, bool isTarget);
+    static bool MightSurvive(
+        PathFinderContext &ctx, const MolpherMolecule &morph);
+    static double KeptRangeCutoff(
+        PathFinderContext &ctx, MoleculeVector &morphs);
+
     bool Cancelled();
 
 private:
@@ -57,6 +57,11 @@ void PathFinderContext::ContextToSnapshot(
             it != ctx.prunedDuringThisIter.end(); it++) {
         snp.prunedDuringThisIter.push_back(*it);
     }
+
+    ctx.operBandit.Save(snp.chemOperSurvivors, snp.chemOperMiliseconds);
+
+    snp.iterMorphingStats = ctx.iterMorphingStats;
+    snp.jobMorphingStats = ctx.jobMorphingStats;
 }
 
 void PathFinderContext::SnapshotToContext(
@@ -88,6 +93,19 @@ void PathFinderContext::SnapshotToContext(
         ctx.candidates.insert(*it);
     }
 
+    ctx.leafStats.clear();
+    ctx.pcaState.clear();
+
+    ctx.candidateGraphs.clear();
+    for (CandidateMap::const_iterator it = ctx.candidates.begin();
+            it != ctx.candidates.end(); it++) {
+        if (it->second.graphHash != 0) {
+            GraphHashMap::accessor ac;
+            ctx.candidateGraphs.insert(ac, it->second.graphHash);
+            ac->second = it->first;
+        }
+    }
+
     ctx.morphDerivations.clear();
     for (IterationSnapshot::MorphDerivationMap::const_iterator it = snp.morphDerivations.begin();
             it != snp.morphDerivations.end(); it++) {
@@ -100,6 +118,12 @@ void PathFinderContext::SnapshotToContext(
             it != snp.prunedDuringThisIter.end(); it++) {
         ctx.prunedDuringThisIter.push_back(*it);
     }
+
+    ctx.operBandit.Load(snp.chemOperSurvivors, snp.chemOperMiliseconds);
+
+    ctx.iterMorphingStats = snp.iterMorphingStats;
+    ctx.jobMorphingStats = snp.jobMorphingStats;
+    ctx.morphingCollector.Reset();
 }
 
 void PathFinderContext::ContextToLightSnapshot(
@@ -131,6 +155,13 @@ void PathFinderContext::clear()
     chemOperSelectors.clear();
     decoys.clear();
     candidates.clear();
+    candidateGraphs.clear();
+    operBandit.Clear();
+    leafStats.clear();
+    pcaState.clear();
+    morphingCollector.Reset();
+    iterMorphingStats.Clear();
+    jobMorphingStats.Clear();
     morphDerivations.clear();
     prunedDuringThisIter.clear();
     prunedDuringThisIter.shrink_to_fit();
@@ -31,7 +31,12 @@
 
 #include "MolpherParam.h"
 #include "MolpherMolecule.h"
+#include "MorphingStats.h"
 #include "IterationSnapshot.h"
+#include "chem/morphing/Morphing.hpp"
+#include "chem/morphing/ChemOperBandit.hpp"
+#include "chem/morphing/MorphingStatsCollector.hpp"
+#include "coord/PcaState.h"
 
 struct PathFinderContext
 {
@@ -61,9 +66,38 @@ struct PathFinderContext
     typedef tbb::concurrent_hash_map<std::string, unsigned int> MorphDerivationMap;
     typedef tbb::concurrent_vector<std::string> PrunedMoleculeVector;
 
+    /**
+     * Expansion history of a candidate, decayed with every expansion.
+     */
+    struct LeafStat
+    {
+        LeafStat() :
+            attempts(0.0),
+            uniqueMorphs(0.0),
+            survivors(0.0)
+        {
+        }
+
+        double attempts;
+        double uniqueMorphs; // not produced by other leaves of the iteration
+        double survivors; // accepted into the tree
+    };
+    typedef tbb::concurrent_hash_map<std::string, LeafStat> LeafStatMap;
+
     CandidateMap candidates;
     MorphDerivationMap morphDerivations;
     PrunedMoleculeVector prunedDuringThisIter;
+    // graph hashes of the candidates that have one (see GenerateMorphs)
+    GraphHashMap candidateGraphs;
+    ChemOperBandit operBandit;
+    // not part of the snapshot, starts empty when the job is loaded
+    LeafStatMap leafStats;
+    // not part of the snapshot, rebuilt by the first reduction
+    PcaState pcaState;
+
+    MorphingStatsCollector morphingCollector;
+    MorphingStats iterMorphingStats; // of the last finished iteration
+    MorphingStats jobMorphingStats; // of all iterations of the job
     
     MolpherMolecule substructure;
 };
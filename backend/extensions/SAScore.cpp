@@ -17,41 +17,178 @@
 #include <algorithm>
 #include <iterator>
 #include <iostream>
+#include <cstring>
+
+#include <boost/filesystem.hpp>
 
 SAScore * SAScore::instance = NULL;
 
+// SAScore.bin header, record count follows the magic
+static const char SASCORE_BIN_MAGIC[8] = {'S', 'A', 'S', 'C', 'O', 'R', 'E', '1'};
+
+struct SAScoreBinHeader {
+    char magic[8];
+    boost::uint64_t count;
+};
+
+static bool CompareFragmentId(const SAScoreFragment &fragment, boost::uint32_t id)
+{
+    return fragment.id < id;
+}
+
+static bool CompareFragments(const SAScoreFragment &a, const SAScoreFragment &b)
+{
+    return a.id < b.id;
+}
+
+static bool EqualFragments(const SAScoreFragment &a, const SAScoreFragment &b)
+{
+    return a.id == b.id;
+}
+
+/*
+ True if both files exist and the first one was modified before the second.
+ */
+static bool IsOlder(const std::string &file, const std::string &other)
+{
+    boost::system::error_code error;
+    std::time_t fileTime = boost::filesystem::last_write_time(file, error);
+    if (error) {
+        return false;
+    }
+    std::time_t otherTime = boost::filesystem::last_write_time(other, error);
+    if (error) {
+        return false;
+    }
+    return fileTime < otherTime;
+}
+
 /*
- Static method for loading data into instance.
+ Static method for loading data into instance. Prefers the precompiled
+ SAScore.bin (memory-mapped) unless SAScore.dat is newer, falls back to
+ the text SAScore.dat.
  */
 void SAScore::loadData() {
-    std::cout << "loading SAScore.dat ... ";
-    
     SAScore* inst = getInstance();
+    // Both files must be in the same directory as exe file of server.
+    if (IsOlder("SAScore.bin", "SAScore.dat")) {
+        std::cout << "SAScore.bin is older than SAScore.dat, ignoring it "
+            "(run with --sascore-bin to convert it again)." << std::endl;
+    } else if (inst->mapBinary("SAScore.bin")) {
+        std::cout << "mapped SAScore.bin (" << inst->fragmentCount <<
+            " fragments)" << std::endl;
+        return;
+    }
+
+    std::cout << "loading SAScore.dat ... ";
+    readText("SAScore.dat", inst->table);
+    inst->fragments = inst->table.empty() ? NULL : &inst->table[0];
+    inst->fragmentCount = inst->table.size();
+    std::cout << "done" << std::endl;
+    return;
+}
+
+/*
+ Read text table into sorted array, the last occurrence of an id wins
+ (same as assigning into a map).
+ */
+void SAScore::readText(const std::string &datFile, std::vector<SAScoreFragment> &table)
+{
     std::ifstream myfile;
-    // This file must be in the same directory as exe file of server.
-    myfile.open("SAScore.dat");
+    myfile.open(datFile.c_str());
     if (!myfile.good()) {
         // problem when opening the file
-        throw std::runtime_error("Can't load sascore file SAScore.dat");
+        throw std::runtime_error("Can't load sascore file " + datFile);
         return;
     }
-    
+
     char array[31];
     myfile.getline(array, 31);
 
+    SAScoreFragment fragment;
+    fragment.reserved = 0;
     unsigned int id;
     unsigned int count;
     double score;
-    int i =0;
-    while (!myfile.eof()) {
-        myfile >> id >> count >> score;
-        inst->data[id] = score;
-        i++;
+    table.clear();
+    while (myfile >> id >> count >> score) {
+        fragment.id = id;
+        fragment.score = score;
+        table.push_back(fragment);
     }
-
     myfile.close();
-    std::cout << "done" << std::endl;
-    return;
+
+    std::reverse(table.begin(), table.end());
+    std::stable_sort(table.begin(), table.end(), CompareFragments);
+    table.erase(std::unique(table.begin(), table.end(), EqualFragments), table.end());
+}
+
+bool SAScore::mapBinary(const std::string &binFile)
+{
+    std::ifstream probe(binFile.c_str());
+    if (!probe.good()) {
+        return false;
+    }
+    probe.close();
+
+    try {
+        mappedFile = new boost::interprocess::file_mapping(
+            binFile.c_str(), boost::interprocess::read_only);
+        mappedRegion = new boost::interprocess::mapped_region(
+            *mappedFile, boost::interprocess::read_only);
+    } catch (boost::interprocess::interprocess_exception &exc) {
+        std::cout << "Can't map " << binFile << ": " << exc.what() << std::endl;
+        delete mappedRegion;
+        mappedRegion = NULL;
+        delete mappedFile;
+        mappedFile = NULL;
+        return false;
+    }
+
+    const char *begin = static_cast<const char *>(mappedRegion->get_address());
+    size_t size = mappedRegion->get_size();
+    const SAScoreBinHeader *header = reinterpret_cast<const SAScoreBinHeader *>(begin);
+    if (size < sizeof(SAScoreBinHeader) ||
+            std::memcmp(header->magic, SASCORE_BIN_MAGIC, sizeof(SASCORE_BIN_MAGIC)) != 0 ||
+            size < sizeof(SAScoreBinHeader) + header->count * sizeof(SAScoreFragment)) {
+        std::cout << binFile << " is corrupted, ignoring it." << std::endl;
+        delete mappedRegion;
+        mappedRegion = NULL;
+        delete mappedFile;
+        mappedFile = NULL;
+        return false;
+    }
+
+    fragments = reinterpret_cast<const SAScoreFragment *>(begin + sizeof(SAScoreBinHeader));
+    fragmentCount = static_cast<size_t>(header->count);
+    return true;
+}
+
+void SAScore::convertData(const std::string &datFile, const std::string &binFile)
+{
+    std::vector<SAScoreFragment> table;
+    readText(datFile, table);
+
+    std::ofstream out(binFile.c_str(), std::ios_base::out | std::ios_base::binary);
+    if (!out.good()) {
+        throw std::runtime_error("Can't write sascore file " + binFile);
+    }
+    SAScoreBinHeader header;
+    std::memcpy(header.magic, SASCORE_BIN_MAGIC, sizeof(SASCORE_BIN_MAGIC));
+    header.count = table.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!table.empty()) {
+        out.write(reinterpret_cast<const char *>(&table[0]),
+            table.size() * sizeof(SAScoreFragment));
+    }
+    out.close();
+}
+
+const SAScoreFragment *SAScore::findFragment(boost::uint32_t id) const
+{
+    const SAScoreFragment *end = fragments + fragmentCount;
+    const SAScoreFragment *it = std::lower_bound(fragments, end, id, CompareFragmentId);
+    return (it != end && it->id == id) ? it : NULL;
 }
 
 /*
@@ -65,7 +202,11 @@ SAScore* SAScore::getInstance()
     return instance;
 }
 
-SAScore::SAScore()
+SAScore::SAScore() :
+    fragments(NULL),
+    fragmentCount(0),
+    mappedFile(NULL),
+    mappedRegion(NULL)
 {
 }
 
@@ -75,17 +216,27 @@ SAScore::SAScore()
  */
 double SAScore::getScore(RDKit::ROMol& mol)
 {
-    RDKit::SparseIntVect< boost::uint32_t >::StorageType::const_iterator iter;
     RDKit::SparseIntVect< boost::uint32_t > * fp = RDKit::MorganFingerprints::getFingerprint(mol, 2, 0, 0, false, true, false, 0);
+    double score = getScore(mol, *fp);
+    // release data
+    delete fp;
+    fp = 0;
+    return score;
+}
+
+double SAScore::getScore(RDKit::ROMol& mol, const RDKit::SparseIntVect<boost::uint32_t> &morganFp)
+{
+    RDKit::SparseIntVect< boost::uint32_t >::StorageType::const_iterator iter;
+    const RDKit::SparseIntVect< boost::uint32_t > * fp = &morganFp;
     iter=fp->getNonzeroElements().begin();
     // compute fragment score
     double fragmentScore = 0;
     int sumOfFragments = 0;
     while (iter != fp->getNonzeroElements().end()) {
         //std::cout << iter->first << ":" << iter->second << "\n";
-        if (data.find(iter->first) != data.end()) {
-            //std::cout << iter->first << ": " << data[iter->first] << std::endl;
-            fragmentScore+=data[iter->first]*iter->second;
+        const SAScoreFragment *fragment = findFragment(iter->first);
+        if (fragment != NULL) {
+            fragmentScore+=fragment->score*iter->second;
             sumOfFragments+=iter->second;
         } else {
             fragmentScore-=2.95952;
@@ -129,10 +280,6 @@ double SAScore::getScore(RDKit::ROMol& mol)
     //double macroCyclePenalty = log10(macroCycleCount);
     double ringComplexityPenalty = log10(bridgeAtomCount) + log10(spiroAtomCount);
 
-    // release data
-    delete fp;
-    fp = 0;    
-    
     if (macroCycleCount>1) {
         // some bigger value than max allowed score (6)
         
@@ -145,7 +292,11 @@ double SAScore::getScore(RDKit::ROMol& mol)
 
 SAScore::~SAScore()
 {
-    data.clear();
+    fragments = NULL;
+    fragmentCount = 0;
+    table.clear();
+    delete mappedRegion;
+    delete mappedFile;
 }
 
 SAScore* SAScore::destroyInstance()
@@ -17,9 +17,25 @@
 
 #pragma once
 
-#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include <GraphMol/GraphMol.h>
+#include <DataStructs/SparseIntVect.h>
+
+/*
+ Layout of one record of the fragment table, SAScore.bin is a header
+ followed by these records sorted by id, so it can be mapped directly.
+ */
+struct SAScoreFragment {
+    boost::uint32_t id;
+    boost::uint32_t reserved;
+    double score;
+};
 
 class SAScore {
 public:
@@ -27,7 +43,17 @@ public:
     static SAScore* destroyInstance();
     virtual ~SAScore();
     double getScore(RDKit::ROMol &mol);
+    /*
+     Same as above with radius 2 Morgan fragments (bond types, no chirality,
+     no counts) of the molecule already computed by the caller.
+     */
+    double getScore(RDKit::ROMol &mol, const RDKit::SparseIntVect<boost::uint32_t> &morganFp);
     static void loadData();
+    /*
+     Convert text table (SAScore.dat) into binary one (SAScore.bin)
+     that can be memory-mapped by loadData.
+     */
+    static void convertData(const std::string &datFile, const std::string &binFile);
 
 private:
 
@@ -37,7 +63,16 @@ private:
     // your singleton appearing.
     SAScore(const SAScore& orig);  // don't implement
     void operator=(SAScore const&);  // don't implement
-    std::map<unsigned int, double> data;
+    static void readText(const std::string &datFile, std::vector<SAScoreFragment> &table);
+    bool mapBinary(const std::string &binFile);
+    const SAScoreFragment *findFragment(boost::uint32_t id) const;
+
+    // fragment table sorted by id, points either to table or to mapped file
+    const SAScoreFragment *fragments;
+    size_t fragmentCount;
+    std::vector<SAScoreFragment> table;
+    boost::interprocess::file_mapping *mappedFile;
+    boost::interprocess::mapped_region *mappedRegion;
 
     static SAScore * instance;
 };
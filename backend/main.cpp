@@ -36,6 +36,7 @@
 #include "core/NeighborhoodTaskQueue.h"
 #include "BackendCommunicator.h"
 #include "tests/MorphingTest.h"
+#include "tests/Benchmark.h"
 // syntetize feasibility
 #include "extensions/SAScore.h"
 
@@ -58,6 +59,7 @@ void Run(int argc, char *argv[])
         ("job-list,L", boost::program_options::value<std::string>(), "Path to the job list file")
         ("interactive,I", boost::program_options::value<bool>(), "Enable/disable interactive mode")
         ("threads,T", boost::program_options::value<int>(), "Limit number of worker threads")
+        ("sascore-bin", "Convert SAScore.dat into memory-mappable SAScore.bin and exit")
             ;
 
     boost::program_options::variables_map varMap;
@@ -104,6 +106,18 @@ void Run(int argc, char *argv[])
         return;
     }
 
+    if (varMap.count("sascore-bin")) {
+        try {
+            SAScore::convertData("SAScore.dat", "SAScore.bin");
+            std::cout << "SAScore.dat converted into SAScore.bin" << std::endl;
+        } catch (std::exception &exc) {
+            std::cout << "SAScore.dat not converted: " << exc.what() << std::endl;
+        }
+        return;
+    }
+
+    SAScore::loadData(); // load data for prediction of synthetic feasibility
+
     // Default parameter values.
     std::string storagePath("Results");
     std::string jobListFile;
@@ -183,6 +197,10 @@ int main(int argc, char *argv[])
     return 0;
 #endif
 
+#if MOLPHER_BENCH_MODE == 1
+    return MolpherBench(argc, argv);
+#endif
+
 #if RDKIT_LOGGING == 0
     boost::logging::disable_logs("rdApp.*");
 #endif
@@ -196,8 +214,6 @@ int main(int argc, char *argv[])
     std::cout << "Copyright (c) 2012 Vladimir Fiklik, Petr Koupy, Peter Szepe" << std::endl;
     std::cout << "          (c) 2013 Petr Skoda" << std::endl;    
     
-    SAScore::loadData(); // load data for prediction of synthetic feasibility   
-    
     RCF::init();
     Run(argc, argv);
     
@@ -0,0 +1,1621 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+#include <cassert>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <map>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/tick_count.h>
+#include <tbb/concurrent_vector.h>
+#include <tbb/concurrent_hash_map.h>
+#include <tbb/task.h>
+
+#include <GraphMol/GraphMol.h>
+#include <GraphMol/MolOps.h>
+#include <GraphMol/MolPickler.h>
+#include <GraphMol/SmilesParse/SmilesParse.h>
+#include <GraphMol/SmilesParse/SmilesWrite.h>
+#include <GraphMol/Descriptors/MolDescriptors.h>
+
+#include "inout.h"
+#include "MolpherMolecule.h"
+#include "fingerprint_selectors.h"
+#include "simcoeff_selectors.h"
+#include "chem/SimCoefCalculator.hpp"
+#include "chem/fingerprintStrategy/MorganFngpr.hpp"
+#include "extensions/SAScore.h"
+#include "chem/morphing/MorphingData.h"
+#include "chem/morphing/Morphing.hpp"
+#include "chem/morphing/RWMolPool.hpp"
+#include "chem/morphing/RandomWalk.hpp"
+#include "chem/MolpherGraph.hpp"
+#include "chem/FoldedScreen.hpp"
+#include "core/PathFinder.h"
+#include "core/PathFinderContext.h"
+#include "coord/PcaReducer.h"
+#include "coord/KamadaKawaiReducer.h"
+#include "coord/TriangularMatrix.h"
+#include "chemoper_selectors.h"
+#include "Version.hpp"
+#include "Benchmark.h"
+
+static tbb::atomic<unsigned long> gAllocationCount;
+
+#if MOLPHER_BENCH_MODE == 1
+// count heap allocations of the whole process, reported per operation
+void *operator new(std::size_t size) throw(std::bad_alloc)
+{
+    ++gAllocationCount;
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) throw()
+{
+    std::free(ptr);
+}
+#endif
+
+struct BenchResult
+{
+    BenchResult(const std::string &group, const std::string &name) :
+        group(group), name(name), ops(0), seconds(0.0), allocations(0)
+    {
+    }
+
+    std::string group;
+    std::string name;
+    std::vector<double> samples; // ns/op of individual samples
+    unsigned long ops;
+    double seconds;
+    unsigned long allocations;
+};
+
+/**
+ * Collects samples of one benchmark. Each sample times one repetition
+ * over all input molecules, so percentiles are taken over repetitions
+ * and a batch of operations hides the timer resolution.
+ */
+class BenchRecorder
+{
+public:
+    BenchRecorder(BenchResult &result) :
+        mResult(result), mOps(0)
+    {
+    }
+
+    void Start(unsigned long ops)
+    {
+        mOps = ops;
+        mAllocations = gAllocationCount;
+        mStart = tbb::tick_count::now();
+    }
+
+    /**
+     * Stops the sample with the number of operations actually done
+     * instead of the one given to Start.
+     */
+    void Stop(unsigned long ops)
+    {
+        mOps = ops;
+        Stop();
+    }
+
+    void Stop()
+    {
+        double seconds = (tbb::tick_count::now() - mStart).seconds();
+        unsigned long allocations = gAllocationCount - mAllocations;
+        if (mOps > 0) {
+            mResult.samples.push_back(seconds * 1e9 / mOps);
+            mResult.ops += mOps;
+            mResult.seconds += seconds;
+            mResult.allocations += allocations;
+        }
+    }
+
+private:
+    BenchResult &mResult;
+    tbb::tick_count mStart;
+    unsigned long mOps;
+    unsigned long mAllocations;
+};
+
+static double Percentile(std::vector<double> samples, double fraction)
+{
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    // nearest-rank percentile
+    size_t rank = static_cast<size_t>(fraction * samples.size() + 0.5);
+    if (rank > 0) {
+        --rank;
+    }
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+static void BenchFingerprints(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    for (int i = 0; i <= FP_MORGAN_COUNTS; ++i) {
+        FingerprintSelector fp = static_cast<FingerprintSelector>(i);
+        // extended fingerprints need source and target
+        SimCoefCalculator scCalc(SC_TANIMOTO, fp, mols.front(), mols.back());
+
+        results.push_back(BenchResult("fingerprint", FingerprintShortDesc(fp)));
+        BenchRecorder recorder(results.back());
+        for (int j = 0; j < repeat; ++j) {
+            recorder.Start(mols.size());
+            for (size_t m = 0; m < mols.size(); ++m) {
+                if (scCalc.IsSparse()) {
+                    delete scCalc.GetSparseFingerprint(mols[m]);
+                } else {
+                    delete scCalc.GetFingerprint(mols[m]);
+                }
+            }
+            recorder.Stop();
+        }
+    }
+}
+
+static void BenchSimCoefs(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    for (int i = 0; i <= SC_TVERSKY_SUPERSTRUCTURE; ++i) {
+        SimCoeffSelector sc = static_cast<SimCoeffSelector>(i);
+        SimCoefCalculator scCalc(sc, FP_MORGAN);
+        SimCoefCalculator sparseCalc(sc, FP_MORGAN_COUNTS);
+
+        std::vector<Fingerprint *> fps;
+        std::vector<SparseFingerprint *> sparseFps;
+        for (size_t m = 0; m < mols.size(); ++m) {
+            fps.push_back(scCalc.GetFingerprint(mols[m]));
+            sparseFps.push_back(sparseCalc.GetSparseFingerprint(mols[m]));
+        }
+
+        results.push_back(BenchResult("simcoef", SimCoeffShortDesc(sc)));
+        BenchRecorder recorder(results.back());
+        for (int j = 0; j < repeat; ++j) {
+            recorder.Start(fps.size() * fps.size());
+            for (size_t m = 0; m < fps.size(); ++m) {
+                for (size_t n = 0; n < fps.size(); ++n) {
+                    scCalc.GetSimCoef(fps[m], fps[n]);
+                }
+            }
+            recorder.Stop();
+        }
+
+        results.push_back(BenchResult("simcoef-sparse", SimCoeffShortDesc(sc)));
+        BenchRecorder sparseRecorder(results.back());
+        for (int j = 0; j < repeat; ++j) {
+            sparseRecorder.Start(sparseFps.size() * sparseFps.size());
+            for (size_t m = 0; m < sparseFps.size(); ++m) {
+                for (size_t n = 0; n < sparseFps.size(); ++n) {
+                    sparseCalc.GetSimCoef(sparseFps[m], sparseFps[n]);
+                }
+            }
+            sparseRecorder.Stop();
+        }
+
+        for (size_t m = 0; m < mols.size(); ++m) {
+            delete fps[m];
+            delete sparseFps[m];
+        }
+    }
+}
+
+static void BenchMorganSAScore(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    try {
+        SAScore::loadData();
+    } catch (std::exception &exc) {
+        std::cout << exc.what() << ", skipping SAScore benchmark." << std::endl;
+        return;
+    }
+    SAScore *sascore = SAScore::getInstance();
+    MorganFngpr morgan;
+    // radius 2, bond types, no chirality
+    MorganFngpr sharing(2, 2048, 0, 0, false, true);
+    assert(sharing.SharesSAScoreEnvironments());
+
+    // SAScore and FP_MORGAN each computing their own environments
+    results.push_back(BenchResult("morgan+sascore", "separate"));
+    BenchRecorder separateRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        separateRecorder.Start(mols.size());
+        for (size_t m = 0; m < mols.size(); ++m) {
+            sascore->getScore(*mols[m]);
+            delete morgan.GetFingerprint(mols[m]);
+        }
+        separateRecorder.Stop();
+    }
+
+    // one pass shared as in GenerateMorphs with SAScore-compatible settings
+    results.push_back(BenchResult("morgan+sascore", "shared"));
+    BenchRecorder sharedRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        sharedRecorder.Start(mols.size());
+        for (size_t m = 0; m < mols.size(); ++m) {
+            MorganFngpr::Environments *envs = sharing.GetEnvironments(mols[m]);
+            sascore->getScore(*mols[m], *envs);
+            delete sharing.Fold(*envs);
+            delete envs;
+        }
+        sharedRecorder.Stop();
+    }
+
+    SAScore::destroyInstance();
+}
+
+static void BenchMorphingData(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    // large molecules only, the candidate enumeration matters there
+    std::vector<RDKit::RWMol *> large;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        if (mols[m]->getNumHeavyAtoms() > 60) {
+            large.push_back(mols[m]);
+        }
+    }
+    // chain of para-linked benzene rings (73 heavy atoms)
+    std::string smile;
+    for (int k = 0; k < 12; ++k) {
+        smile += "c1ccc(cc1)";
+    }
+    smile += "C";
+    RDKit::RWMol *chain = RDKit::SmilesToMol(smile);
+    if (chain) {
+        RDKit::MolOps::Kekulize(*chain);
+        large.push_back(chain);
+    }
+
+    std::vector<ChemOperSelector> opers;
+    for (int i = OP_ADD_ATOM; i <= OP_BOND_CONTRACTION; ++i) {
+        opers.push_back(static_cast<ChemOperSelector>(i));
+    }
+
+    for (size_t o = 0; o < opers.size(); ++o) {
+        results.push_back(BenchResult("morphing-data", ChemOperShortDesc(opers[o])));
+        BenchRecorder recorder(results.back());
+        for (int j = 0; j < repeat; ++j) {
+            recorder.Start(large.size());
+            for (size_t m = 0; m < large.size(); ++m) {
+                MorphingData data(*large[m], *large[m], opers);
+                data.Prepare(opers[o]);
+            }
+            recorder.Stop();
+        }
+    }
+
+    delete chain;
+}
+
+static void IgnoreMorph(MolpherMolecule *morph, void *state)
+{
+    // no-op
+}
+
+static void BenchGenerateMorphs(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    try {
+        SAScore::loadData();
+    } catch (std::exception &exc) {
+        std::cout << exc.what() << ", skipping GenerateMorphs benchmark." << std::endl;
+        return;
+    }
+
+    std::vector<ChemOperSelector> opers;
+    for (int i = OP_ADD_ATOM; i <= OP_BOND_CONTRACTION; ++i) {
+        opers.push_back(static_cast<ChemOperSelector>(i));
+    }
+    std::string targetSmile = RDKit::MolToSmiles(*mols.back());
+    MolpherMolecule target(targetSmile);
+    std::vector<MolpherMolecule> decoys;
+    tbb::task_group_context tbbCtx;
+    const unsigned int morphAttempts = 100;
+
+    std::vector<MolpherMolecule> candidates;
+    for (size_t m = 0; m + 1 < mols.size(); ++m) {
+        std::string smile = RDKit::MolToSmiles(*mols[m]);
+        candidates.push_back(MolpherMolecule(smile));
+    }
+
+    // warm up the workspaces of all threads
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        GenerateMorphs(candidates[c], morphAttempts, FP_MORGAN, SC_TANIMOTO,
+            opers, target, decoys, tbbCtx, NULL, IgnoreMorph);
+    }
+
+    results.push_back(BenchResult("generate-morphs", "morgan"));
+    BenchRecorder recorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        recorder.Start(candidates.size() * morphAttempts);
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            GenerateMorphs(candidates[c], morphAttempts, FP_MORGAN, SC_TANIMOTO,
+                opers, target, decoys, tbbCtx, NULL, IgnoreMorph);
+        }
+        recorder.Stop();
+    }
+
+    SAScore::destroyInstance();
+}
+
+/*
+ Neighborhood walks of depth 3 from every molecule, one operation is one
+ step taken (a walk stops early when no edit succeeds).
+ */
+static void BenchRandomWalk(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    try {
+        SAScore::loadData();
+    } catch (std::exception &exc) {
+        std::cout << exc.what() << ", skipping random walk benchmark." << std::endl;
+        return;
+    }
+
+    std::vector<ChemOperSelector> opers;
+    for (int i = OP_ADD_ATOM; i <= OP_BOND_CONTRACTION; ++i) {
+        opers.push_back(static_cast<ChemOperSelector>(i));
+    }
+    const int depth = 3;
+
+    results.push_back(BenchResult("random-walk", "morgan"));
+    BenchRecorder recorder(results.back());
+    std::vector<MolpherMolecule> origins;
+    std::vector<RandomWalk *> walks;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        origins.push_back(MolpherMolecule(RDKit::MolToSmiles(*mols[m])));
+        walks.push_back(new RandomWalk(FP_MORGAN, SC_TANIMOTO, opers,
+            origins.back()));
+    }
+    MolpherMolecule neighbor;
+    unsigned long attempts = 0;
+    unsigned long steps = 0;
+    for (int j = 0; j < repeat; ++j) {
+        unsigned long sampleSteps = 0;
+        recorder.Start(0);
+        for (size_t m = 0; m < walks.size(); ++m) {
+            if (!walks[m]->Reset(origins[m])) {
+                continue;
+            }
+            for (int d = 0; d < depth && walks[m]->Step(neighbor); ++d) {
+                ++sampleSteps;
+            }
+        }
+        recorder.Stop(sampleSteps);
+        steps += sampleSteps;
+    }
+    for (size_t m = 0; m < walks.size(); ++m) {
+        attempts += walks[m]->GetAttemptCount();
+        delete walks[m];
+    }
+    if (steps > 0) {
+        std::cout << "Random walk edit attempts per step: " <<
+            double(attempts) / steps << std::endl;
+    }
+
+    SAScore::destroyInstance();
+}
+
+typedef tbb::concurrent_vector<MolpherMolecule> BenchMoleculeVector;
+typedef tbb::concurrent_hash_map<std::string, MolpherMolecule> BenchCandidateMap;
+
+/*
+ A morph from ReturnResults through CollectMorphs. The "copy" variant is
+ how the pipeline passed molecules before, "swap" is the current one.
+ */
+static void ReturnMorph(const std::string &smile, const std::string &parentSmile,
+    double distToTarget, bool swap, BenchMoleculeVector &morphs)
+{
+    std::string smileBuffer(smile);
+    std::string formulaBuffer("C");
+    if (swap) {
+        MolpherMolecule result;
+        result.smile.swap(smileBuffer);
+        result.formula.swap(formulaBuffer);
+        result.parentSmile = parentSmile;
+        result.distToTarget = distToTarget;
+        morphs.grow_by(1)->Swap(result);
+    } else {
+        MolpherMolecule result(smileBuffer, formulaBuffer, parentSmile,
+            0, distToTarget, 0.0, 100.0, 3.0);
+        morphs.push_back(result);
+    }
+}
+
+/*
+ A collected morph accepted into the tree by AcceptMorphs.
+ */
+static MolpherMolecule &AcceptMorph(MolpherMolecule &morph, bool swap,
+    BenchCandidateMap &candidates)
+{
+    BenchCandidateMap::accessor ac;
+    candidates.insert(ac, morph.smile);
+    if (swap) {
+        ac->second.Swap(morph);
+    } else {
+        ac->second = morph;
+    }
+    return ac->second;
+}
+
+/*
+ One morph from ReturnResults through CollectMorphs to AcceptMorphs, then
+ the accepted molecule is picked up as a leaf by FindLeaves.
+ */
+static void PassMorph(const std::string &smile, const std::string &parentSmile,
+    const std::set<std::string> &history, bool swap,
+    BenchMoleculeVector &morphs, BenchCandidateMap &candidates,
+    std::vector<MolpherMolecule> &copiedLeaves,
+    std::vector<MolpherMolecule *> &leaves)
+{
+    ReturnMorph(smile, parentSmile, 0.5, swap, morphs);
+    MolpherMolecule &accepted = AcceptMorph(morphs.back(), swap, candidates);
+    // descendants accepted and pruned in later iterations
+    accepted.historicDescendants = history;
+    if (swap) {
+        leaves.push_back(&accepted);
+    } else {
+        copiedLeaves.push_back(accepted);
+    }
+}
+
+/*
+ One iteration of the TestFiles job with the default parameters. The
+ leaves are picked up from the tree, each of them gets cntMorphs morphs,
+ the morphs are sorted and the best cntCandidatesToKeep are accepted as
+ the leaves of the next iteration. Morphing itself is left out.
+ */
+static void PassIteration(BenchCandidateMap &candidates, bool swap)
+{
+    MolpherParam params;
+    std::vector<MolpherMolecule> copiedLeaves;
+    std::vector<MolpherMolecule *> leaves;
+    for (BenchCandidateMap::iterator it = candidates.begin();
+            it != candidates.end(); ++it) {
+        if (it->second.descendants.empty()) {
+            if (swap) {
+                leaves.push_back(&it->second);
+            } else {
+                copiedLeaves.push_back(it->second);
+            }
+        }
+    }
+    size_t leafCount = swap ? leaves.size() : copiedLeaves.size();
+
+    BenchMoleculeVector morphs;
+    unsigned int seed = 42;
+    for (size_t l = 0; l < leafCount; ++l) {
+        const std::string &parent =
+            swap ? leaves[l]->smile : copiedLeaves[l].smile;
+        for (unsigned int k = 0; k < params.cntMorphs; ++k) {
+            std::ostringstream smile;
+            smile << parent << "." << k;
+            seed = seed * 1103515245 + 12345;
+            ReturnMorph(smile.str(), parent, ((seed >> 16) & 0x7fff) / 32768.0,
+                swap, morphs);
+        }
+    }
+    std::sort(morphs.begin(), morphs.end(), PathFinder::CompareMorphs());
+
+    size_t accepted = std::min<size_t>(morphs.size(), params.cntCandidatesToKeep);
+    for (size_t idx = 0; idx < accepted; ++idx) {
+        BenchCandidateMap::accessor ac;
+        candidates.find(ac, morphs[idx].parentSmile);
+        ac->second.descendants.insert(morphs[idx].smile);
+        ac.release();
+        AcceptMorph(morphs[idx], swap, candidates);
+    }
+}
+
+static void BenchMorphPipeline(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    std::vector<std::string> smiles;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        smiles.push_back(RDKit::MolToSmiles(*mols[m]));
+    }
+    // leaves carry the SMILES of their former descendants
+    std::set<std::string> history(smiles.begin(),
+        smiles.begin() + std::min<size_t>(smiles.size(), 8));
+
+    for (int variant = 0; variant < 2; ++variant) {
+        bool swap = (variant == 1);
+        results.push_back(BenchResult("morph-pipeline", swap ? "swap" : "copy"));
+        BenchRecorder recorder(results.back());
+        for (size_t m = 0; m < smiles.size(); ++m) {
+            BenchMoleculeVector morphs;
+            BenchCandidateMap candidates;
+            std::vector<MolpherMolecule> copiedLeaves;
+            std::vector<MolpherMolecule *> leaves;
+            morphs.reserve(repeat);
+            copiedLeaves.reserve(repeat);
+            leaves.reserve(repeat);
+
+            for (int j = 0; j < repeat; ++j) {
+                std::ostringstream smile;
+                smile << smiles[m] << "." << j;
+                recorder.Start(1);
+                PassMorph(smile.str(), smiles[m], history, swap, morphs,
+                    candidates, copiedLeaves, leaves);
+                recorder.Stop();
+            }
+        }
+    }
+
+    // a tree of the source and one generation of leaves, each leaf
+    // remembering its pruned descendants
+    MolpherParam params;
+    for (int variant = 0; variant < 2; ++variant) {
+        bool swap = (variant == 1);
+        results.push_back(BenchResult("morph-iteration", swap ? "swap" : "copy"));
+        BenchRecorder recorder(results.back());
+        for (int j = 0; j < repeat; ++j) {
+            BenchCandidateMap candidates;
+            MolpherMolecule source(smiles[0]);
+            for (unsigned int l = 0; l < params.cntCandidatesToKeep; ++l) {
+                std::ostringstream smile;
+                smile << smiles[l % smiles.size()] << "." << l;
+                source.descendants.insert(smile.str());
+                BenchCandidateMap::accessor ac;
+                candidates.insert(ac, smile.str());
+                ac->second.smile = smile.str();
+                ac->second.parentSmile = source.smile;
+                ac->second.historicDescendants = history;
+            }
+            candidates.insert(std::make_pair(source.smile, source));
+            recorder.Start(1);
+            PassIteration(candidates, swap);
+            recorder.Stop();
+        }
+    }
+}
+
+static void BenchDeduplication(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    std::vector<MolpherGraph> graphs;
+    graphs.reserve(mols.size());
+    for (size_t m = 0; m < mols.size(); ++m) {
+        graphs.push_back(MolpherGraph(*mols[m]));
+    }
+
+    // what CalculateMorphs pays to recognize a duplicate morph
+    results.push_back(BenchResult("deduplication", "graph-hash"));
+    BenchRecorder hashRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        hashRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            bool discrete;
+            graphs[m].GetCanonicalHash(&discrete);
+        }
+        hashRecorder.Stop();
+    }
+
+    // buffers reused as by CalculateMorphs, allocs/op should be 0
+    std::string key;
+    std::vector<boost::uint64_t> bondKeys;
+    results.push_back(BenchResult("deduplication", "graph-key"));
+    BenchRecorder keyRecorder(results.back());
+    for (size_t m = 0; m < graphs.size(); ++m) {
+        graphs[m].GetKey(key, bondKeys); // warm up the buffers
+    }
+    for (int j = 0; j < repeat; ++j) {
+        keyRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            graphs[m].GetKey(key, bondKeys);
+        }
+        keyRecorder.Stop();
+    }
+
+    MolpherGraph scratch;
+    results.push_back(BenchResult("deduplication", "graph-copy"));
+    BenchRecorder copyRecorder(results.back());
+    for (size_t m = 0; m < graphs.size(); ++m) {
+        scratch = graphs[m]; // warm up the buffers
+    }
+    for (int j = 0; j < repeat; ++j) {
+        copyRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            scratch = graphs[m];
+        }
+        copyRecorder.Stop();
+    }
+
+    // conversion up to the canonical SMILES, saved for dropped duplicates
+    results.push_back(BenchResult("deduplication", "smiles"));
+    BenchRecorder smilesRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        smilesRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            RDKit::RWMol *mol = graphs[m].ToRWMol();
+            try {
+                RDKit::MolOps::cleanUp(*mol);
+                mol->updatePropertyCache();
+                RDKit::MolOps::Kekulize(*mol);
+                RDKit::MolToSmiles(*mol);
+            } catch (const std::exception &exc) {
+                // same cost as in CalculateMorphs
+            }
+            delete mol;
+        }
+        smilesRecorder.Stop();
+    }
+}
+
+static void BenchStructureCheck(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    std::vector<MolpherGraph> graphs;
+    graphs.reserve(mols.size());
+    for (size_t m = 0; m < mols.size(); ++m) {
+        graphs.push_back(MolpherGraph(*mols[m]));
+    }
+
+    // pre-check of every morph, valid graphs go through all checks
+    results.push_back(BenchResult("structure-check", "find-defect"));
+    BenchRecorder defectRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        defectRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            graphs[m].FindDefect();
+        }
+        defectRecorder.Stop();
+    }
+
+    // what a rejected morph would have cost without the pre-check
+    results.push_back(BenchResult("structure-check", "sanitize"));
+    BenchRecorder sanitizeRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        sanitizeRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            RDKit::RWMol *mol = graphs[m].ToRWMol();
+            try {
+                RDKit::MolOps::cleanUp(*mol);
+                mol->updatePropertyCache();
+                RDKit::MolOps::Kekulize(*mol);
+            } catch (const std::exception &exc) {
+                // same cost as in CalculateMorphs
+            }
+            delete mol;
+        }
+        sanitizeRecorder.Stop();
+    }
+}
+
+static void BenchMolPool(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    std::vector<MolpherGraph> graphs;
+    graphs.reserve(mols.size());
+    for (size_t m = 0; m < mols.size(); ++m) {
+        graphs.push_back(MolpherGraph(*mols[m]));
+    }
+
+    // building the morph molecule as CalculateMorphs did before the pool
+    results.push_back(BenchResult("rwmol", "new-delete"));
+    BenchRecorder newRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        newRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            delete graphs[m].ToRWMol();
+        }
+        newRecorder.Stop();
+    }
+
+    // same as new-delete when built with MORPHING_MOL_POOL=0
+    results.push_back(BenchResult("rwmol", "pool"));
+    BenchRecorder poolRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        poolRecorder.Start(graphs.size());
+        for (size_t m = 0; m < graphs.size(); ++m) {
+            RWMolPool::Release(graphs[m].ToRWMol(RWMolPool::Acquire()));
+        }
+        poolRecorder.Stop();
+    }
+}
+
+static void BenchSerialization(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    results.push_back(BenchResult("serialization", "pickle"));
+    BenchRecorder pickleRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        pickleRecorder.Start(mols.size());
+        for (size_t m = 0; m < mols.size(); ++m) {
+            std::string pickle;
+            RDKit::MolPickler::pickleMol(*mols[m], pickle);
+            RDKit::ROMol *molecule = new RDKit::ROMol();
+            RDKit::MolPickler::molFromPickle(pickle, molecule);
+            delete molecule;
+        }
+        pickleRecorder.Stop();
+    }
+
+    results.push_back(BenchResult("serialization", "smiles"));
+    BenchRecorder smilesRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        smilesRecorder.Start(mols.size());
+        for (size_t m = 0; m < mols.size(); ++m) {
+            std::string smile = RDKit::MolToSmiles(*mols[m]);
+            delete RDKit::SmilesToMol(smile);
+        }
+        smilesRecorder.Stop();
+    }
+
+    results.push_back(BenchResult("serialization", "molecule-bin"));
+    BenchRecorder binRecorder(results.back());
+    std::vector<MolpherMolecule> molecules;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        std::string smile = RDKit::MolToSmiles(*mols[m]);
+        std::string formula = RDKit::Descriptors::calcMolFormula(*mols[m]);
+        molecules.push_back(MolpherMolecule(smile, formula));
+    }
+    for (int j = 0; j < repeat; ++j) {
+        binRecorder.Start(molecules.size());
+        for (size_t m = 0; m < molecules.size(); ++m) {
+            std::stringstream binStream(
+                std::ios_base::out | std::ios_base::in | std::ios_base::binary);
+            {
+                boost::archive::binary_oarchive binOutArchive(binStream);
+                binOutArchive << molecules[m];
+            }
+            MolpherMolecule restored;
+            boost::archive::binary_iarchive binInArchive(binStream);
+            binInArchive >> restored;
+        }
+        binRecorder.Stop();
+    }
+}
+
+static void BenchDictionary(std::vector<RDKit::RWMol *> &mols,
+    int repeat, std::vector<BenchResult> &results)
+{
+    std::vector<std::string> data;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        data.push_back(RDKit::MolToSmiles(*mols[m]));
+    }
+
+    results.push_back(BenchResult("dictionary", "copy"));
+    BenchRecorder copyRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        copyRecorder.Start(data.size());
+        std::vector<std::string> copy;
+        copy = data;
+        copyRecorder.Stop();
+    }
+
+    results.push_back(BenchResult("dictionary", "text"));
+    BenchRecorder txtRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        txtRecorder.Start(data.size());
+        std::stringstream txtStream(std::ios_base::out | std::ios_base::in);
+        {
+            boost::archive::text_oarchive txtOutArchive(txtStream);
+            txtOutArchive << data;
+        }
+        std::vector<std::string> restored;
+        boost::archive::text_iarchive txtInArchive(txtStream);
+        txtInArchive >> restored;
+        txtRecorder.Stop();
+    }
+
+    results.push_back(BenchResult("dictionary", "bin"));
+    BenchRecorder binRecorder(results.back());
+    for (int j = 0; j < repeat; ++j) {
+        binRecorder.Start(data.size());
+        std::stringstream binStream(
+            std::ios_base::out | std::ios_base::in | std::ios_base::binary);
+        {
+            boost::archive::binary_oarchive binOutArchive(binStream);
+            binOutArchive << data;
+        }
+        std::vector<std::string> restored;
+        boost::archive::binary_iarchive binInArchive(binStream);
+        binInArchive >> restored;
+        binRecorder.Stop();
+    }
+}
+
+/*
+ Centered points with a known covariance spectrum: the first two eigen
+ values differ by 2 % (slow for power iteration), the rest decay from half
+ of the first. The points are stored as rows like the coordinates in
+ PcaReducer::Reduce, so 1M of them take 512 MB.
+ */
+static void PcaTestPoints(size_t pointCount, size_t dimension,
+    std::vector<double> &points, std::vector<double> &spectrum)
+{
+    unsigned int seed = 42;
+    spectrum.resize(dimension);
+    for (size_t i = 0; i < dimension; ++i) {
+        spectrum[i] = (i == 0) ? 1.0 : (i == 1) ? 0.98 :
+            0.5 * std::pow(0.9, (double) i);
+    }
+
+    // random orthonormal rotation
+    std::vector<double> rotation(dimension * dimension);
+    for (size_t i = 0; i < rotation.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        rotation[i] = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+    }
+    for (size_t k = 0; k < dimension; ++k) {
+        double *v = &rotation[k * dimension];
+        for (size_t j = 0; j < k; ++j) {
+            double *u = &rotation[j * dimension];
+            double dot = 0;
+            for (size_t i = 0; i < dimension; ++i) {
+                dot += u[i] * v[i];
+            }
+            for (size_t i = 0; i < dimension; ++i) {
+                v[i] -= dot * u[i];
+            }
+        }
+        double norm = 0;
+        for (size_t i = 0; i < dimension; ++i) {
+            norm += v[i] * v[i];
+        }
+        for (size_t i = 0; i < dimension; ++i) {
+            v[i] /= std::sqrt(norm);
+        }
+    }
+
+    points.assign(pointCount * dimension, 0.0);
+    std::vector<double> latent(dimension);
+    std::vector<double> mean(dimension, 0.0);
+    for (size_t p = 0; p < pointCount; ++p) {
+        for (size_t i = 0; i < dimension; ++i) {
+            // uniform with the variance of the spectrum
+            seed = seed * 1103515245 + 12345;
+            double u = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+            latent[i] = u * std::sqrt(12 * spectrum[i]);
+        }
+        double *point = &points[p * dimension];
+        for (size_t i = 0; i < dimension; ++i) {
+            for (size_t k = 0; k < dimension; ++k) {
+                point[i] += rotation[k * dimension + i] * latent[k];
+            }
+            mean[i] += point[i];
+        }
+    }
+    for (size_t p = 0; p < pointCount; ++p) {
+        for (size_t i = 0; i < dimension; ++i) {
+            points[p * dimension + i] -= mean[i] / pointCount;
+        }
+    }
+}
+
+/*
+ The part of PcaReducer::Reduce that grows with the number of molecules
+ once their coordinates are known: the covariance matrix and its top two
+ eigen vectors. One operation is the covariance alone (covariance-N) or
+ the covariance followed by one solve (power-N, subspace-N). Quality is
+ reported as the residuals and the variance captured relative to the
+ spectrum the points were drawn from. The 1M points (512 MB) only with
+ large.
+ */
+static void BenchPcaEigen(int repeat, bool large,
+    std::vector<BenchResult> &results)
+{
+    // coordinates of a 2048 bit fingerprint (see PcaReducer::Reduce)
+    const size_t dimension = 64;
+    const size_t pointCounts[] = { 10000, 100000, 1000000 };
+    tbb::task_group_context tbbCtx;
+    std::vector<double> covariance(dimension * dimension);
+    std::vector<double> first(dimension);
+    std::vector<double> second(dimension);
+
+    for (size_t p = 0; p < (large ? 3 : 2); ++p) {
+        std::vector<double> points;
+        std::vector<double> spectrum;
+        PcaTestPoints(pointCounts[p], dimension, points, spectrum);
+        // keep the samples of the large sets affordable
+        int samples = std::max(1, std::min(repeat,
+            (int) (1000000 / pointCounts[p])));
+
+        for (int solver = -1; solver < 2; ++solver) {
+            std::ostringstream name;
+            name << (solver == -1 ? "covariance-" :
+                solver == 0 ? "power-" : "subspace-") << pointCounts[p];
+            results.push_back(BenchResult("pca-eigen", name.str()));
+            BenchRecorder recorder(results.back());
+            PcaReducer::EigenSolution solution;
+            for (int j = 0; j < samples; ++j) {
+                recorder.Start(1);
+                PcaReducer::CalculateCovariance(&points[0], pointCounts[p],
+                    dimension, &covariance[0], tbbCtx);
+                if (solver == 0) {
+                    PcaReducer::PowerIteration(&covariance[0], dimension,
+                        &first[0], &second[0], solution);
+                } else if (solver == 1) {
+                    PcaReducer::FindEigenVectors(&covariance[0], dimension,
+                        &first[0], &second[0], solution, tbbCtx);
+                }
+                recorder.Stop();
+            }
+            if (solver == -1) {
+                continue;
+            }
+            std::cout << "pca-eigen " << name.str() << ": " <<
+                solution.iterations << " iterations, residuals " <<
+                solution.residuals[0] << ", " << solution.residuals[1] <<
+                ", captured variance " <<
+                (solution.values[0] + solution.values[1]) /
+                    (spectrum[0] + spectrum[1]) << std::endl;
+        }
+    }
+}
+
+/*
+ Kamada-Kawai energy of the layout normalized by the number of pairs, the
+ springs have the rest length of KAMADAKAWAIREDUCER_SEPARATION times the
+ distance.
+ */
+static double KamadaKawaiStress(const std::vector<MolpherMolecule> &mols,
+    const TriangularMatrix &dist)
+{
+    double stress = 0;
+    for (size_t i = 1; i < mols.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            double distance = dist.Get(i, j);
+            if (distance <= 0) {
+                continue;
+            }
+            double dx = mols[i].posX - mols[j].posX;
+            double dy = mols[i].posY - mols[j].posY;
+            double error = std::sqrt(dx * dx + dy * dy) -
+                KAMADAKAWAIREDUCER_SEPARATION * distance;
+            stress += (error * error) / (distance * distance);
+        }
+    }
+    return stress / ((mols.size() * (mols.size() - 1)) / 2);
+}
+
+/*
+ Distances and layout of the fingerprints timed as one operation of
+ reduceName, the distances alone as distName with one operation per pair.
+ Without layout only the distances are timed. Each sample starts from
+ scratch with a new reducer.
+ */
+static void BenchKamadaKawaiLayout(bool incremental, bool layout,
+    int samples, SimCoefCalculator &scCalc, std::vector<Fingerprint *> &fps,
+    const std::string &distName, const std::string &reduceName,
+    std::vector<BenchResult> &results)
+{
+    results.push_back(BenchResult("kk-scale", distName));
+    if (layout) {
+        results.push_back(BenchResult("kk-scale", reduceName));
+    }
+    // all pushed first, the recorders keep references into results
+    BenchRecorder distRecorder(results[results.size() - (layout ? 2 : 1)]);
+    BenchRecorder reduceRecorder(results.back());
+
+    tbb::task_group_context tbbCtx;
+    for (int j = 0; j < samples; ++j) {
+        std::vector<MolpherMolecule> mols(fps.size());
+        DimensionReducer::MolPtrVector molPtrs;
+        for (size_t i = 0; i < mols.size(); ++i) {
+            molPtrs.push_back(&mols[i]);
+        }
+
+        TriangularMatrix dist;
+        KamadaKawaiReducer reducer(incremental);
+        if (layout) {
+            reduceRecorder.Start(1);
+        }
+        distRecorder.Start((fps.size() * (fps.size() - 1)) / 2);
+        KamadaKawaiReducer::CalculateDistanceMatrix(scCalc, fps, dist, tbbCtx);
+        distRecorder.Stop();
+        if (!layout) {
+            continue;
+        }
+        reducer.Layout(molPtrs, dist, tbbCtx);
+        reduceRecorder.Stop();
+
+        if (j + 1 == samples) {
+            std::cout << "kk-scale " << reduceName << ": stress " <<
+                KamadaKawaiStress(mols, dist) << ", gradient drift " <<
+                reducer.GetGradientDrift() << ", distances " <<
+                dist.GetByteSize() / 1048576.0 << " MB" << std::endl;
+        }
+    }
+}
+
+/*
+ Kamada-Kawai reduction of 200 to 5k molecules, 10k only times the
+ distances unless large, which adds the 10k layout and 50k (the distances
+ alone take 5 GB there). One operation is one reduction without the
+ fingerprints (dist-N times only the distance matrix, one operation per
+ pair). The 200 case is repeated with all gradients recalculated after
+ every step (reduce-full-200), large adds reduce-full-1000 that takes
+ minutes. The fingerprints are copies of the ones of the input with a few
+ random bits flipped, so that they are not parsed from SMILES again and
+ the copies do not coincide.
+ */
+static void BenchKamadaKawaiScale(std::vector<RDKit::RWMol *> &mols,
+    int repeat, bool large, std::vector<BenchResult> &results)
+{
+    SimCoefCalculator scCalc(DEFAULT_SC, FP_MORGAN);
+    std::vector<Fingerprint *> inputFps;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        inputFps.push_back(scCalc.GetFingerprint(mols[m]));
+    }
+
+    const size_t molCounts[] = { 200, 1000, 5000, 10000, 50000 };
+    unsigned int seed = 42;
+    for (size_t c = 0; c < (large ? 5 : 4); ++c) {
+        std::vector<Fingerprint *> fps;
+        for (size_t i = 0; i < molCounts[c]; ++i) {
+            Fingerprint *fp = new Fingerprint(*inputFps[i % inputFps.size()]);
+            for (int k = 0; k < 8; ++k) {
+                seed = seed * 1103515245 + 12345;
+                unsigned int bit = (seed >> 8) % fp->getNumBits();
+                if (fp->getBit(bit)) {
+                    fp->unsetBit(bit);
+                } else {
+                    fp->setBit(bit);
+                }
+            }
+            fps.push_back(fp);
+        }
+
+        std::ostringstream suffix;
+        suffix << molCounts[c];
+        // keep the samples of the large sets affordable
+        int samples = std::max(1, std::min(repeat,
+            (int) (5000 / molCounts[c])));
+        bool layout = large || (molCounts[c] < 10000);
+        BenchKamadaKawaiLayout(true, layout, samples, scCalc, fps,
+            "dist-" + suffix.str(), "reduce-" + suffix.str(), results);
+        if ((molCounts[c] == 200) || (large && (molCounts[c] == 1000))) {
+            int fullSamples = std::max(1, std::min(repeat,
+                (int) (1000 / molCounts[c])));
+            BenchKamadaKawaiLayout(false, true, fullSamples, scCalc, fps,
+                "dist-full-" + suffix.str(), "reduce-full-" + suffix.str(),
+                results);
+        }
+
+        for (size_t i = 0; i < fps.size(); ++i) {
+            delete fps[i];
+        }
+    }
+
+    for (size_t m = 0; m < inputFps.size(); ++m) {
+        delete inputFps[m];
+    }
+}
+
+/*
+ Gradients updated by the springs to the moved molecules must match the
+ recalculated ones. A layout of random distances is computed and the
+ largest drift seen by KamadaKawaiReducer is compared with the tolerance.
+ Returns 1 if it is exceeded.
+ */
+static int CheckKamadaKawaiGradients()
+{
+    const size_t molCount = 300;
+    const double tolerance = 1e-6;
+    TriangularMatrix dist;
+    dist.Resize(molCount);
+    unsigned int seed = 42;
+    for (size_t i = 1; i < molCount; ++i) {
+        float *row = dist.GetRow(i);
+        for (size_t j = 0; j < i; ++j) {
+            seed = seed * 1103515245 + 12345;
+            row[j] = 10 + ((seed >> 16) & 0x7fff) / 32768.0 * 90;
+        }
+    }
+
+    std::vector<MolpherMolecule> layout(molCount);
+    DimensionReducer::MolPtrVector layoutPtrs;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        layoutPtrs.push_back(&layout[i]);
+    }
+    tbb::task_group_context tbbCtx;
+    KamadaKawaiReducer reducer;
+    reducer.Layout(layoutPtrs, dist, tbbCtx);
+
+    double drift = reducer.GetGradientDrift();
+    std::cout << "kk-gradients: drift " << drift << " (tolerance " <<
+        tolerance << ")" << std::endl;
+    return drift > tolerance ? 1 : 0;
+}
+
+/*
+ Snapshots saved before the adaptive operator selection and the morphing
+ counters end with prunedDuringThisIter. Such a snapshot is written field
+ by field and must load with the appended fields empty, a current one
+ must keep them. Returns the number of failed loads.
+ */
+static int CheckSnapshotCompatibility()
+{
+    IterationSnapshot snp;
+    snp.jobId = 7;
+    snp.iterIdx = 3;
+    std::string smile("CCO");
+    snp.candidates.insert(std::make_pair(smile, MolpherMolecule(smile)));
+    snp.prunedDuringThisIter.push_back("CCC");
+    snp.chemOperSurvivors.assign(snp.chemOperSelectors.size(), 1.5);
+    snp.iterMorphingStats.opers[OP_ADD_ATOM].attempts = 42;
+
+    int failures = 0;
+    std::stringstream legacy;
+    {
+        boost::archive::text_oarchive oArchive(legacy);
+        oArchive << snp.jobId << snp.iterIdx << snp.elapsedSeconds <<
+            snp.fingerprintSelector << snp.simCoeffSelector <<
+            snp.dimRedSelector << snp.chemOperSelectors << snp.params <<
+            snp.source << snp.target << snp.decoys << snp.candidates <<
+            snp.morphDerivations << snp.prunedDuringThisIter;
+    }
+    try {
+        IterationSnapshot loaded;
+        boost::archive::text_iarchive iArchive(legacy);
+        iArchive >> loaded;
+        if ((loaded.iterIdx != snp.iterIdx) ||
+                (loaded.candidates.size() != 1) ||
+                (loaded.prunedDuringThisIter.size() != 1) ||
+                !loaded.chemOperSurvivors.empty() ||
+                (loaded.iterMorphingStats.opers[OP_ADD_ATOM].attempts != 0)) {
+            ++failures;
+        }
+    } catch (boost::archive::archive_exception &exc) {
+        std::cout << exc.what() << std::endl;
+        ++failures;
+    }
+
+    std::stringstream current;
+    {
+        boost::archive::text_oarchive oArchive(current);
+        oArchive << snp;
+    }
+    try {
+        IterationSnapshot loaded;
+        boost::archive::text_iarchive iArchive(current);
+        iArchive >> loaded;
+        if ((loaded.chemOperSurvivors != snp.chemOperSurvivors) ||
+                (loaded.iterMorphingStats.opers[OP_ADD_ATOM].attempts != 42)) {
+            ++failures;
+        }
+    } catch (boost::archive::archive_exception &exc) {
+        std::cout << exc.what() << std::endl;
+        ++failures;
+    }
+
+    std::cout << "check snapshot compatibility: " << (2 - failures) <<
+        "/2 snapshots loaded" << std::endl;
+    return failures;
+}
+
+/*
+ Once warmed up, GenerateMorphs must not grow its workspaces and the heap
+ allocations of the whole process per morph attempt (RDKit editing,
+ sanitization, SMILES and descriptors, the fingerprints) must stay within
+ the budget. Returns the number of exceeded limits.
+ */
+static int CheckMorphingAllocations(std::vector<RDKit::RWMol *> &mols)
+{
+    // regression guard, a sanitized morph of a drug-like molecule takes
+    // several hundreds of allocations inside RDKit
+    const double budget = 5000.0;
+
+    try {
+        SAScore::loadData();
+    } catch (std::exception &exc) {
+        std::cout << exc.what() << ", skipping morphing allocations check." << std::endl;
+        return 0;
+    }
+
+    std::vector<ChemOperSelector> opers;
+    for (int i = OP_ADD_ATOM; i <= OP_BOND_CONTRACTION; ++i) {
+        opers.push_back(static_cast<ChemOperSelector>(i));
+    }
+    MolpherMolecule target(RDKit::MolToSmiles(*mols.back()));
+    std::vector<MolpherMolecule> decoys;
+    tbb::task_group_context tbbCtx;
+    const unsigned int morphAttempts = 100;
+
+    std::vector<MolpherMolecule> candidates;
+    for (size_t m = 0; m + 1 < mols.size(); ++m) {
+        candidates.push_back(MolpherMolecule(RDKit::MolToSmiles(*mols[m])));
+    }
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        GenerateMorphs(candidates[c], morphAttempts, FP_MORGAN, SC_TANIMOTO,
+            opers, target, decoys, tbbCtx, NULL, IgnoreMorph);
+    }
+
+    unsigned long workspace = GetMorphingWorkspaceAllocations();
+    unsigned long allocations = gAllocationCount;
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        GenerateMorphs(candidates[c], morphAttempts, FP_MORGAN, SC_TANIMOTO,
+            opers, target, decoys, tbbCtx, NULL, IgnoreMorph);
+    }
+    workspace = GetMorphingWorkspaceAllocations() - workspace;
+    double perAttempt = (gAllocationCount - allocations) /
+        static_cast<double>(candidates.size() * morphAttempts);
+    SAScore::destroyInstance();
+
+    std::cout << "check morphing allocations: " << workspace <<
+        " workspace, " << perAttempt << " per attempt (budget " << budget <<
+        ")" << std::endl;
+    return ((workspace > 0) ? 1 : 0) + ((perAttempt > budget) ? 1 : 0);
+}
+
+static void CollectMorph(MolpherMolecule *morph, void *state)
+{
+    static_cast<tbb::concurrent_vector<std::string> *>(state)->push_back(
+        morph->smile);
+}
+
+/*
+ The distance bound of FoldedScreen must not exceed the exact distance.
+ Every input molecule is a reference for all input molecules and for the
+ morphs GenerateMorphs makes of them. Returns the number of pairs where
+ the bound is above the exact distance.
+ */
+static int CheckFoldedScreen(std::vector<RDKit::RWMol *> &mols)
+{
+    bool morphing = true;
+    try {
+        SAScore::loadData();
+    } catch (std::exception &exc) {
+        std::cout << exc.what() << ", checking input molecules only." << std::endl;
+        morphing = false;
+    }
+
+    std::vector<ChemOperSelector> opers;
+    for (int i = OP_ADD_ATOM; i <= OP_BOND_CONTRACTION; ++i) {
+        opers.push_back(static_cast<ChemOperSelector>(i));
+    }
+    MolpherMolecule target(RDKit::MolToSmiles(*mols.back()));
+    std::vector<MolpherMolecule> decoys;
+    tbb::task_group_context tbbCtx;
+    tbb::concurrent_vector<std::string> smiles;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        MolpherMolecule candidate(RDKit::MolToSmiles(*mols[m]));
+        smiles.push_back(candidate.smile);
+        if (morphing) {
+            GenerateMorphs(candidate, 200, FP_MORGAN, SC_TANIMOTO, opers,
+                target, decoys, tbbCtx, &smiles, CollectMorph);
+        }
+    }
+
+    SimCoefCalculator scCalc(SC_TANIMOTO, FP_MORGAN);
+    FoldedScreen screen(FP_MORGAN);
+    std::vector<Fingerprint *> referenceFps;
+    for (size_t m = 0; m < mols.size(); ++m) {
+        referenceFps.push_back(scCalc.GetFingerprint(mols[m]));
+        screen.AddReference(referenceFps.back());
+    }
+
+    int failures = 0;
+    size_t pairs = 0;
+    for (size_t i = 0; i < smiles.size(); ++i) {
+        RDKit::RWMol *mol = RDKit::SmilesToMol(smiles[i]);
+        if (!mol) {
+            continue;
+        }
+        Fingerprint *fp = scCalc.GetFingerprint(mol);
+        Fingerprint *screenFp = screen.GetFingerprint(mol);
+        for (size_t r = 0; r < referenceFps.size(); ++r) {
+            double exact = scCalc.ConvertToDistance(
+                scCalc.GetSimCoef(referenceFps[r], fp));
+            if (screen.GetDistanceLowerBound(screenFp, r) > exact + 1e-9) {
+                ++failures;
+            }
+            ++pairs;
+        }
+        delete screenFp;
+        delete fp;
+        delete mol;
+    }
+    for (size_t r = 0; r < referenceFps.size(); ++r) {
+        delete referenceFps[r];
+    }
+    SAScore::destroyInstance();
+
+    std::cout << "check folded screen: " << pairs - failures << "/" <<
+        pairs << " bounds below the exact distance" << std::endl;
+    return failures;
+}
+
+static std::set<std::string> KeptMorphs(PathFinderContext &ctx,
+    PathFinder::MoleculeVector &morphs, size_t globalMorphCount,
+    std::map<std::string, int> &draws)
+{
+    std::vector<MolpherMolecule> sorted(morphs.begin(), morphs.end());
+    std::sort(sorted.begin(), sorted.end(), PathFinder::CompareMorphs());
+
+    std::set<std::string> kept;
+    for (size_t idx = 0; idx < sorted.size() &&
+            kept.size() < ctx.params.cntCandidatesToKeepMax; ++idx) {
+        double acceptProbability = PathFinder::AcceptProbability(
+            ctx.params, idx, globalMorphCount, false);
+        if ((draws[sorted[idx].smile] < (int) (acceptProbability * 100)) &&
+                PathFinder::MightSurvive(ctx, sorted[idx])) {
+            kept.insert(sorted[idx].smile);
+        }
+    }
+    return kept;
+}
+
+/*
+ Two-tier screening must not change the kept morphs. Morphs with random
+ ratings arrive in leaf batches, before each batch the cutoff is taken
+ from the morphs collected so far (as in PathFinder) and every morph rated
+ above it is screened out, as if its lower bound was exact. Both lists
+ then go through the FilterMorphs and AcceptMorphs rules with the same
+ lottery draw per morph. Returns the number of trials that differ.
+ */
+static int CheckScreening()
+{
+    PathFinderContext ctx;
+    ctx.params.cntCandidatesToKeep = 50;
+    ctx.params.cntCandidatesToKeepMax = 100;
+    ctx.params.minAcceptableMolecularWeight = 100.0;
+    ctx.params.maxAcceptableMolecularWeight = 500.0;
+    ctx.params.useSyntetizedFeasibility = true;
+    MolpherMolecule parent;
+    parent.smile = "P";
+    ctx.candidates.insert(std::make_pair(parent.smile, parent));
+
+    unsigned int seed = 42;
+    int failures = 0;
+    size_t screenedTotal = 0;
+    size_t morphTotal = 0;
+    const int trials = 200;
+    for (int t = 0; t < trials; ++t) {
+        seed = seed * 1103515245 + 12345;
+        size_t morphCount = 500 + (seed >> 8) % 20000;
+        seed = seed * 1103515245 + 12345;
+        size_t batchSize = 100 + (seed >> 8) % 400;
+
+        PathFinder::MoleculeVector all;
+        PathFinder::MoleculeVector collected;
+        std::map<std::string, int> draws;
+        size_t screenedCount = 0;
+        double cutoff = -1.0;
+        for (size_t i = 0; i < morphCount; ++i) {
+            if (i % batchSize == 0) {
+                // next leaf
+                cutoff = PathFinder::KeptRangeCutoff(ctx, collected);
+            }
+
+            MolpherMolecule morph;
+            std::ostringstream smile;
+            smile << "M" << t << "_" << i;
+            morph.smile = smile.str();
+            morph.parentSmile = parent.smile;
+            seed = seed * 1103515245 + 12345;
+            morph.distToTarget = ((seed >> 8) % 1000000) / 1000000.0;
+            morph.distToClosestDecoy = 0.0;
+            seed = seed * 1103515245 + 12345;
+            // a tenth is too heavy, a tenth is hard to synthesize
+            morph.molecularWeight = ((seed >> 8) % 10 == 0) ? 600.0 : 300.0;
+            morph.sascore = ((seed >> 12) % 10 == 0) ? 8.0 : 3.0;
+            seed = seed * 1103515245 + 12345;
+            draws[morph.smile] = (seed >> 8) % 100;
+            if ((seed >> 16) % 10 == 0) {
+                // a tenth is in the tree already
+                ctx.candidates.insert(std::make_pair(morph.smile, morph));
+            }
+
+            all.push_back(morph);
+            if (cutoff >= 0.0 &&
+                    morph.distToTarget + morph.distToClosestDecoy > cutoff) {
+                ++screenedCount;
+            } else {
+                collected.push_back(morph);
+            }
+        }
+
+        std::set<std::string> keptAll =
+            KeptMorphs(ctx, all, all.size(), draws);
+        std::set<std::string> keptScreened = KeptMorphs(
+            ctx, collected, collected.size() + screenedCount, draws);
+        if (keptAll != keptScreened) {
+            ++failures;
+        }
+        screenedTotal += screenedCount;
+        morphTotal += morphCount;
+
+        ctx.candidates.clear();
+        ctx.candidates.insert(std::make_pair(parent.smile, parent));
+    }
+
+    std::cout << "check screening: " << trials - failures << "/" << trials <<
+        " trials kept the same morphs, " << screenedTotal << " of " <<
+        morphTotal << " morphs screened out" << std::endl;
+    return failures;
+}
+
+static double AllocationsPerOp(const BenchResult &res)
+{
+    return res.ops > 0 ? static_cast<double>(res.allocations) / res.ops : 0.0;
+}
+
+static void WriteJson(const std::string &file, size_t molCount,
+    std::vector<BenchResult> &results)
+{
+    std::ofstream out(file.c_str());
+    out << std::setprecision(10);
+    out << "{" << std::endl;
+    out << "  \"version\": \"" << MOLPH_VERSION << "\"," << std::endl;
+    out << "  \"molecules\": " << molCount << "," << std::endl;
+    out << "  \"benchmarks\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        BenchResult &res = results[i];
+        double throughput = res.seconds > 0.0 ? res.ops / res.seconds : 0.0;
+        out << "    {\"group\": \"" << res.group << "\", " <<
+            "\"name\": \"" << res.name << "\", " <<
+            "\"samples\": " << res.samples.size() << ", " <<
+            "\"ops\": " << res.ops << ", " <<
+            "\"median_ns\": " << Percentile(res.samples, 0.5) << ", " <<
+            "\"p99_ns\": " << Percentile(res.samples, 0.99) << ", " <<
+            "\"ops_per_sec\": " << throughput << ", " <<
+            "\"allocs_per_op\": " << AllocationsPerOp(res) << "}";
+        out << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+static void WriteTable(std::vector<BenchResult> &results)
+{
+    std::cout << std::left << std::setw(16) << "group" << std::setw(14) <<
+        "name" << std::right << std::setw(14) << "median ns/op" <<
+        std::setw(14) << "p99 ns/op" << std::setw(16) << "ops/s" <<
+        std::setw(12) << "allocs/op" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        BenchResult &res = results[i];
+        double throughput = res.seconds > 0.0 ? res.ops / res.seconds : 0.0;
+        std::cout << std::left << std::setw(16) << res.group <<
+            std::setw(14) << res.name << std::right << std::fixed <<
+            std::setprecision(1) << std::setw(14) <<
+            Percentile(res.samples, 0.5) << std::setw(14) <<
+            Percentile(res.samples, 0.99) << std::setw(16) << throughput <<
+            std::setw(12) << AllocationsPerOp(res) << std::endl;
+    }
+}
+
+int MolpherBench(int argc, char *argv[])
+{
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Show help")
+        ("sdf-dir,D", boost::program_options::value<std::string>(), "Directory with SDF files")
+        ("json,J", boost::program_options::value<std::string>(), "Output JSON file")
+        ("repeat,R", boost::program_options::value<int>(), "Samples per benchmark")
+        ("check", "Run the correctness checks instead of the benchmarks")
+        ("large", "Include the 1M point PCA, reduce-full-1000 and the 10k and 50k molecule layouts (5 GB of distances)")
+        ;
+
+    boost::program_options::variables_map varMap;
+    try {
+        boost::program_options::store(
+            boost::program_options::parse_command_line(argc, argv, desc), varMap);
+    } catch (boost::program_options::error &exc) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+    boost::program_options::notify(varMap);
+
+    if (varMap.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    // Default parameter values.
+    std::string sdfDir("TestFiles");
+    std::string jsonFile("molpher-bench.json");
+    int repeat = 100;
+
+    if (varMap.count("sdf-dir")) {
+        sdfDir = varMap["sdf-dir"].as<std::string>();
+    }
+    if (varMap.count("json")) {
+        jsonFile = varMap["json"].as<std::string>();
+    }
+    if (varMap.count("repeat")) {
+        repeat = std::max(1, varMap["repeat"].as<int>());
+    }
+
+    std::vector<RDKit::RWMol *> mols;
+    try {
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator it(sdfDir); it != end; ++it) {
+            if (boost::filesystem::extension(it->path()) == ".sdf") {
+                ReadRWMolsFromSDF(it->path().string(), mols);
+            }
+        }
+    } catch (boost::filesystem::filesystem_error &exc) {
+        std::cout << exc.what() << std::endl;
+    }
+
+    if (mols.size() < 2) {
+        std::cout << "At least two molecules are needed in " << sdfDir << std::endl;
+        for (size_t m = 0; m < mols.size(); ++m) {
+            delete mols[m];
+        }
+        return 1;
+    }
+    if (varMap.count("check")) {
+        int failures = CheckScreening();
+        failures += CheckFoldedScreen(mols);
+        failures += CheckKamadaKawaiGradients();
+        failures += CheckSnapshotCompatibility();
+        failures += CheckMorphingAllocations(mols);
+        for (size_t m = 0; m < mols.size(); ++m) {
+            delete mols[m];
+        }
+        return failures > 0 ? 1 : 0;
+    }
+
+    std::cout << "Benchmarking over " << mols.size() << " molecules." << std::endl;
+
+    std::vector<BenchResult> results;
+    BenchFingerprints(mols, repeat, results);
+    BenchSimCoefs(mols, repeat, results);
+    BenchMorganSAScore(mols, repeat, results);
+    BenchMorphingData(mols, repeat, results);
+    BenchGenerateMorphs(mols, repeat, results);
+    BenchRandomWalk(mols, repeat, results);
+    BenchMorphPipeline(mols, repeat, results);
+    BenchDeduplication(mols, repeat, results);
+    BenchStructureCheck(mols, repeat, results);
+    BenchMolPool(mols, repeat, results);
+    BenchSerialization(mols, repeat, results);
+    BenchDictionary(mols, repeat, results);
+    bool large = (varMap.count("large") > 0);
+    BenchPcaEigen(repeat, large, results);
+    BenchKamadaKawaiScale(mols, repeat, large, results);
+
+    WriteTable(results);
+    WriteJson(jsonFile, mols.size(), results);
+    std::cout << "Results written to " << jsonFile << std::endl;
+
+    for (size_t m = 0; m < mols.size(); ++m) {
+        delete mols[m];
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef MOLPHER_BENCH_MODE
+#define MOLPHER_BENCH_MODE 0
+#endif
+
+/**
+ * Entry point of molpher-bench (backend built with MOLPHER_BENCH_MODE=1).
+ * Runs fingerprint, similarity, serialization and dictionary benchmarks
+ * over all SDF files of the given directory and writes the results
+ * (median and p99 ns/op, throughput, heap allocations per operation) to
+ * stdout and to a JSON file. With --check it runs the correctness checks
+ * of the screening, the layout, the snapshot format and the morphing
+ * allocations instead and fails if any of them does.
+ */
+int MolpherBench(int argc, char *argv[]);
@@ -21,6 +21,9 @@
 #include <fstream>
 #include <sstream>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <functional>
 
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -327,6 +330,117 @@ void FPandSCBenchmark(RDKit::ROMol *mol1, RDKit::ROMol *mol2)
     }
 }
 
+// compares sparse count fingerprints with their folded counterparts, both
+// in the cost and in how well the folded form keeps the nearest neighbors
+void SparseFPBenchmark(std::vector<RDKit::RWMol *> &mols)
+{
+    int iterations = 1000;
+    size_t topK = 10;
+    clock_t start;
+    clock_t finish;
+
+    size_t n = mols.size();
+    if (n < 2) {
+        return;
+    }
+    topK = std::min(topK, n - 1);
+
+    FingerprintSelector sparseSel[] = { FP_ATOM_PAIRS_COUNTS, FP_MORGAN_COUNTS };
+    FingerprintSelector foldedSel[] = { FP_ATOM_PAIRS, FP_MORGAN };
+
+    for (int s = 0; s < 2; ++s) {
+        SimCoefCalculator sparseCalc(SC_TANIMOTO, sparseSel[s]);
+        SimCoefCalculator foldedCalc(SC_TANIMOTO, foldedSel[s]);
+        std::vector<SparseFingerprint *> sparseFps(n);
+        std::vector<Fingerprint *> foldedFps(n);
+
+        start = clock();
+        for (int j = 0; j < iterations; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                delete sparseCalc.GetSparseFingerprint(mols[i]);
+            }
+        }
+        finish = clock();
+        cout << FingerprintLongDesc(sparseSel[s]) << " FP time [msec] = " <<
+            finish - start << endl;
+
+        start = clock();
+        for (int j = 0; j < iterations; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                delete foldedCalc.GetFingerprint(mols[i]);
+            }
+        }
+        finish = clock();
+        cout << FingerprintLongDesc(foldedSel[s]) << " FP time [msec] = " <<
+            finish - start << endl;
+
+        size_t sparseSize = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sparseFps[i] = sparseCalc.GetSparseFingerprint(mols[i]);
+            foldedFps[i] = foldedCalc.GetFingerprint(mols[i]);
+            sparseSize += sparseFps[i]->size();
+        }
+        cout << "average sparse FP length = " << sparseSize / n << endl;
+
+        start = clock();
+        for (int j = 0; j < iterations; ++j) {
+            for (size_t i = 1; i < n; ++i) {
+                sparseCalc.GetSimCoef(sparseFps[0], sparseFps[i]);
+            }
+        }
+        finish = clock();
+        cout << "sparse SC time [msec] = " << finish - start << endl;
+
+        start = clock();
+        for (int j = 0; j < iterations; ++j) {
+            for (size_t i = 1; i < n; ++i) {
+                foldedCalc.GetSimCoef(foldedFps[0], foldedFps[i]);
+            }
+        }
+        finish = clock();
+        cout << "folded SC time [msec] = " << finish - start << endl;
+
+        // nearest neighbors of every molecule by both forms
+        double coefDiff = 0;
+        size_t topKHits = 0;
+        for (size_t q = 0; q < n; ++q) {
+            std::vector<std::pair<double, size_t> > sparseRank;
+            std::vector<std::pair<double, size_t> > foldedRank;
+            for (size_t i = 0; i < n; ++i) {
+                if (i == q) {
+                    continue;
+                }
+                double sparseCoef = sparseCalc.GetSimCoef(sparseFps[q], sparseFps[i]);
+                double foldedCoef = foldedCalc.GetSimCoef(foldedFps[q], foldedFps[i]);
+                coefDiff += std::fabs(sparseCoef - foldedCoef);
+                sparseRank.push_back(std::make_pair(sparseCoef, i));
+                foldedRank.push_back(std::make_pair(foldedCoef, i));
+            }
+            std::sort(sparseRank.begin(), sparseRank.end(),
+                std::greater<std::pair<double, size_t> >());
+            std::sort(foldedRank.begin(), foldedRank.end(),
+                std::greater<std::pair<double, size_t> >());
+            for (size_t a = 0; a < topK; ++a) {
+                for (size_t b = 0; b < topK; ++b) {
+                    if (sparseRank[a].second == foldedRank[b].second) {
+                        ++topKHits;
+                        break;
+                    }
+                }
+            }
+        }
+        cout << "mean |sparse - folded| coef = " <<
+            coefDiff / (n * (n - 1)) << endl;
+        cout << "top-" << topK << " neighbor agreement = " <<
+            (double) topKHits / (n * topK) << endl << endl;
+
+        for (size_t i = 0; i < n; ++i) {
+            delete sparseFps[i];
+            delete foldedFps[i];
+        }
+    }
+}
+
 void MolToMolBlockBenchmark(RDKit::ROMol *mol)
 {
     int iterations = 10000;
@@ -1023,6 +1137,7 @@ void MorphingSandbox()
 //    return;
 //
 //    TestMorphing(mols[0], mols[1]);
+    SparseFPBenchmark(mols);
     RDKit::RWMol * molecule = RDKit::SmilesToMol ("CNC1CC(=O)C(F)=CC1(C)N1C2CN(O)C(C)(C2)C(C)C1", 0, true, 0);
     TestSAScore(molecule);
     delete molecule;
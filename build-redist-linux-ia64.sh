@@ -6,9 +6,12 @@ rm -f -r dist
 #create directory
 mkdir dist
 
-# copy molpher-srv and SASrore.dat
+# copy molpher-srv and SASrore.dat (and the precompiled SAScore.bin if present)
 cp backend/dist/*/*/molpher-srv dist/molpher-srv
 cp backend/SAScore.dat dist/SAScore.dat
+if [ -f backend/SAScore.bin ]; then
+    cp backend/SAScore.bin dist/SAScore.bin
+fi
 
 # copy libraries
 mkdir dist/libs/
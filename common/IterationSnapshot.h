@@ -23,6 +23,10 @@
 
 #include <boost/version.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <boost/archive/xml_iarchive.hpp>
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/tracking.hpp>
@@ -35,6 +39,7 @@
 
 #include "MolpherParam.h"
 #include "MolpherMolecule.h"
+#include "MorphingStats.h"
 
 struct IterationSnapshot
 {
@@ -76,6 +81,45 @@ struct IterationSnapshot
             BOOST_SERIALIZATION_NVP(candidates) & 
             BOOST_SERIALIZATION_NVP(morphDerivations) &
             BOOST_SERIALIZATION_NVP(prunedDuringThisIter);
+        SerializeAppended(ar, typename Archive::is_loading());
+    }
+
+    /**
+     * Fields appended to the original format.
+     */
+    template<typename Archive>
+    void SerializeAppended(Archive &ar, boost::mpl::false_)
+    {
+        ar & BOOST_SERIALIZATION_NVP(chemOperSurvivors) &
+            BOOST_SERIALIZATION_NVP(chemOperMiliseconds) &
+            BOOST_SERIALIZATION_NVP(iterMorphingStats) &
+            BOOST_SERIALIZATION_NVP(jobMorphingStats);
+    }
+
+    /**
+     * Snapshots saved before the fields were appended end with
+     * prunedDuringThisIter, those load with the fields left empty.
+     * Xml archives cannot continue past the missing elements, old xml
+     * snapshots still fail to load.
+     */
+    template<typename Archive>
+    void SerializeAppended(Archive &ar, boost::mpl::true_)
+    {
+        try {
+            ar & BOOST_SERIALIZATION_NVP(chemOperSurvivors) &
+                BOOST_SERIALIZATION_NVP(chemOperMiliseconds) &
+                BOOST_SERIALIZATION_NVP(iterMorphingStats) &
+                BOOST_SERIALIZATION_NVP(jobMorphingStats);
+        } catch (boost::archive::archive_exception &exc) {
+            if ((exc.code != boost::archive::archive_exception::input_stream_error) ||
+                    boost::is_same<Archive, boost::archive::xml_iarchive>::value) {
+                throw;
+            }
+            chemOperSurvivors.clear();
+            chemOperMiliseconds.clear();
+            iterMorphingStats.Clear();
+            jobMorphingStats.Clear();
+        }
     }
     
     bool IsValid()
@@ -171,6 +215,28 @@ struct IterationSnapshot
     
     PrunedMoleculeVector prunedDuringThisIter;
 
+    /**
+     * Decayed number of morphs accepted into the tree for each
+     * ChemOperSelector, used by the adaptive operator selection.
+     */
+    std::vector<double> chemOperSurvivors;
+
+    /**
+     * Decayed CPU time in miliseconds spent on morphs of each
+     * ChemOperSelector, used by the adaptive operator selection.
+     */
+    std::vector<double> chemOperMiliseconds;
+
+    /**
+     * Morphing pipeline counters of this iteration.
+     */
+    MorphingStats iterMorphingStats;
+
+    /**
+     * Morphing pipeline counters of all iterations up to this one.
+     */
+    MorphingStats jobMorphingStats;
+
 };
 
 // add information about version to archive
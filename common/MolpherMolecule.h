@@ -20,6 +20,7 @@
 #include <string>
 #include <set>
 #include <cfloat>
+#include <algorithm>
 
 #include <boost/cstdint.hpp>
 #include <boost/serialization/set.hpp>
@@ -36,26 +37,28 @@ struct MolpherMolecule
         distToClosestDecoy(0),
         molecularWeight(0.0),
         sascore(0.0),
+        graphHash(0),
         itersWithoutDistImprovement(0),
         posX(0),
         posY(0)
     {
     }
 
-    MolpherMolecule(std::string &smile) :
+    MolpherMolecule(const std::string &smile) :
         smile(smile),
         parentChemOper(0),
         distToTarget(DBL_MAX),
         distToClosestDecoy(0),
         molecularWeight(0.0),
         sascore(0.0),
+        graphHash(0),
         itersWithoutDistImprovement(0),
         posX(0),
         posY(0)
     {
     }
 
-    MolpherMolecule(std::string &smile, std::string &formula) :
+    MolpherMolecule(const std::string &smile, const std::string &formula) :
         smile(smile),
         formula(formula),
         parentChemOper(0),
@@ -63,14 +66,15 @@ struct MolpherMolecule
         distToClosestDecoy(0),
         molecularWeight(0.0),
         sascore(0.0),
+        graphHash(0),
         itersWithoutDistImprovement(0),
         posX(0),
         posY(0)
     {
     }
 
-    MolpherMolecule(std::string &smile, std::string &formula,
-        std::string &parentSmile, boost::int32_t parentChemOper,
+    MolpherMolecule(const std::string &smile, const std::string &formula,
+        const std::string &parentSmile, boost::int32_t parentChemOper,
         double distToTarget, double distToClosestDecoy, double molecularWeight, double sascore
         ) :
         smile(smile),
@@ -81,6 +85,7 @@ struct MolpherMolecule
         distToClosestDecoy(distToClosestDecoy),
         molecularWeight(molecularWeight),
         sascore(sascore),
+        graphHash(0),
         itersWithoutDistImprovement(0),
         posX(0),
         posY(0)
@@ -111,6 +116,29 @@ struct MolpherMolecule
         return (!smile.empty());
     }
 
+    /**
+     * Exchanges the content with other without copying strings and sets.
+     * Used to move morphs along the pipeline (the compiler provided move
+     * operations do the same in C++11 builds).
+     */
+    void Swap(MolpherMolecule &other)
+    {
+        smile.swap(other.smile);
+        formula.swap(other.formula);
+        std::swap(parentChemOper, other.parentChemOper);
+        parentSmile.swap(other.parentSmile);
+        descendants.swap(other.descendants);
+        historicDescendants.swap(other.historicDescendants);
+        std::swap(distToTarget, other.distToTarget);
+        std::swap(distToClosestDecoy, other.distToClosestDecoy);
+        std::swap(molecularWeight, other.molecularWeight);
+        std::swap(sascore, other.sascore);
+        std::swap(graphHash, other.graphHash);
+        std::swap(itersWithoutDistImprovement, other.itersWithoutDistImprovement);
+        std::swap(posX, other.posX);
+        std::swap(posY, other.posY);
+    }
+
     std::string smile;
     std::string formula;
     boost::int32_t parentChemOper;
@@ -132,6 +160,12 @@ struct MolpherMolecule
      * constructors updated. The value is not serialised.
      */
     double sascore;
+
+    /**
+     * Canonical hash of the graph the morph was built from, 0 if unknown.
+     * The value is not serialised.
+     */
+    boost::uint64_t graphHash;
     
     boost::uint32_t itersWithoutDistImprovement;
 
@@ -152,3 +186,10 @@ struct MolpherMolecule
 BOOST_CLASS_IMPLEMENTATION(MolpherMolecule, object_serializable)
 // turn off tracking
 BOOST_CLASS_TRACKING(MolpherMolecule, track_never)
+
+// found by argument dependent lookup, lets std::sort and tbb::parallel_sort
+// exchange morphs without copies
+inline void swap(MolpherMolecule &a, MolpherMolecule &b)
+{
+    a.Swap(b);
+}
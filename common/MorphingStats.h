@@ -0,0 +1,218 @@
+/*
+ Copyright (c) 2012 Petr Koupy
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/tracking.hpp>
+#include <boost/serialization/level.hpp>
+#include <boost/serialization/version.hpp>
+
+#include "chemoper_selectors.h"
+
+/**
+ * Counters of the morphing pipeline for a single chemical operator.
+ */
+struct ChemOperStats
+{
+    ChemOperStats() :
+        attempts(0),
+        morphFailures(0),
+        structureRejects(0),
+        fragmentRejects(0),
+        sanitizeFailures(0),
+        duplicates(0),
+        filteredRandom(0),
+        filteredWeight(0),
+        filteredSascore(0),
+        filteredInTree(0),
+        filteredTriedByParent(0),
+        filteredTooManyDerivations(0),
+        filteredKeepLimit(0),
+        accepted(0),
+        morphNanoseconds(0),
+        sanitizeNanoseconds(0),
+        propertyNanoseconds(0),
+        allocNanoseconds(0)
+    {
+    }
+
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive &ar, const unsigned int version)
+    {
+        ar & BOOST_SERIALIZATION_NVP(attempts) &
+            BOOST_SERIALIZATION_NVP(morphFailures) &
+            BOOST_SERIALIZATION_NVP(sanitizeFailures) &
+            BOOST_SERIALIZATION_NVP(duplicates) &
+            BOOST_SERIALIZATION_NVP(filteredRandom) &
+            BOOST_SERIALIZATION_NVP(filteredWeight) &
+            BOOST_SERIALIZATION_NVP(filteredSascore) &
+            BOOST_SERIALIZATION_NVP(filteredInTree) &
+            BOOST_SERIALIZATION_NVP(filteredTriedByParent) &
+            BOOST_SERIALIZATION_NVP(filteredTooManyDerivations) &
+            BOOST_SERIALIZATION_NVP(filteredKeepLimit) &
+            BOOST_SERIALIZATION_NVP(accepted) &
+            BOOST_SERIALIZATION_NVP(morphNanoseconds) &
+            BOOST_SERIALIZATION_NVP(sanitizeNanoseconds) &
+            BOOST_SERIALIZATION_NVP(propertyNanoseconds) &
+            BOOST_SERIALIZATION_NVP(structureRejects) &
+            BOOST_SERIALIZATION_NVP(fragmentRejects) &
+            BOOST_SERIALIZATION_NVP(allocNanoseconds);
+    }
+
+    void Add(const ChemOperStats &other)
+    {
+        attempts += other.attempts;
+        morphFailures += other.morphFailures;
+        structureRejects += other.structureRejects;
+        fragmentRejects += other.fragmentRejects;
+        sanitizeFailures += other.sanitizeFailures;
+        duplicates += other.duplicates;
+        filteredRandom += other.filteredRandom;
+        filteredWeight += other.filteredWeight;
+        filteredSascore += other.filteredSascore;
+        filteredInTree += other.filteredInTree;
+        filteredTriedByParent += other.filteredTriedByParent;
+        filteredTooManyDerivations += other.filteredTooManyDerivations;
+        filteredKeepLimit += other.filteredKeepLimit;
+        accepted += other.accepted;
+        morphNanoseconds += other.morphNanoseconds;
+        sanitizeNanoseconds += other.sanitizeNanoseconds;
+        propertyNanoseconds += other.propertyNanoseconds;
+        allocNanoseconds += other.allocNanoseconds;
+    }
+
+    /**
+     * Number of morph attempts.
+     */
+    boost::uint64_t attempts;
+
+    /**
+     * No applicable edit or error of the operator.
+     */
+    boost::uint64_t morphFailures;
+
+    /**
+     * Rejected by MolpherGraph::FindDefect for valence or aromaticity, each
+     * one is a sanitization saved.
+     */
+    boost::uint64_t structureRejects;
+
+    /**
+     * Rejected by MolpherGraph::FindDefect as empty or disconnected. Such
+     * a morph would pass sanitization, so no sanitization is saved.
+     */
+    boost::uint64_t fragmentRejects;
+
+    /**
+     * Kekulization or sanitization of the morph failed.
+     */
+    boost::uint64_t sanitizeFailures;
+
+    /**
+     * Same as another morph of the batch or as a molecule in the tree.
+     */
+    boost::uint64_t duplicates;
+
+    /**
+     * Morphs rejected by FilterMorphs, by the first reason that applied.
+     */
+    boost::uint64_t filteredRandom;
+    boost::uint64_t filteredWeight;
+    boost::uint64_t filteredSascore;
+    boost::uint64_t filteredInTree;
+    boost::uint64_t filteredTriedByParent;
+    boost::uint64_t filteredTooManyDerivations;
+
+    /**
+     * Survived the filters but did not fit into cntCandidatesToKeepMax.
+     */
+    boost::uint64_t filteredKeepLimit;
+
+    /**
+     * Morphs accepted into the tree.
+     */
+    boost::uint64_t accepted;
+
+    /**
+     * Time spent on editing the molecule, on kekulization and sanitization
+     * and on SMILES, formula, weight and SAScore.
+     */
+    boost::uint64_t morphNanoseconds;
+    boost::uint64_t sanitizeNanoseconds;
+    boost::uint64_t propertyNanoseconds;
+
+    /**
+     * Time spent on obtaining and filling the RDKit molecule of the morph
+     * and on giving it back (see RWMolPool), not part of the above.
+     */
+    boost::uint64_t allocNanoseconds;
+};
+
+/**
+ * Morphing pipeline counters of all chemical operators.
+ */
+struct MorphingStats
+{
+    MorphingStats() :
+        opers(OP_BOND_CONTRACTION + 1)
+    {
+    }
+
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive &ar, const unsigned int version)
+    {
+        ar & BOOST_SERIALIZATION_NVP(opers);
+    }
+
+    void Add(const MorphingStats &other)
+    {
+        if (opers.size() < other.opers.size()) {
+            opers.resize(other.opers.size());
+        }
+        for (size_t i = 0; i < other.opers.size(); ++i) {
+            opers[i].Add(other.opers[i]);
+        }
+    }
+
+    void Clear()
+    {
+        opers.assign(OP_BOND_CONTRACTION + 1, ChemOperStats());
+    }
+
+    /**
+     * Counters indexed by ChemOperSelector.
+     */
+    std::vector<ChemOperStats> opers;
+};
+
+// add information about version to archive
+BOOST_CLASS_IMPLEMENTATION(ChemOperStats, object_class_info)
+BOOST_CLASS_IMPLEMENTATION(MorphingStats, object_class_info)
+// turn off tracking
+BOOST_CLASS_TRACKING(ChemOperStats, track_never)
+BOOST_CLASS_TRACKING(MorphingStats, track_never)
+// specify version, bump it together with new counters
+BOOST_CLASS_VERSION(ChemOperStats, 0)
+BOOST_CLASS_VERSION(MorphingStats, 0)
@@ -102,17 +102,26 @@ BOOST_CLASS_TRACKING(NeighborhoodTask, track_never) // turn off tracking
 
 struct NeighborhoodTaskResult
 {
+    NeighborhoodTaskResult() :
+        partial(false)
+    {
+    }
+
     friend class boost::serialization::access;
     template<typename Archive>
     void serialize(Archive &ar, const unsigned int version)
     {
-        ar & taskTimestamp & origin & reducedNeighborhood & reducedContext;
+        ar & taskTimestamp & origin & reducedNeighborhood & reducedContext &
+            partial;
     }
 
     boost::posix_time::ptime taskTimestamp;
     MolpherMolecule origin;
     std::vector<MolpherMolecule> reducedNeighborhood;
     std::vector<MolpherMolecule> reducedContext;
+    // more results of the same task follow, each one holds all neighbors
+    // found so far with coordinates computed anew
+    bool partial;
 };
 
 BOOST_CLASS_IMPLEMENTATION(NeighborhoodTaskResult, object_serializable) // turn off versioning
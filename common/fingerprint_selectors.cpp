@@ -32,7 +32,9 @@ static const char *shortDesc[] = {
     "ETOP",
     "ETL1",
     "ETL2",
-    "ETPT"
+    "ETPT",
+    "CATP",
+    "CMRG"
 };
 
 static const char *longDesc[] = {
@@ -47,7 +49,9 @@ static const char *longDesc[] = {
     "Topological (ext)",
     "Topological Layered 1 (ext)",
     "Topological Layered 2 (ext)",
-    "Topological Torsion (ext)"
+    "Topological Torsion (ext)",
+    "Atom Pairs (counts)",
+    "Morgan (counts)"
 };
 
 const char *FingerprintShortDesc(const int selector)
@@ -97,6 +101,10 @@ FingerprintSelector FingerprintParse(const std::string& name) {
         return FP_EXT_TOPOLOGICAL_LAYERED_2;
     } if (boost::iequals(name, "FP_EXT_TOPOLOGICAL_TORSION")) {
         return FP_EXT_TOPOLOGICAL_TORSION;
+    } if (boost::iequals(name, "FP_ATOM_PAIRS_COUNTS")) {
+        return FP_ATOM_PAIRS_COUNTS;
+    } if (boost::iequals(name, "FP_MORGAN_COUNTS")) {
+        return FP_MORGAN_COUNTS;
     } else {
         throw std::runtime_error("Unknown fingerprint name.");
     }    
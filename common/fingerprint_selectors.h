@@ -20,6 +20,7 @@
 
 #define DEFAULT_FP FP_MORGAN
 #define MAX_STANDARD_FP FP_TOPOLOGICAL_TORSION
+#define MAX_EXTENDED_FP FP_EXT_TOPOLOGICAL_TORSION
 
 #include <string>
 
@@ -35,7 +36,9 @@ enum FingerprintSelector {
     FP_EXT_TOPOLOGICAL,
     FP_EXT_TOPOLOGICAL_LAYERED_1,
     FP_EXT_TOPOLOGICAL_LAYERED_2,
-    FP_EXT_TOPOLOGICAL_TORSION
+    FP_EXT_TOPOLOGICAL_TORSION,
+    FP_ATOM_PAIRS_COUNTS,
+    FP_MORGAN_COUNTS
 };
 
 const char *FingerprintShortDesc(const int selector);
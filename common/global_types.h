@@ -18,6 +18,11 @@
 
 #pragma once
 
+#include <vector>
+#include <utility>
+
+#include <boost/cstdint.hpp>
+
 #include <DataStructs/ExplicitBitVect.h>
 #include <GraphMol/Atom.h>
 
@@ -27,6 +32,8 @@ typedef unsigned int JobId;
 typedef unsigned int IterIdx;
 
 typedef ExplicitBitVect Fingerprint;
+// unfolded count fingerprint, (key, count) pairs sorted by key
+typedef std::vector<std::pair<boost::uint32_t, boost::uint32_t> > SparseFingerprint;
 typedef unsigned int AtomIdx;
 typedef unsigned int BondIdx;
 
@@ -651,7 +651,10 @@ void ChemicalSpaceView::OnVisualizeNeighborhoodTaskResult(const NeighborhoodTask
         return;
     }
 
-    mNeighborhoodRequestTimestamps.erase(itFoundTimestamp);
+    // partial results are followed by the complete one
+    if (!res.partial) {
+        mNeighborhoodRequestTimestamps.erase(itFoundTimestamp);
+    }
 
     VisualizeOriginAndContext(res.origin, res.reducedContext);
     VisualizeNeighborhood(res.reducedNeighborhood);
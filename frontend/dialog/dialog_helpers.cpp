@@ -243,6 +243,8 @@ void FillComboWithFingerprints(QComboBox *comboBox, bool extended)
         listFingerprints.append(FingerprintLongDesc(FP_EXT_TOPOLOGICAL_LAYERED_1));
         listFingerprints.append(FingerprintLongDesc(FP_EXT_TOPOLOGICAL_LAYERED_2));
         listFingerprints.append(FingerprintLongDesc(FP_EXT_TOPOLOGICAL_TORSION));
+        listFingerprints.append(FingerprintLongDesc(FP_ATOM_PAIRS_COUNTS));
+        listFingerprints.append(FingerprintLongDesc(FP_MORGAN_COUNTS));
     }
     comboBox->addItems(listFingerprints);
     comboBox->setCurrentIndex(DEFAULT_FP);
@@ -116,6 +116,10 @@ bool NeighborhoodTester::ValidateNeighborhoodResult(const NeighborhoodTaskResult
 
 bool NeighborhoodTester::ShouldAcceptNeighborhood(const NeighborhoodTaskResult& res)
 {
+    if (res.partial) {
+        return false; // wait for the complete result
+    }
+
     if (res.origin.smile == mSource.smile) {
        return true;
     }